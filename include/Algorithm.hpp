@@ -3,6 +3,8 @@
 
 #include <algorithm>
 
+#include "DescriptorRing.hpp"
+#include "FilterRegistry.hpp"
 #include "Shader.hpp"
 #include "Image.hpp"
 #include "Shader.hpp"
@@ -11,6 +13,9 @@
 
 namespace bm {
 
+// constant_id of kernel size in shaders compiled into per kernel size variants
+constexpr u32 KERNEL_SIZE_CONSTANT_ID{0};
+
 template <typename DescriptorType, typename... DependencyArgs>
 struct Algorithm {
 	using Base = Algorithm<DescriptorType, DependencyArgs...>; 
@@ -21,8 +26,8 @@ struct Algorithm {
 	Algorithm(const Shader &shader) : shader(shader) {}
 
 	virtual void prepare(DependencyArgs... args) = 0;
-	virtual void continuousSubmit(u32 buff_id) = 0;
-	virtual void submit(u32 buff_id) = 0;
+	virtual void continuousSubmit(DescriptorRing &ring) = 0;
+	virtual void submit(DescriptorRing &ring) = 0;
 
 	virtual ~Algorithm() = default;
 };
@@ -41,8 +46,8 @@ struct ThresholdBinarizationAlgorithm : Algorithm<ThresholdBinarizationDescripto
 	ThresholdBinarizationAlgorithm(const Shader &shader) : Base(shader) {}
 
 	void prepare() override {}
-	void continuousSubmit(u32 buff_id) override;
-	void submit(u32 buff_id) override;
+	void continuousSubmit(DescriptorRing &ring) override;
+	void submit(DescriptorRing &ring) override;
 
 	~ThresholdBinarizationAlgorithm() override = default;
 };
@@ -51,11 +56,18 @@ struct OtsuBinarizationDescriptor {
 	f32 threshold = .0F;
 };
 struct OtsuBinarizationAlgorithm : Algorithm<OtsuBinarizationDescriptor, const Histogram &> {
+	// tiled mode runs on CPU, see performAdaptiveOtsu
+	bool adaptive{false};
+	i32 tile_size{64};
+
 	OtsuBinarizationAlgorithm(const Shader &shader) : Base(shader) {}
 
+	// value maximizing between class variance, i.e. pixels > it are foreground
+	static u8 computeThreshold(const std::array<u32, 256> &histogram);
+
 	void prepare(const Histogram &) override;
-	void continuousSubmit(u32 buff_id) override;
-	void submit(u32 buff_id) override;
+	void continuousSubmit(DescriptorRing &ring) override;
+	void submit(DescriptorRing &ring) override;
 
 	~OtsuBinarizationAlgorithm() override = default;
 };
@@ -70,11 +82,16 @@ struct EqualizationDescriptor {
 	std::array<f32, 256> distributant_b;
 };
 struct EqualizationAlgorithm : Algorithm<EqualizationDescriptor, const Histogram &> {
+	// CLAHE mode runs on CPU, see performCLAHE
+	bool adaptive{false};
+	i32 tile_size{64};
+	f32 clip_limit{2.F};
+
 	EqualizationAlgorithm(const Shader &shader) : Base(shader) {}
 
 	void prepare(const Histogram &histogram) override;
-	void continuousSubmit(u32 buff_id) override;
-	void submit(u32 buff_id) override;
+	void continuousSubmit(DescriptorRing &ring) override;
+	void submit(DescriptorRing &ring) override;
 
 	~EqualizationAlgorithm() override = default;
 };
@@ -84,12 +101,16 @@ struct StretchingDescriptor {
 	alignas(16) f32 local_max[3] = {1.F, 1.F, 1.F};
 	alignas(16) f32 global_max[3] = {1.F, 1.F, 1.F};
 };
-struct StretchingAlgorithm : Algorithm<StretchingDescriptor, const Image &> {
+struct StretchingAlgorithm : Algorithm<StretchingDescriptor, const Histogram &> {
+	// fractions of pixels clipped to local_min/local_max, 0/1 stretch between exact min and max
+	f32 low_clip{0.F};
+	f32 high_clip{1.F};
+
 	StretchingAlgorithm(const Shader &shader) : Base(shader) {}
 
-	void prepare(const Image &image) override;
-	void continuousSubmit(u32 buff_id) override;
-	void submit(u32 buff_id) override;
+	void prepare(const Histogram &histogram) override;
+	void continuousSubmit(DescriptorRing &ring) override;
+	void submit(DescriptorRing &ring) override;
 
 	~StretchingAlgorithm() override = default;
 };
@@ -108,24 +129,40 @@ struct LocalBinarizationAlgorithm : Algorithm<LocalBinarizationDescriptor> {
 	LocalBinarizationAlgorithm(const Shader &shader) : Base(shader) {}
 
 	void prepare() override {}
-	void continuousSubmit(u32 buff_id) override;
-	void submit(u32 buff_id) override;
+	void continuousSubmit(DescriptorRing &ring) override;
+	void submit(DescriptorRing &ring) override;
+
+	// binds shader variant specialized for current kernel size
+	void bindVariant() const;
 
 	~LocalBinarizationAlgorithm() override = default;
 };
 
 struct ConvolutionDescriptor {
-	i32 kernel_size{1}; // max 10
+	// largest kernel fitting into uniform block, bigger ones are convolved on CPU
+	static constexpr i32 MAX_KERNEL_SIZE{10};
+
+	i32 kernel_size{1}; // max MAX_KERNEL_SIZE
 	alignas(4) bool gray_scale{false};
 	alignas(4) bool gradient{false};
 	alignas(16) std::array<f32, 441> kernel;
 };
-struct ConvolutionAlgorithm : Algorithm<ConvolutionDescriptor, const fs::path &> {
+struct ConvolutionAlgorithm : Algorithm<ConvolutionDescriptor, std::shared_ptr<const Filter>> {
 	ConvolutionAlgorithm(const Shader &shader) : Base(shader) {}
 
-	void prepare(const fs::path &filter_path) override;
-	void continuousSubmit(u32 buff_id) override;
-	void submit(u32 buff_id) override;
+	// selected filter and engine chosen for it by cost model
+	std::shared_ptr<const Filter> filter;
+	ConvolutionEngine engine{ConvolutionEngine::DIRECT};
+	FftConvolution fft;
+
+	void prepare(std::shared_ptr<const Filter> filter) override;
+	void continuousSubmit(DescriptorRing &ring) override;
+	void submit(DescriptorRing &ring) override;
+
+	// CPU convolution with chosen engine, for kernels the shader can't take
+	void perform(Image &image);
+	// binds shader variant specialized for current kernel size
+	void bindVariant() const;
 
 	~ConvolutionAlgorithm() override = default;
 };
@@ -137,8 +174,11 @@ struct MedianFilterAlgorithm : Algorithm<MedianFilterDescriptor> {
 	MedianFilterAlgorithm(const Shader &shader) : Base(shader) {}
 
 	void prepare() override;
-	void continuousSubmit(u32 buff_id) override;
-	void submit(u32 buff_id) override;
+	void continuousSubmit(DescriptorRing &ring) override;
+	void submit(DescriptorRing &ring) override;
+
+	// binds shader variant specialized for current kernel size
+	void bindVariant() const;
 
 	~MedianFilterAlgorithm() override = default;
 };
@@ -150,8 +190,8 @@ struct PixelizationAlgorithm : Algorithm<PixelizationDescriptor, u32, u32> {
 	PixelizationAlgorithm(const Shader &shader) : Base(shader) {}
 
 	void prepare(u32 tex_id, u32 binding_id) override;
-	void continuousSubmit(u32 buff_id) override;
-	void submit(u32 buff_id) override;
+	void continuousSubmit(DescriptorRing &ring) override;
+	void submit(DescriptorRing &ring) override;
 
 	~PixelizationAlgorithm() override = default;
 };
@@ -166,8 +206,8 @@ struct GlobalFillAlgorithm : Algorithm<GlobalFillDescriptor> {
 	GlobalFillAlgorithm(const Shader &shader) : Base(shader) {}
 
 	void prepare() override {}
-	void continuousSubmit(u32 buff_id) override;
-	void submit(u32 buff_id) override;
+	void continuousSubmit(DescriptorRing &ring) override;
+	void submit(DescriptorRing &ring) override;
 
 	~GlobalFillAlgorithm() override = default;
 };
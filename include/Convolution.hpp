@@ -0,0 +1,97 @@
+#ifndef BM_CONVOLUTION_HPP
+#define BM_CONVOLUTION_HPP
+
+#include <complex>
+#include <vector>
+
+#include "Image.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+// Square kernel of side 2 * radius + 1, applied the same way as by convolution
+// shader, i.e. out(x, y) = sum of at(u, v) * in(x + u, y + v).
+struct Kernel {
+    i32 radius{ 0 };
+    // row major, side x side
+    std::vector<f32> taps;
+
+    [[nodiscard]] i32 side() const { return 2 * radius + 1; }
+    [[nodiscard]] f32 at(i32 u, i32 v) const {
+        return taps[static_cast<std::size_t>((v + radius) * side() + u + radius)];
+    }
+    // kernel applied for y derivative in gradient mode
+    [[nodiscard]] Kernel rotated() const;
+    [[nodiscard]] u64 hash() const;
+};
+
+// DIRECT is the convolution shader while kernel fits its descriptor, all engines
+// give the same result on CPU
+enum class ConvolutionEngine : i32 { DIRECT, SEPARABLE, FFT };
+
+const char* engineName(ConvolutionEngine engine);
+
+// Rank one factorization kernel.at(u, v) == column[v] * row[u], fails for kernels that aren't separable
+bool separateKernel(const Kernel& kernel, std::vector<f32>& column, std::vector<f32>& row);
+
+// Cost model, estimates are multiply-adds per output pixel and channel. GPU direct
+// convolution is only possible up to gpu_max_radius.
+ConvolutionEngine chooseEngine(const Kernel& kernel, bool separable, i32 gpu_max_radius);
+
+// Kernel with everything engines derive from it, computed once when kernel is loaded
+struct PreparedKernel {
+    Kernel kernel;
+    Kernel rotated;
+    bool separable{ false };
+    // factors of kernel and of rotated, valid if separable
+    std::vector<f32> column;
+    std::vector<f32> row;
+    std::vector<f32> rotated_column;
+    std::vector<f32> rotated_row;
+    ConvolutionEngine engine{ ConvolutionEngine::DIRECT };
+
+    static PreparedKernel prepare(Kernel kernel, i32 gpu_max_radius);
+};
+
+// Overlap-save convolution with power of two tiles. Two channels are transformed at
+// once as real and imaginary part, kernel spectra are cached per kernel and tile size.
+struct FftConvolution {
+    using Plane = std::vector<f32>;
+
+    struct Spectrum {
+        u64 key{ 0 };
+        i32 tile_size{ 0 };
+        std::vector<std::complex<f32>> values;
+    };
+    static constexpr std::size_t MAX_SPECTRA{ 8 };
+
+    std::vector<Spectrum> spectra;
+
+    // tile side with least work per output pixel
+    static i32 tileSize(i32 radius, i32 width, i32 height);
+    // per output pixel and channel for best tile size
+    static f32 cost(i32 radius);
+
+    const std::vector<std::complex<f32>>& spectrum(const Kernel& kernel, i32 tile_size);
+
+    // out[k][p] is planes[p] convolved with kernels[k]
+    void apply(
+        const std::vector<Plane>& planes, i32 width, i32 height,
+        const std::vector<const Kernel*>& kernels, std::vector<std::vector<Plane>>& out
+    );
+};
+
+struct ConvolutionOptions {
+    bool gray_scale{ false };
+    bool gradient{ false };
+};
+
+// CPU convolution with chosen engine, image edges are extended. RGBA8 keeps alpha.
+void performConvolution(
+    Image& image, const PreparedKernel& prepared, ConvolutionEngine engine,
+    const ConvolutionOptions& options, FftConvolution& fft
+);
+
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef BM_DESCRIPTOR_RING_HPP
+#define BM_DESCRIPTOR_RING_HPP
+
+#include <array>
+
+#include "Types.hpp"
+
+namespace bm {
+
+// Uniform buffer for algorithm descriptors written through a persistent
+// coherent mapping. Buffer is split into FRAMES_NUM regions, one per frame
+// in flight. Every upload is appended to current frame's region and bound
+// as its own range, so passes in one frame don't wait on each other, and a
+// region is reused only after fence placed at the end of its frame signalled.
+// Upload of bytes equal to the previous one (compared by hash) is skipped
+// while that range is still alive.
+struct DescriptorRing {
+    static constexpr std::size_t FRAMES_NUM{ 3 };
+
+    u32 buffer_id{ 0 };
+    u32 binding{ 0 };
+    u8* mapped{ nullptr };
+    std::size_t region_size{ 0 };
+    std::size_t alignment{ 256 };
+    std::size_t frame{ 0 };
+    std::size_t head{ 0 };
+    // GLsync of frames in flight
+    std::array<void*, FRAMES_NUM> fences{};
+
+    // last upload, offset is absolute within buffer
+    u64 last_hash{ 0 };
+    std::size_t last_offset{ 0 };
+    std::size_t last_size{ 0 };
+    bool last_valid{ false };
+
+    DescriptorRing(u32 binding, std::size_t region_size);
+
+    template<typename T>
+    void upload(const T& descriptor) {
+        upload(static_cast<const void*>(&descriptor), sizeof(T));
+    }
+    void upload(const void* data, std::size_t size);
+
+    // moves to next region, waits for GPU if it still reads it
+    void beginFrame();
+    void endFrame();
+
+    void deinit();
+};
+
+}
+
+#endif
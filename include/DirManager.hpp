@@ -1,20 +1,82 @@
 #ifndef BM_DIR_MANAGER_HPP
 #define BM_DIR_MANAGER_HPP
 
-#include <vector>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "DirWatcher.hpp"
 #include "Types.hpp"
 
 namespace bm {
+    // Index of accepted files of directory with their metadata. Initial scan runs on
+    // a worker, afterwards index is updated from DirWatcher events. Worker and watcher
+    // publish snapshots of index sorted by sort key, UI thread only swaps them in, in poll().
     struct DirManager {
+        struct Entry {
+            fs::path path;
+            std::uintmax_t size{ 0 };
+            fs::file_time_type mtime{};
+            // 0 if header couldn't be read
+            i32 width{ 0 };
+            i32 height{ 0 };
+        };
+        enum class SortKey : i32 { NAME, SIZE, MTIME, PIXELS };
+
         fs::path dir_path;
-        std::vector<fs::path> files;
+        // lowercase, with dot
         std::vector<std::string> accepted_extensions;
 
+        // UI thread view, files[i] is entries[i].path
+        std::vector<Entry> entries;
+        std::vector<fs::path> files;
+        SortKey sort_key{ SortKey::NAME };
+
+        // shared with worker/watcher, sorted by path
+        std::mutex mutex;
+        std::vector<Entry> index;
+        // removed while initial scan runs, its batches mustn't bring them back
+        std::vector<fs::path> removed_during_scan;
+        // latest published copy of index, sorted by snapshot_key
+        std::vector<Entry> snapshot;
+        std::vector<fs::path> snapshot_files;
+        SortKey snapshot_key{ SortKey::NAME };
+        u64 snapshot_generation{ 0 };
+        // sort_key of UI, next snapshots are sorted by it
+        SortKey publish_key{ SortKey::NAME };
+        std::atomic<u64> generation{ 0 };
+        std::atomic<bool> scanning{ false };
+        std::atomic<bool> cancelled{ false };
+        u64 polled_generation{ 0 };
+        // scanner thread only
+        std::chrono::steady_clock::time_point last_publish{};
+
+        // must stay last, they reference members above
+        std::thread scanner;
+        DirWatcher watcher;
+
         DirManager(fs::path&& dir_path, std::vector<std::string>&& accepted_extensions);
-        void refresh();
+        ~DirManager();
+
+        // swaps in latest published snapshot, returns true if files changed
+        bool poll();
+        // sorts UI view at once, snapshots published afterwards are sorted by key too
+        void sort(SortKey key);
+
+        [[nodiscard]] bool isAccepted(const fs::path& path) const;
+        // reads size, time and dimensions, false if file is gone
+        static bool readEntry(const fs::path& path, Entry& entry);
+        void update(const fs::path& path, DirWatcher::Event event);
+        void scan();
+        // merges sorted batch into index, entries already there (reported by watcher) win
+        // and entries removed meanwhile are dropped
+        void merge(std::vector<Entry>& batch);
+        // copies index, sorts it outside of lock and stores it as snapshot unless newer one is there
+        void publish();
     };
 };
 
-#endif
\ No newline at end of file
+#endif
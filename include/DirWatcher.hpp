@@ -0,0 +1,41 @@
+#ifndef BM_DIR_WATCHER_HPP
+#define BM_DIR_WATCHER_HPP
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <thread>
+
+#include "Types.hpp"
+
+namespace bm {
+
+// Reports files (directly in dir_path) that were written, moved in, removed or
+// moved out. Callback runs on watcher's own thread. Uses inotify on Linux,
+// elsewhere directory is rescanned for changed write times every second.
+struct DirWatcher {
+    enum class Event { CHANGED, REMOVED };
+    using Callback = std::function<void(const fs::path& path, Event event)>;
+
+    fs::path dir_path;
+    Callback callback;
+    std::atomic<bool> running{ false };
+    std::thread thread;
+
+    DirWatcher() = default;
+    DirWatcher(const DirWatcher&) = delete;
+    DirWatcher& operator=(const DirWatcher&) = delete;
+    ~DirWatcher() { stop(); }
+
+    // returns once directory is watched, changes made after that are all reported
+    bool start(const fs::path& dir_path, Callback callback);
+    // joins watcher thread, callback isn't called after return
+    void stop();
+
+    // ready is set once watch is established (or failed)
+    void run(std::promise<bool> ready);
+};
+
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef BM_DISTANCE_TRANSFORM_HPP
+#define BM_DISTANCE_TRANSFORM_HPP
+
+#include <cmath>
+#include <vector>
+
+#include "Image.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+// feature pixels distances are measured to, background is white and ridges black
+enum class DistanceTo : u8 { BACKGROUND, RIDGES };
+
+// Exact Euclidean distance transform of Felzenszwalb and Huttenlocher. Column pass
+// gives distance to nearest feature of the column, row pass takes lower envelope of
+// parabolas rooted at those, both are linear and run over bands of columns and rows.
+struct DistanceTransform {
+    // squared distance of every pixel when image has no feature pixel at all
+    static constexpr i32 NONE{ lim<i32>::max() };
+
+    i32 width{ 0 };
+    i32 height{ 0 };
+    // squared distances, row major, 0 for feature pixels
+    std::vector<i32> squared;
+    // index y * width + x of nearest feature pixel (-1 if there's none), empty unless requested
+    std::vector<i32> nearest;
+
+    void compute(const Image& image, DistanceTo features, bool with_nearest = false);
+
+    [[nodiscard]] bool empty() const { return squared.empty(); }
+    [[nodiscard]] std::size_t index(i32 x, i32 y) const {
+        return static_cast<std::size_t>(y) * static_cast<std::size_t>(width) + static_cast<std::size_t>(x);
+    }
+    [[nodiscard]] f32 distance(i32 x, i32 y) const {
+        return std::sqrt(static_cast<f32>(squared[index(x, y)]));
+    }
+    // Euclidean distances, row major, infinity if there is no feature pixel
+    [[nodiscard]] std::vector<f32> distances() const;
+};
+
+// distances scaled so that the largest one is white, image of transform becomes GRAY8
+void drawDistanceTransform(Image& image, const DistanceTransform& transform);
+
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef BM_FILTER_REGISTRY_HPP
+#define BM_FILTER_REGISTRY_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Convolution.hpp"
+#include "DirWatcher.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+// .ftr filter with everything convolution needs, immutable once loaded
+struct Filter {
+    fs::path path;
+    // normalized kernel, its rotation, separability factors and engine
+    PreparedKernel prepared;
+    // taps as laid out in convolution descriptor's vec4 array, empty if kernel doesn't fit into it
+    std::vector<f32> packed_taps;
+};
+
+// Every filter of directory is parsed once, edited, added and removed files are
+// picked up in background. Filters are shared, so selecting one is a pointer copy
+// and filters in use survive their reload.
+struct FilterRegistry {
+    fs::path dir_path;
+    i32 gpu_max_radius;
+    // sorted by path
+    std::vector<std::shared_ptr<const Filter>> filters;
+    // bumped on every change of filters
+    std::atomic<u64> generation{ 0 };
+    mutable std::mutex mutex;
+    // must stay last, its thread references members above
+    DirWatcher watcher;
+
+    FilterRegistry(fs::path dir_path, i32 gpu_max_radius);
+
+    // nullptr if file can't be parsed
+    static std::shared_ptr<const Filter> load(const fs::path& path, i32 gpu_max_radius);
+    static bool isFilter(const fs::path& path);
+
+    // copy of filters, generation is set to the one they belong to
+    std::vector<std::shared_ptr<const Filter>> snapshot(u64& generation) const;
+
+    void update(const fs::path& path, DirWatcher::Event event);
+};
+
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef BM_FOREGROUND_MASK_HPP
+#define BM_FOREGROUND_MASK_HPP
+
+#include <vector>
+
+#include "Image.hpp"
+#include "OrientationField.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+// Fingerprint area as mask over blocks of orientation field. Block is foreground
+// when its gray deviation and ridge coherence are both high enough, mask is then
+// cleaned up to one connected area without holes. Processing can be limited to
+// bounds (GPU passes scissor to it) or to foreground blocks (performMasked).
+struct ForegroundMask {
+    struct Box {
+        i32 x{ 0 };
+        i32 y{ 0 };
+        i32 width{ 0 };
+        i32 height{ 0 };
+    };
+
+    i32 block_size{ 0 };
+    i32 blocks_x{ 0 };
+    i32 blocks_y{ 0 };
+    // 1 for foreground, row major
+    std::vector<u8> blocks;
+    // pixels covered by foreground blocks, empty if there are none
+    Box bounds;
+
+    void compute(const Image& image, const OrientationField& field, f32 min_deviation, f32 min_coherence);
+
+    [[nodiscard]] bool empty() const { return blocks.empty(); }
+    // mask was computed for image of this size
+    [[nodiscard]] bool matches(const Image& image) const {
+        return !empty() && blocks_x == (image.width + block_size - 1) / block_size &&
+            blocks_y == (image.height + block_size - 1) / block_size;
+    }
+    [[nodiscard]] bool foreground(i32 x, i32 y) const {
+        return blocks[static_cast<std::size_t>((y / block_size) * blocks_x + x / block_size)] != 0;
+    }
+    // part of blocks that are foreground
+    [[nodiscard]] f32 coverage() const;
+    // bounds grown by halo on every side, clamped to image
+    [[nodiscard]] Box grownBounds(const Image& image, i32 halo) const;
+
+    // grown bounds of image with background blocks painted white
+    [[nodiscard]] Image crop(const Image& image, i32 halo) const;
+    // foreground blocks of cropped are written back, image takes cropped's format
+    void paste(Image& image, const Image& cropped, i32 halo) const;
+};
+
+// Runs fn(Image&) on foreground of image only, background blocks are neither
+// processed nor changed. halo pixels around bounds give filters their context.
+template<typename Fn>
+void performMasked(Image& image, const ForegroundMask& mask, i32 halo, Fn&& fn) {
+    if (mask.bounds.width == 0 || mask.bounds.height == 0) {
+        return;
+    }
+    auto cropped = mask.crop(image, halo);
+    fn(cropped);
+    mask.paste(image, cropped, halo);
+}
+
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef BM_FREQUENCY_FIELD_HPP
+#define BM_FREQUENCY_FIELD_HPP
+
+#include <vector>
+
+#include "Image.hpp"
+#include "OrientationField.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+// Local ridge frequency of every block of orientation field. Gray values of an
+// oriented window (2 * block_size along ridge normal, block_size along ridges)
+// are averaged along the ridge into x-signature, its peaks are ridge valleys
+// and mean distance between them is ridge period. Blocks without usable
+// signature are interpolated from valid neighbours.
+struct FrequencyField {
+    // valid ridge periods at 500 dpi, anything else is noise or missing ridges
+    static constexpr f32 MIN_PERIOD{ 3.F };
+    static constexpr f32 MAX_PERIOD{ 25.F };
+
+    i32 block_size{ 0 };
+    i32 blocks_x{ 0 };
+    i32 blocks_y{ 0 };
+    // ridges per pixel, always within [1 / MAX_PERIOD, 1 / MIN_PERIOD] after compute
+    std::vector<f32> frequency;
+    // 1 if block's own signature was usable, 0 if it was interpolated
+    std::vector<u8> measured;
+
+    // default_period fills the field when no block at all could be measured
+    void compute(const Image& image, const OrientationField& field, f32 default_period);
+
+    [[nodiscard]] bool empty() const { return frequency.empty(); }
+    [[nodiscard]] std::size_t index(i32 block_x, i32 block_y) const {
+        return static_cast<std::size_t>(block_y) * static_cast<std::size_t>(blocks_x) + static_cast<std::size_t>(block_x);
+    }
+    [[nodiscard]] f32 period(i32 block_x, i32 block_y) const { return 1.F / frequency[index(block_x, block_y)]; }
+};
+
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef BM_GABOR_HPP
+#define BM_GABOR_HPP
+
+#include <vector>
+
+#include "ForegroundMask.hpp"
+#include "FrequencyField.hpp"
+#include "Image.hpp"
+#include "OrientationField.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+// Even Gabor kernels quantized to orientations_num ridge orientations x periods.
+// Envelope is isotropic gaussian, so kernel g(x)g(y)cos(ax + by) is real part of
+// complex separable g(x)e^(iax) * g(y)e^(iby) and is applied as one complex row
+// pass and one complex column pass, no approximation needed.
+struct GaborBank {
+    static constexpr i32 DEFAULT_ORIENTATIONS_NUM{ 16 };
+    // gaussian sigma relative to ridge period
+    static constexpr f32 SIGMA_PER_PERIOD{ .5F };
+
+    struct Kernel {
+        i32 radius{ 0 };
+        // taps at -radius..radius, complex factors along x and along y
+        std::vector<f32> row_re;
+        std::vector<f32> row_im;
+        std::vector<f32> column_re;
+        std::vector<f32> column_im;
+    };
+
+    i32 orientations_num{ 0 };
+    // ridge periods in pixels, ascending
+    std::vector<f32> periods;
+    // orientation major
+    std::vector<Kernel> kernels;
+    i32 max_radius{ 0 };
+
+    // response to unit amplitude sinusoid matching the kernel is ~1
+    static GaborBank make(i32 orientations_num, std::vector<f32> periods);
+
+    [[nodiscard]] const Kernel& select(f32 orientation, f32 period) const;
+};
+
+// Contextual enhancement, every block of field is filtered with the kernel closest
+// to its orientation and ridge period. Image is normalized to zero mean and unit
+// deviation first, result is written as gray (ridges dark) in image's own format.
+// Background blocks of mask (on the same grid as field) are skipped and left as they are.
+void performGaborEnhancement(Image& image, const OrientationField& field, const FrequencyField& frequency, const GaborBank& bank,
+    const ForegroundMask* mask = nullptr);
+
+}
+
+#endif
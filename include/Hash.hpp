@@ -0,0 +1,23 @@
+#ifndef BM_HASH_HPP
+#define BM_HASH_HPP
+
+#include "Types.hpp"
+
+namespace bm {
+
+constexpr u64 FNV_OFFSET_BASIS{ 14695981039346656037ULL };
+
+// FNV-1a, pass previous result as seed to hash several buffers as one
+inline u64 hashBytes(const void* data, std::size_t size, u64 seed = FNV_OFFSET_BASIS) {
+    const auto* bytes = static_cast<const u8*>(data);
+    u64 hash{ seed };
+    for (std::size_t i{ 0 }; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include <array>
 #include <span>
 
+#include "Image.hpp"
 #include "Types.hpp"
 
 namespace bm {
@@ -16,12 +17,14 @@ struct Histogram {
     std::size_t full_sum{ 0 };
 
     void clear();
-    void set(const u8* data, std::size_t len, std::size_t channels_num);
+    void set(const Image& image);
 
     enum class Channel { ALL, R, G, B };
 
     void computeDistributantForChannel(std::array<f32, 256>& result, Channel channel) const;
     void normalizeForChannel(std::array<f32, 256>& result, Channel channel) const;
+    // smallest value with at least fraction of pixels <= it, 0 gives min and 1 max of channel
+    [[nodiscard]] u8 percentile(Channel channel, f32 fraction) const;
 };
 
 }
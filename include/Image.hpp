@@ -1,56 +1,78 @@
 #ifndef BM_IMAGE_HPP
 #define BM_IMAGE_HPP
 
-#include <vector>
+#include <algorithm>
 #include <filesystem>
+#include <memory>
+#include <tuple>
+#include "PixelBuffer.hpp"
+#include "PixelFormat.hpp"
 #include "Types.hpp"
 
 namespace bm {
 
+struct SaveOptions {
+    // 0 (store only, fastest) - 9, stbi's default is 8
+    i32 png_compression_level{ 8 };
+    i32 jpg_quality{ 100 };
+};
+
 struct Image {
     i32 width{ 0 };
     i32 height{ 0 };
     i32 channels_num{ 0 };
-    std::vector<u8> pixels;
+    PixelFormat format{ PixelFormat::RGBA8 };
+    // bytes per row
+    std::size_t stride{ 0 };
+    PixelBuffer pixels;
 
-    std::filesystem::path current_path; 
+    std::filesystem::path current_path;
 
     Image(const std::filesystem::path& image_path);
+    Image(i32 width, i32 height, PixelFormat format);
+
+    // reads pixels of image (e.g. cached one) in place, they are copied on first write
+    static Image sharing(const std::shared_ptr<const Image>& image);
 
-    void save(const std::filesystem::path& save_to_path) const;
+    // format is picked from extension: jpg/jpeg, png, pgm (raw 8 bit gray) or pbm (raw 1 bit)
+    bool save(const std::filesystem::path& save_to_path, const SaveOptions& options = {}) const;
+    // grayscale files are kept as GRAY8, everything else is loaded as RGBA8
     bool update(const std::filesystem::path& update_from_path);
 
+    // writes pixels converted to target format into out
+    void convertTo(PixelFormat target, PixelBuffer& out) const;
+    void convert(PixelFormat target);
+
+    [[nodiscard]] u8* row(i32 y) { return pixels.data() + static_cast<std::size_t>(y) * stride; }
+    [[nodiscard]] const u8* row(i32 y) const { return pixels.data() + static_cast<std::size_t>(y) * stride; }
+
+    [[nodiscard]] Pixel<u8> at(i32 x, i32 y) const {
+        return visitFormat(format, [&]<PixelFormat F>(FormatTag<F>) {
+            return PixelTraits<F>::load(row(y), x);
+        });
+    }
+
     template<typename T>
     requires std::same_as<T, f32> || std::same_as<T, u8>
     auto minMax() const {
         Pixel<u8> min{ lim<u8>::max(), lim<u8>::max(), lim<u8>::max() };
         Pixel<u8> max{ 0, 0, 0 };
-        for (auto i = 0UL; i < pixels.size(); i+=static_cast<std::size_t>(channels_num)) {
-            const auto r = pixels[i + 0];
-            if (min.r > r) { min.r = r; }
-            if (max.r < r) { max.r = r; }
-            
-            const auto g = pixels[i + 1];
-            if (min.g > g) { min.g = g; }
-            if (max.g < g) { max.g = g; }
-           
-            const auto b = pixels[i + 2];
-            if (min.b > b) { min.b = b; }
-            if (max.b < b) { max.b = b; }
-        }
+        visitFormat(format, [&]<PixelFormat F>(FormatTag<F>) {
+            minMaxImpl<F>(min, max);
+        });
 
         if constexpr (std::same_as<T, f32>) {
             return std::make_tuple(
-                Pixel<T>{ 
+                Pixel<T>{
                     static_cast<T>(min.r) / 255.F,
                     static_cast<T>(min.g) / 255.F,
                     static_cast<T>(min.b) / 255.F,
                 },
-                Pixel<T>{ 
+                Pixel<T>{
                     static_cast<T>(max.r) / 255.F,
                     static_cast<T>(max.g) / 255.F,
                     static_cast<T>(max.b) / 255.F,
-                } 
+                }
             );
         } else {
             return std::make_tuple(min, max);
@@ -58,9 +80,53 @@ struct Image {
 
     }
 
+    template<PixelFormat F>
+    void minMaxImpl(Pixel<u8>& min, Pixel<u8>& max) const {
+        if constexpr (F == PixelFormat::RGBA8) {
+            for (auto i = 0UL; i < pixels.size(); i+=static_cast<std::size_t>(channels_num)) {
+                const auto r = pixels[i + 0];
+                if (min.r > r) { min.r = r; }
+                if (max.r < r) { max.r = r; }
+
+                const auto g = pixels[i + 1];
+                if (min.g > g) { min.g = g; }
+                if (max.g < g) { max.g = g; }
 
+                const auto b = pixels[i + 2];
+                if (min.b > b) { min.b = b; }
+                if (max.b < b) { max.b = b; }
+            }
+        } else if constexpr (F == PixelFormat::GRAY8) {
+            const auto [min_it, max_it] = std::minmax_element(pixels.begin(), pixels.end());
+            if (min_it != pixels.end()) {
+                min = { *min_it, *min_it, *min_it };
+                max = { *max_it, *max_it, *max_it };
+            }
+        } else {
+            // only need to know whether any bit is set/cleared, padding bits are masked out
+            const auto words_per_row = stride / sizeof(u64);
+            const u64 tail_mask = (width % 64) == 0 ? ~u64{ 0 } : (u64{ 1 } << (width % 64)) - 1;
+            bool any_set{ false };
+            bool any_cleared{ false };
+            for (i32 y{ 0 }; y < height; ++y) {
+                for (std::size_t w{ 0 }; w < words_per_row; ++w) {
+                    u64 word{ 0 };
+                    std::memcpy(&word, row(y) + w * sizeof(u64), sizeof(u64));
+                    const auto mask = w + 1 == words_per_row ? tail_mask : ~u64{ 0 };
+                    any_set = any_set || (word & mask) != 0;
+                    any_cleared = any_cleared || (~word & mask) != 0;
+                }
+            }
+            if (any_set || any_cleared) {
+                const u8 min_value = any_cleared ? 0U : 255U;
+                const u8 max_value = any_set ? 255U : 0U;
+                min = { min_value, min_value, min_value };
+                max = { max_value, max_value, max_value };
+            }
+        }
+    }
 };
 
 }
 
-#endif
\ No newline at end of file
+#endif
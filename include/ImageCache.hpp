@@ -0,0 +1,65 @@
+#ifndef BM_IMAGE_CACHE_HPP
+#define BM_IMAGE_CACHE_HPP
+
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Image.hpp"
+#include "ThreadPool.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+// LRU cache of decoded images. Entries are keyed by path and validated
+// against file's mtime + size, so edited files are decoded again.
+struct ImageCache {
+    struct Stamp {
+        fs::file_time_type mtime;
+        std::uintmax_t size{ 0 };
+
+        bool operator==(const Stamp&) const = default;
+    };
+    struct Entry {
+        std::string path;
+        Stamp stamp;
+        std::shared_ptr<const Image> image;
+    };
+    using Future = std::shared_future<std::shared_ptr<const Image>>;
+
+    std::size_t budget_bytes;
+    std::size_t used_bytes{ 0 };
+    // front is the most recently used entry
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    std::unordered_map<std::string, Future> in_flight;
+    std::unordered_set<std::string> queued;
+    std::mutex mutex;
+    // must stay last, workers reference members above
+    ThreadPool workers;
+
+    ImageCache(std::size_t budget_bytes, std::size_t workers_num);
+
+    // returns cached image or decodes it on the calling thread, nullptr on failure
+    std::shared_ptr<const Image> acquire(const fs::path& path);
+    void prefetch(const fs::path& path);
+    // drops stale prefetch requests and queues files[index +- radius]
+    void prefetchNeighbours(const std::vector<fs::path>& files, std::size_t index, std::size_t radius = 2);
+
+    void setBudget(std::size_t budget_bytes);
+    void clear();
+
+    std::shared_ptr<const Image> load(const std::string& path, Stamp stamp);
+    std::shared_ptr<const Image> lookup(const std::string& path, Stamp stamp);
+    void insert(const std::string& path, Stamp stamp, std::shared_ptr<const Image> image);
+    void evict(std::size_t required_bytes);
+};
+
+}
+
+#endif
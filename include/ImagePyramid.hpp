@@ -0,0 +1,42 @@
+#ifndef BM_IMAGE_PYRAMID_HPP
+#define BM_IMAGE_PYRAMID_HPP
+
+#include <vector>
+
+#include "Image.hpp"
+#include "PixelBuffer.hpp"
+#include "Texture2D.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+// Mip levels of image for zoomed out viewing. Levels are 2x2 box filtered on CPU
+// and uploaded into texture's mip chain coarsest first, budget bytes at a time,
+// so big image is shown (blurred) right away and sharpens as finer levels arrive.
+// Only levels that are already uploaded are ever selected for sampling.
+struct ImagePyramid {
+    // levels[i] is mip level i + 1, GRAY8 or RGBA8 (BINARY1 is reduced as GRAY8)
+    std::vector<Image> levels;
+    // BINARY1 base converted to GRAY8, empty for other formats
+    PixelBuffer base_scratch;
+    // next level to upload, -1 once whole chain is uploaded
+    i32 pending_level{ -1 };
+    // finest level texture holds valid data for
+    i32 uploaded_level{ 0 };
+
+    // image must stay unchanged until pending levels are uploaded (or build is called again)
+    void build(const Image& image);
+    // uploads pending levels until budget bytes were sent, at least one level per call
+    void upload(const Texture2D& texture, const Image& image, std::size_t budget);
+    void flush(const Texture2D& texture, const Image& image);
+    // level 0 was changed on GPU, nothing is pending then, rest of chain is regenerated there
+    void regenerate(const Texture2D& texture);
+
+    // level closest to one texel per screen pixel that is already uploaded
+    [[nodiscard]] i32 selectLevel(f32 texels_per_px) const;
+    [[nodiscard]] i32 levelsNum() const { return static_cast<i32>(levels.size()) + 1; }
+};
+
+}
+
+#endif
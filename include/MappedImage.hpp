@@ -0,0 +1,73 @@
+#ifndef BM_MAPPED_IMAGE_HPP
+#define BM_MAPPED_IMAGE_HPP
+
+#include <algorithm>
+
+#include "Image.hpp"
+#include "PixelBuffer.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+// Read-only window onto pixel rows which live somewhere else (mapped file, Image).
+struct ImageView {
+    enum class Encoding : i32 {
+        GRAY8,
+        // pbm P4 payload, MSB first, set bit == black
+        PBM1
+    };
+
+    const u8* data{ nullptr };
+    i32 width{ 0 };
+    i32 height{ 0 };
+    std::size_t stride{ 0 };
+    Encoding encoding{ Encoding::GRAY8 };
+    // largest GRAY8 sample (pgm maxval), rows hold samples as stored and readers
+    // scale them to 0-255 with level() when it is below 255
+    u32 max_value{ 255 };
+
+    [[nodiscard]] const u8* row(i32 y) const { return data + static_cast<std::size_t>(y) * stride; }
+    [[nodiscard]] u8 level(u8 sample) const {
+        return max_value == 255 ? sample : static_cast<u8>(std::min<u32>(sample, max_value) * 255U / max_value);
+    }
+    [[nodiscard]] u8 gray(i32 x, i32 y) const {
+        if (encoding == Encoding::GRAY8) {
+            return level(row(y)[x]);
+        }
+        return ((row(y)[x >> 3] >> (7 - (x & 7))) & 1U) != 0 ? 0U : 255U;
+    }
+};
+
+// Memory maps binary pgm (P5, maxval <= 255), pbm (P4) and raw 8 bit
+// files described by a sidecar header (<path>.hdr holding "width W",
+// "height H" and optionally "offset O", "stride S" lines). Mapping is
+// private copy-on-write and nothing is read up front, pages are faulted
+// in when pixels are accessed.
+struct MappedImage {
+    u8* base{ nullptr };
+    std::size_t length{ 0 };
+    ImageView view;
+
+    MappedImage() = default;
+    MappedImage(const MappedImage&) = delete;
+    MappedImage(MappedImage&& other) noexcept;
+    MappedImage& operator=(const MappedImage&) = delete;
+    MappedImage& operator=(MappedImage&& other) noexcept;
+    ~MappedImage();
+
+    static bool isSupported(const fs::path& path);
+    // dimensions from header (or sidecar header) alone, nothing is mapped
+    static bool readSize(const fs::path& path, i32& width, i32& height);
+
+    bool open(const fs::path& path);
+    void close();
+
+    // hands GRAY8 mapping over to PixelBuffer (unmapped by its deleter), MappedImage is closed afterwards
+    PixelBuffer takePixels();
+    // decodes view into new image of given format
+    [[nodiscard]] Image toImage(PixelFormat format) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef BM_MINUTIAE_HPP
+#define BM_MINUTIAE_HPP
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "ForegroundMask.hpp"
+#include "Image.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+// Ridge flags of skeleton (ridges are black pixels) with one pixel of background
+// around, so neighbours never need bound checks.
+struct RidgeMap {
+    // 8 neighbours in circular order, index is also Freeman chain code of step to it
+    static constexpr std::array<std::array<i32, 2>, 8> CIRCLE{{
+        { 1, 0 }, { 1, -1 }, { 0, -1 }, { -1, -1 }, { -1, 0 }, { -1, 1 }, { 0, 1 }, { 1, 1 }
+    }};
+
+    i32 width{ 0 };
+    i32 height{ 0 };
+    i32 stride{ 0 };
+    std::vector<u8> ridges;
+
+    explicit RidgeMap(const Image& skeleton);
+
+    // x and y may be one pixel outside of image
+    [[nodiscard]] std::size_t index(i32 x, i32 y) const {
+        return static_cast<std::size_t>((y + 1) * stride + x + 1);
+    }
+    [[nodiscard]] bool ridge(i32 x, i32 y) const { return ridges[index(x, y)] != 0U; }
+    // half of transitions around 8 neighbours: 0 isolated, 1 ending, 2 ridge, 3+ junction
+    [[nodiscard]] i32 crossingNumber(i32 x, i32 y) const;
+};
+
+struct Minutia {
+    enum class Type : u8 { ENDING, BIFURCATION };
+
+    i32 x{ 0 };
+    i32 y{ 0 };
+    Type type{ Type::ENDING };
+};
+
+// Uniform grid over minutiae positions, items of every cell are stored contiguously
+// (counting sort), so building is linear and a query only visits cells around it.
+struct SpatialHash {
+    i32 cell_size{ 1 };
+    i32 cells_x{ 0 };
+    i32 cells_y{ 0 };
+    // items of cell c are items[cell_begin[c]..cell_begin[c + 1])
+    std::vector<i32> cell_begin;
+    std::vector<i32> items;
+
+    void build(const std::vector<Minutia>& minutiae, i32 width, i32 height, i32 cell_size);
+
+    // calls fn(index) for every minutia in cells touched by square of radius around (x, y)
+    template<typename Fn>
+    void forEachNear(i32 x, i32 y, i32 radius, Fn&& fn) const {
+        const auto cell_x0 = std::max((x - radius) / cell_size, 0);
+        const auto cell_y0 = std::max((y - radius) / cell_size, 0);
+        const auto cell_x1 = std::min((x + radius) / cell_size, cells_x - 1);
+        const auto cell_y1 = std::min((y + radius) / cell_size, cells_y - 1);
+        for (auto cell_y{ cell_y0 }; cell_y <= cell_y1; ++cell_y) {
+            for (auto cell_x{ cell_x0 }; cell_x <= cell_x1; ++cell_x) {
+                const auto cell = static_cast<std::size_t>(cell_y * cells_x + cell_x);
+                for (auto i{ cell_begin[cell] }; i < cell_begin[cell + 1]; ++i) {
+                    fn(items[static_cast<std::size_t>(i)]);
+                }
+            }
+        }
+    }
+};
+
+struct MinutiaeFilter {
+    // minutiae of a pair closer than this are both dropped (broken ridges, bridges, spurs)
+    f32 ridge_distance{ 9.F };
+    // minutiae this close to image border or to background of mask are dropped
+    i32 border_distance{ 16 };
+    // ending whose ridge reaches bifurcation (or another ending) within this many pixels is a spur
+    i32 max_spur_length{ 12 };
+};
+
+struct MinutiaeStats {
+    std::size_t detected{ 0 };
+    std::size_t border{ 0 };
+    std::size_t spurs{ 0 };
+    std::size_t pairs{ 0 };
+};
+
+// Crossing number minutiae of skeleton, ridges are black and one pixel wide.
+std::vector<Minutia> detectMinutiae(const Image& skeleton);
+
+// Drops border minutiae, spurs and short ridges traced along skeleton, then pairs
+// closer than ridge_distance. Neighbours are looked up in SpatialHash, so it runs in
+// near linear time. mask may be nullptr, otherwise it has to match skeleton.
+std::vector<Minutia> removeFalseMinutiae(const std::vector<Minutia>& minutiae, const Image& skeleton,
+    const MinutiaeFilter& filter, const ForegroundMask* mask, MinutiaeStats& stats);
+
+// marks endings red and bifurcations blue, image is converted to RGBA8 first
+void drawMinutiae(Image& image, const std::vector<Minutia>& minutiae);
+// counts followed by one "type x y" line per minutia
+bool writeMinutiae(const fs::path& path, const std::vector<Minutia>& minutiae, const MinutiaeStats& stats);
+
+}
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef BM_MORPHOLOGY_HPP
+#define BM_MORPHOLOGY_HPP
+
+#include "Image.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+enum class MorphologyOperation : i32 { ERODE, DILATE, OPEN, CLOSE };
+
+const char* morphologyName(MorphologyOperation operation);
+
+// rectangle of (2 * radius_x + 1) x (2 * radius_y + 1) pixels centred on pixel
+struct StructuringElement {
+    i32 radius_x{ 1 };
+    i32 radius_y{ 1 };
+};
+
+// Erosion is minimum and dilation maximum of gray values under element, so erosion
+// grows dark ridges. Rectangle is separated into a row and a column pass, both use
+// van Herk/Gil-Werman block prefix and suffix extrema, i.e. three comparisons per
+// pixel whatever the radius. BINARY1 is processed as 64 pixel words with AND/OR.
+// Pixels outside image don't take part, RGBA8 keeps alpha.
+void performMorphology(Image& image, MorphologyOperation operation, StructuringElement element);
+
+}
+
+#endif
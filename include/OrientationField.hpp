@@ -0,0 +1,43 @@
+#ifndef BM_ORIENTATION_FIELD_HPP
+#define BM_ORIENTATION_FIELD_HPP
+
+#include <vector>
+
+#include "Image.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+// Ridge orientation of every block_size x block_size block. Sobel gradients are
+// turned into doubled-angle vectors (gx^2 - gy^2, 2 gx gy) in one fused pass over
+// gray rows and summed per block, so both flanks of a ridge add up instead of
+// cancelling. Vectors are averaged over (2 * smoothing_radius + 1)^2 neighbouring
+// blocks using integral image of block sums, which smooths the field.
+struct OrientationField {
+    i32 block_size{ 0 };
+    i32 blocks_x{ 0 };
+    i32 blocks_y{ 0 };
+    // ridge direction in [0, pi), angle from x axis towards y axis (image rows go down)
+    std::vector<f32> orientation;
+    // length of averaged vector over averaged gradient energy, 0 for flat/noisy blocks, 1 for parallel ridges
+    std::vector<f32> coherence;
+
+    void compute(const Image& image, i32 block_size, i32 smoothing_radius);
+
+    [[nodiscard]] bool empty() const { return orientation.empty(); }
+    [[nodiscard]] std::size_t index(i32 block_x, i32 block_y) const {
+        return static_cast<std::size_t>(block_y) * static_cast<std::size_t>(blocks_x) + static_cast<std::size_t>(block_x);
+    }
+    // orientation of block containing pixel
+    [[nodiscard]] f32 atPixel(i32 x, i32 y) const {
+        return orientation[index(x / block_size, y / block_size)];
+    }
+};
+
+// Draws ridge direction of every block as a red segment through its centre,
+// image is converted to RGBA8 first. Blocks without any ridges are skipped.
+void drawOrientationField(Image& image, const OrientationField& field);
+
+}
+
+#endif
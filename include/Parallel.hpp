@@ -0,0 +1,44 @@
+#ifndef BM_PARALLEL_HPP
+#define BM_PARALLEL_HPP
+
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "Types.hpp"
+
+namespace bm {
+
+// number of row bands worth spawning for rows, each band gets at least min_band_rows rows
+inline i32 bandsNum(i32 rows, i32 min_band_rows) {
+    const auto threads_num = static_cast<i32>(std::max(std::thread::hardware_concurrency(), 1U));
+    return std::clamp(rows / std::max(min_band_rows, 1), 1, threads_num);
+}
+
+// Splits [0, rows) into bands_num contiguous bands and calls fn(band, begin, end)
+// for each of them, first band runs on calling thread. Returns after every band
+// is done, exceptions thrown by fn are rethrown here.
+template<typename Fn>
+void parallelForBands(i32 bands_num, i32 rows, Fn&& fn) {
+    bands_num = std::clamp(bands_num, 1, std::max(rows, 1));
+    const auto band_begin = [&](i32 band) {
+        return static_cast<i32>(static_cast<i64>(rows) * band / bands_num);
+    };
+
+    std::vector<std::future<void>> bands;
+    bands.reserve(static_cast<std::size_t>(bands_num - 1));
+    for (i32 band{ 1 }; band < bands_num; ++band) {
+        bands.push_back(std::async(std::launch::async, [&fn, band, begin = band_begin(band), end = band_begin(band + 1)] {
+            fn(band, begin, end);
+        }));
+    }
+    fn(0, 0, band_begin(1));
+    for (auto& band : bands) {
+        band.get();
+    }
+}
+
+}
+
+#endif
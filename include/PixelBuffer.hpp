@@ -0,0 +1,104 @@
+#ifndef BM_PIXEL_BUFFER_HPP
+#define BM_PIXEL_BUFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Types.hpp"
+
+namespace bm {
+
+// Size-classed pool of pixel allocations. Every block is prefixed with a
+// header holding its class, so blocks can be released by pointer only
+// (this is what lets stb_image allocate from the pool).
+struct PixelPool {
+    static constexpr std::size_t ALIGNMENT{ 64 };
+    static constexpr std::size_t MIN_CLASS_LOG2{ 16 }; // smaller blocks aren't pooled
+    static constexpr std::size_t CLASSES_NUM{ 16 };    // up to 2^31 bytes
+    static constexpr std::size_t DEFAULT_MAX_RETAINED_BYTES{ 512UL << 20U };
+
+    std::array<std::vector<void*>, CLASSES_NUM> free_blocks;
+    std::size_t retained_bytes{ 0 };
+    std::size_t max_retained_bytes{ DEFAULT_MAX_RETAINED_BYTES };
+    std::mutex mutex;
+
+    static PixelPool& instance();
+
+    void* allocate(std::size_t size);
+    void* reallocate(void* ptr, std::size_t size);
+    void release(void* ptr);
+    // returns usable size of block allocated by the pool
+    static std::size_t capacity(const void* ptr);
+
+    // frees retained blocks until at most max_retained_bytes are kept
+    void trim(std::size_t max_retained_bytes);
+
+    ~PixelPool();
+};
+
+void* pixelPoolMalloc(std::size_t size);
+void* pixelPoolRealloc(void* ptr, std::size_t size);
+void pixelPoolFree(void* ptr);
+
+// Owning pixel storage. Memory is either drawn from PixelPool or adopted
+// from a decoder together with its deleter. Unlike std::vector resizing
+// doesn't zero-fill. Pixels can also be shared read-only with another
+// owner (e.g. cached image), first mutable access copies them.
+struct PixelBuffer {
+    using Deleter = void (*)(void*);
+
+    u8* data_{ nullptr };
+    std::size_t size_{ 0 };
+    std::size_t capacity_{ 0 };
+    Deleter deleter_{ nullptr };
+    // keeps shared pixels alive, data_ points into them while shared_flag_ is set
+    std::shared_ptr<const u8> shared_;
+    // checked by mutable accessors, parallel bands may touch buffer first at once
+    std::atomic<bool> shared_flag_{ false };
+
+    PixelBuffer() = default;
+    PixelBuffer(const PixelBuffer& other);
+    PixelBuffer(PixelBuffer&& other) noexcept;
+    PixelBuffer& operator=(const PixelBuffer& other);
+    PixelBuffer& operator=(PixelBuffer&& other) noexcept;
+    ~PixelBuffer();
+
+    // takes ownership of data, if deleter is pixelPoolFree the block is reused by resize
+    static PixelBuffer adopt(u8* data, std::size_t size, Deleter deleter);
+    // reads size bytes of data in place until buffer is written to, copies share them too
+    static PixelBuffer share(std::shared_ptr<const u8> data, std::size_t size);
+
+    // contents are unspecified after resize unless the buffer had enough capacity
+    void resize(std::size_t size);
+    [[nodiscard]] std::size_t capacity() const { return capacity_; }
+    void reset();
+
+    [[nodiscard]] bool shared() const { return shared_flag_.load(std::memory_order_acquire); }
+    // copies shared pixels into own block, no-op for owned ones
+    void detach() {
+        if (shared()) [[unlikely]] {
+            copyShared();
+        }
+    }
+    void copyShared();
+
+    [[nodiscard]] u8* data() { detach(); return data_; }
+    [[nodiscard]] const u8* data() const { return data_; }
+    [[nodiscard]] std::size_t size() const { return size_; }
+    [[nodiscard]] bool empty() const { return size_ == 0; }
+
+    u8& operator[](std::size_t i) { detach(); return data_[i]; }
+    const u8& operator[](std::size_t i) const { return data_[i]; }
+
+    u8* begin() { detach(); return data_; }
+    u8* end() { detach(); return data_ + size_; }
+    const u8* begin() const { return data_; }
+    const u8* end() const { return data_ + size_; }
+};
+
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef BM_PIXEL_FORMAT_HPP
+#define BM_PIXEL_FORMAT_HPP
+
+#include <bit>
+#include <cstring>
+#include <type_traits>
+
+#include "Types.hpp"
+
+namespace bm {
+
+enum class PixelFormat : i32 {
+    GRAY8,
+    RGBA8,
+    // 1 bit per pixel, LSB first, rows padded to 64 bits, set bit == white
+    BINARY1
+};
+
+template<PixelFormat F>
+using FormatTag = std::integral_constant<PixelFormat, F>;
+
+template<PixelFormat F>
+struct PixelTraits;
+
+template<>
+struct PixelTraits<PixelFormat::GRAY8> {
+    static constexpr i32 channels_num{ 1 };
+
+    static std::size_t stride(i32 width) {
+        return static_cast<std::size_t>(width);
+    }
+    static u8 gray(const u8* row, i32 x) {
+        return row[x];
+    }
+    static Pixel<u8> load(const u8* row, i32 x) {
+        const auto value = row[x];
+        return { value, value, value };
+    }
+    static void store(u8* row, i32 x, Pixel<u8> px) {
+        row[x] = static_cast<u8>((static_cast<u32>(px.r) + px.g + px.b) / 3U);
+    }
+    static void storeGray(u8* row, i32 x, u8 value) {
+        row[x] = value;
+    }
+};
+
+template<>
+struct PixelTraits<PixelFormat::RGBA8> {
+    static constexpr i32 channels_num{ 4 };
+
+    static std::size_t stride(i32 width) {
+        return static_cast<std::size_t>(width) * 4;
+    }
+    static u8 gray(const u8* row, i32 x) {
+        const auto* px = row + 4 * x;
+        return static_cast<u8>((static_cast<u32>(px[0]) + px[1] + px[2]) / 3U);
+    }
+    static Pixel<u8> load(const u8* row, i32 x) {
+        const auto* px = row + 4 * x;
+        return { px[0], px[1], px[2] };
+    }
+    // alpha is left untouched
+    static void store(u8* row, i32 x, Pixel<u8> px) {
+        auto* dst = row + 4 * x;
+        dst[0] = px.r;
+        dst[1] = px.g;
+        dst[2] = px.b;
+    }
+    static void storeGray(u8* row, i32 x, u8 value) {
+        auto* dst = row + 4 * x;
+        dst[0] = dst[1] = dst[2] = value;
+    }
+};
+
+template<>
+struct PixelTraits<PixelFormat::BINARY1> {
+    static constexpr i32 channels_num{ 1 };
+    static constexpr u8 THRESHOLD{ 128 };
+
+    static std::size_t stride(i32 width) {
+        return static_cast<std::size_t>((width + 63) / 64) * sizeof(u64);
+    }
+    static bool bit(const u8* row, i32 x) {
+        u64 word{ 0 };
+        std::memcpy(&word, row + static_cast<std::size_t>(x >> 6) * sizeof(u64), sizeof(u64));
+        return ((word >> (x & 63)) & 1U) != 0;
+    }
+    static void setBit(u8* row, i32 x, bool value) {
+        auto* byte = row + (x >> 3);
+        const auto mask = static_cast<u8>(1U << (x & 7));
+        *byte = value ? static_cast<u8>(*byte | mask) : static_cast<u8>(*byte & ~mask);
+    }
+    static u8 gray(const u8* row, i32 x) {
+        return bit(row, x) ? 255U : 0U;
+    }
+    static Pixel<u8> load(const u8* row, i32 x) {
+        const auto value = gray(row, x);
+        return { value, value, value };
+    }
+    static void store(u8* row, i32 x, Pixel<u8> px) {
+        setBit(row, x, (static_cast<u32>(px.r) + px.g + px.b) / 3U >= THRESHOLD);
+    }
+    static void storeGray(u8* row, i32 x, u8 value) {
+        setBit(row, x, value >= THRESHOLD);
+    }
+};
+
+static_assert(std::endian::native == std::endian::little, "BINARY1 words are stored as little endian bytes");
+
+// calls fn(FormatTag<F>{}) for runtime format so templated code can be selected per format
+template<typename Fn>
+decltype(auto) visitFormat(PixelFormat format, Fn&& fn) {
+    switch (format) {
+    case PixelFormat::GRAY8: return fn(FormatTag<PixelFormat::GRAY8>{});
+    case PixelFormat::BINARY1: return fn(FormatTag<PixelFormat::BINARY1>{});
+    case PixelFormat::RGBA8: break;
+    }
+    return fn(FormatTag<PixelFormat::RGBA8>{});
+}
+
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef BM_RIDGE_GRAPH_HPP
+#define BM_RIDGE_GRAPH_HPP
+
+#include <array>
+#include <vector>
+
+#include "Image.hpp"
+#include "Minutiae.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+// Skeleton as graph: endings and junctions are nodes, ridges between them are
+// edges stored as Freeman chain codes (RidgeMap::CIRCLE) from their first pixel.
+// Junctions made of several adjacent pixels are one node. Closed ridges without
+// any junction get one LOOP node, so every traced ridge pixel belongs to an edge.
+struct RidgeGraph {
+    struct Node {
+        enum class Type : u8 { ENDING, BIFURCATION, LOOP };
+
+        i32 x{ 0 };
+        i32 y{ 0 };
+        Type type{ Type::ENDING };
+        // edges ending in node, self loops count twice
+        i32 degree{ 0 };
+    };
+
+    struct Edge {
+        i32 from{ 0 };
+        i32 to{ 0 };
+        // pixel of from node the ridge leaves from
+        i32 x{ 0 };
+        i32 y{ 0 };
+        // codes[chain_begin..chain_begin + chain_length), last step enters pixel of to node
+        std::size_t chain_begin{ 0 };
+        i32 chain_length{ 0 };
+    };
+
+    // size of traced skeleton
+    i32 width{ 0 };
+    i32 height{ 0 };
+    std::vector<Node> nodes;
+    std::vector<Edge> edges;
+    std::vector<u8> codes;
+
+    // every ridge pixel is stepped on once, pixels of junctions once per edge leaving them
+    void build(const Image& skeleton);
+
+    [[nodiscard]] bool empty() const { return nodes.empty(); }
+    // pixels of edge from its first to its last one
+    [[nodiscard]] std::vector<std::array<i32, 2>> polyline(const Edge& edge) const;
+    // length with diagonal steps counted as sqrt(2)
+    [[nodiscard]] f32 length(const Edge& edge) const;
+    [[nodiscard]] std::size_t bytes() const;
+};
+
+// paints every edge with its own color and marks nodes, image is converted to RGBA8 first,
+// nothing is drawn into image of other size than the traced one
+void drawRidgeGraph(Image& image, const RidgeGraph& graph);
+
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef BM_SAVE_QUEUE_HPP
+#define BM_SAVE_QUEUE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "Image.hpp"
+#include "ThreadPool.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+// Encodes and writes images on worker threads. At most max_in_flight
+// jobs (each holding a copy of the image) exist at once. Completion
+// callbacks are run by poll(), so they execute on the thread driving
+// the queue (the render thread) and may touch GL/UI state.
+struct SaveQueue {
+    using Callback = std::function<void(const fs::path& path, bool success)>;
+
+    struct Completion {
+        fs::path path;
+        bool success;
+        Callback callback;
+    };
+
+    std::size_t max_in_flight;
+    std::size_t in_flight{ 0 };
+    std::deque<Completion> completions;
+    std::mutex mutex;
+    std::condition_variable cv;
+    // must stay last, workers reference members above
+    ThreadPool workers;
+
+    SaveQueue(std::size_t workers_num, std::size_t max_in_flight);
+
+    // blocks while max_in_flight jobs are pending
+    void submit(Image image, fs::path path, SaveOptions options, Callback callback = nullptr);
+    // returns false instead of blocking when the queue is full, image is
+    // copied only once a slot is reserved
+    bool trySubmit(const Image& image, fs::path path, SaveOptions options, Callback callback = nullptr);
+
+    // runs callbacks of finished jobs, returns their count
+    std::size_t poll();
+    // blocks until every submitted job is finished, then polls
+    void wait();
+
+    [[nodiscard]] std::size_t pending();
+
+    void enqueue(Image&& image, fs::path&& path, SaveOptions options, Callback&& callback);
+};
+
+}
+
+#endif
@@ -11,24 +11,59 @@
 namespace bm {
 
 struct Shader {
-    enum class Type : std::size_t { 
-        COMPUTE = 1, 
-        VERTEX_FRAGMENT = 2 
+    enum class Type : std::size_t {
+        COMPUTE = 1,
+        VERTEX_FRAGMENT = 2
     };
 
-	std::uint32_t prog_id_;
-	std::array<std::uint32_t, 2> shader_ids_;
+    // queried once, on creation of first program
+    struct Capabilities {
+        bool arb_spirv{ false };
+        bool program_binary{ false };
+        // vendor, renderer and version, program binaries are only valid for the same driver
+        std::string driver;
+    };
+
+    // linked programs are stored here by glGetProgramBinary, empty path disables the cache
+    static inline std::filesystem::path binary_cache_dir{ "shaders/cache" };
+
+	// value of SPIR-V specialization constant with given constant_id
+	struct SpecializationConstant {
+		std::uint32_t id;
+		std::uint32_t value;
+	};
+	using Specialization = std::vector<SpecializationConstant>;
+
+	// program specialized with some constants, prog_id 0 if specialization failed
+	struct Variant {
+		std::uint64_t key;
+		std::uint32_t prog_id;
+	};
+
+	// program is created on first bind(), Shader objects can be declared before they are needed
+	mutable std::uint32_t prog_id_{ 0 };
+	mutable std::vector<Variant> variants_;
     Type type_;
+    std::vector<std::filesystem::path> paths_;
 
 	Shader(Type type, const std::vector<std::filesystem::path>& paths);
+	static const Capabilities& capabilities();
 	static std::vector<char> parseAsSpirv(const std::filesystem::path &path);
 	static void compileShader(const std::filesystem::path &path, std::uint32_t shader_id);
 
+	void create() const;
 	void bind() const;
+	// binds variant with given constants, building it on first use; falls back to
+	// default program for runtime compiled shaders or when specialization fails
+	void bind(const Specialization &constants) const;
 
 	void deinit();
+
+	std::uint32_t build(const Specialization &constants) const;
+	std::uint32_t loadBinary(const std::filesystem::path &cache_path) const;
+	void storeBinary(std::uint32_t prog_id, const std::filesystem::path &cache_path) const;
 };
 
 } // namespace rw_cube
 
-#endif
\ No newline at end of file
+#endif
@@ -5,9 +5,10 @@
 
 namespace bm {
 
-void performKMMSkeletonization(void* pixels, i32 width, i32 height, i32 channels_num);
-void performK3MSkeletonization(void* pixels, i32 width, i32 height, i32 channels_num);
-void performCrossingNumber(void* pixels, i32 width, i32 height, i32 channels_num, const fs::path& output_file_path);
+void performKMMSkeletonization(Image& image);
+void performK3MSkeletonization(Image& image);
+// minutiae are marked with colors, so image is converted to RGBA8 first
+void performCrossingNumber(Image& image, const fs::path& output_file_path);
 
 }
 
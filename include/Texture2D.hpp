@@ -1,6 +1,8 @@
 #ifndef BM_TEXTURE2D_HPP
 #define BM_TEXTURE2D_HPP
 
+#include <utility>
+
 #include "Types.hpp"
 
 namespace bm {
@@ -23,7 +25,16 @@ struct Texture2D {
 
     Texture2D(Config config);
     void resize(i32 width, i32 height);
-    void update(const void* data) const;
+    // full mip chain down to 1x1, allocated when config.mipmap is set
+    static i32 levelsNum(i32 width, i32 height);
+    void update(const void* data, i32 level = 0) const;
+    [[nodiscard]] std::pair<i32, i32> levelSize(i32 level) const;
+    // levels are left undefined until uploaded or generated from level 0
+    void generateMipmap() const;
+    // sampling starts at level, has to be back at 0 before texture is processed
+    void baseLevel(i32 level) const;
+    // single channel data is shown as gray instead of red
+    void swizzleGray(bool enabled) const;
     void deinit();
 
     void bind(u32 tex_unit) const;
@@ -0,0 +1,65 @@
+#ifndef BM_THINNING_HPP
+#define BM_THINNING_HPP
+
+#include <array>
+#include <vector>
+
+#include "Image.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+enum class ThinningAlgorithm : i32 { KMM, K3M, ZHANG_SUEN, GUO_HALL };
+
+// Thinning algorithm to choose by speed and quality, perform thins black ridges of
+// image in place and leaves it in its format with ridges 0 and background 255.
+struct Thinner {
+    ThinningAlgorithm algorithm;
+    const char* name;
+    // pixels of every subiteration are decided from previous one only, so rows run in parallel
+    bool parallel;
+    const char* description;
+    void (*perform)(Image&);
+};
+
+inline constexpr std::size_t THINNERS_COUNT{ 4 };
+
+const std::array<Thinner, THINNERS_COUNT>& thinners();
+const Thinner& thinner(ThinningAlgorithm algorithm);
+
+// Two subiteration thinning of Zhang and Suen. Pixel of subiteration is removed when
+// it has 2 to 6 ridge neighbours, one background to ridge transition around it and
+// background on south or east (first) / north or west (second subiteration). Tends
+// to leave staircase corners on diagonal ridges.
+void performZhangSuenThinning(Image& image);
+// Two subiteration thinning of Guo and Hall (algorithm A1), removes pixels that join
+// a single 8-connected ridge with 2 or 3 neighbour pairs. Leaves one pixel wide
+// 8-connected ridges and is no slower than Zhang-Suen.
+void performGuoHallThinning(Image& image);
+
+// Result of one thinner on one binarized image.
+struct ThinningStats {
+    f64 milliseconds{ 0. };
+    std::size_t ridge_pixels{ 0 };
+    // ridge pixels with 2 or more ridge neighbours forming one 8-connected ridge, e.g.
+    // corners of staircases, removable without breaking ridge, 0 for one pixel wide skeleton
+    std::size_t redundant_pixels{ 0 };
+    std::size_t endings{ 0 };
+    std::size_t bifurcations{ 0 };
+};
+
+// runs thinner on copy of binarized image
+ThinningStats measureThinning(const Image& binarized, const Thinner& thinner);
+
+struct ThinningBenchmarkRow {
+    fs::path path;
+    ThinningAlgorithm algorithm;
+    ThinningStats stats;
+};
+
+// one csv line per row
+bool writeThinningBenchmark(const fs::path& path, const std::vector<ThinningBenchmarkRow>& rows);
+
+}
+
+#endif
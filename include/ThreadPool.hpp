@@ -0,0 +1,33 @@
+#ifndef BM_THREAD_POOL_HPP
+#define BM_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Types.hpp"
+
+namespace bm {
+
+struct ThreadPool {
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stop{ false };
+
+    ThreadPool(std::size_t workers_num);
+
+    void submit(std::function<void()> task);
+    // drops every task which wasn't picked up by a worker yet
+    void discardPending();
+
+    ~ThreadPool();
+};
+
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef BM_TILE_HISTOGRAMS_HPP
+#define BM_TILE_HISTOGRAMS_HPP
+
+#include <array>
+#include <vector>
+
+#include "Histogram.hpp"
+#include "Image.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+// Gray level histograms of image split into grid of roughly tile_size x tile_size
+// tiles, all of them are built in one (parallel) pass over pixels.
+struct TileHistograms {
+    i32 tiles_x{ 0 };
+    i32 tiles_y{ 0 };
+    i32 tile_width{ 0 };
+    i32 tile_height{ 0 };
+    // row major, tiles_x * tiles_y
+    std::vector<std::array<u32, 256>> sums;
+
+    // ALL counts gray (mean) values, single channel formats give the same for every channel
+    void set(const Image& image, i32 tile_size, Histogram::Channel channel = Histogram::Channel::ALL);
+
+    [[nodiscard]] const std::array<u32, 256>& at(i32 tile_x, i32 tile_y) const {
+        return sums[static_cast<std::size_t>(tile_y * tiles_x + tile_x)];
+    }
+};
+
+// Otsu threshold is found for every tile and interpolated bilinearly between
+// tile centres, tiles with too little contrast fall back to global threshold.
+// Result is written as 0/255 gray in image's own format.
+void performAdaptiveOtsu(Image& image, i32 tile_size);
+
+// Contrast limited adaptive equalization. Every tile's histogram is clipped at
+// clip_limit times the mean bin count (excess is spread over all bins) and turned
+// into a mapping, pixels blend mappings of their four nearest tiles. RGBA8 images
+// are equalized per channel.
+void performCLAHE(Image& image, i32 tile_size, f32 clip_limit);
+
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef BM_TILED_IMAGE_HPP
+#define BM_TILED_IMAGE_HPP
+
+#include <fstream>
+#include <functional>
+
+#include "Image.hpp"
+#include "MappedImage.hpp"
+#include "Types.hpp"
+
+namespace bm {
+
+struct TileRect {
+    i32 x{ 0 };
+    i32 y{ 0 };
+    i32 width{ 0 };
+    i32 height{ 0 };
+};
+
+// GRAY8 image which stays in a file and is only ever touched region by
+// region. Sources are opened through MappedImage (pgm or raw + .hdr),
+// results are written into a pgm created with create(). Reading and
+// writing the same file at once isn't supported.
+struct TiledImage {
+    i32 width{ 0 };
+    i32 height{ 0 };
+    MappedImage source;
+    std::fstream output;
+    std::streamoff output_payload_offset{ 0 };
+
+    bool open(const fs::path& path);
+    bool create(const fs::path& path, i32 width, i32 height);
+    void close();
+
+    // rect grown by halo on each side, pixels outside image repeat the nearest edge
+    void readRegion(TileRect rect, i32 halo, Image& out) const;
+    // writes rect's pixels from tile which has halo pixels around them
+    bool writeRegion(TileRect rect, i32 halo, const Image& tile);
+};
+
+struct TileOptions {
+    // processing keeps at most two tile sized buffers (tile and its result) alive
+    std::size_t memory_budget{ 64UL << 20U };
+    // e.g. GL_MAX_TEXTURE_SIZE when tiles are processed on the GPU
+    i32 max_side{ 8192 };
+    // neighbourhood radius of the algorithm, kernel_size for the filters
+    i32 halo{ 0 };
+};
+
+// returns side of square tile (without halo) which together with its halo
+// satisfies options, 0 when halo leaves no room for the tile (2 * halo >= max side)
+i32 tileSide(const TileOptions& options);
+
+// Streams src through fn tile by tile and stores interiors into dst.
+// fn gets GRAY8 tile with halo and modifies it in place.
+bool processTiled(
+    const TiledImage& src, TiledImage& dst,
+    const TileOptions& options,
+    const std::function<void(Image& tile, TileRect rect)>& fn
+);
+
+}
+
+#endif
@@ -1,5 +1,11 @@
+#include <PixelBuffer.hpp>
+
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
+// decoded images (and decoder scratch buffers) are drawn from PixelPool
+#define STBI_MALLOC(size) bm::pixelPoolMalloc(size)
+#define STBI_REALLOC(ptr, size) bm::pixelPoolRealloc(ptr, size)
+#define STBI_FREE(ptr) bm::pixelPoolFree(ptr)
 #include <stb_image.h>
 #endif
 
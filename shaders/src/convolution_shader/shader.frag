@@ -6,6 +6,9 @@ layout(binding = 5) uniform sampler2D u_tex;
 
 layout(location = 0) in vec2 in_texcoord;
 
+// kernel size the variant is built for, loops get fully unrolled, 0 reads it from descriptor
+layout(constant_id = 0) const int KERNEL_SIZE = 0;
+
 layout(std140, binding = 6) uniform ConvolutionDescriptor {
     int kernel_size;
     int gray_scale;
@@ -22,11 +25,13 @@ void main() {
     ivec2 tex_index = ivec2(in_texcoord * vec2(tex_size));
 
 
+    int radius = KERNEL_SIZE > 0 ? KERNEL_SIZE : kernel_size;
+
     vec3 sum = vec3(0.0);
     if (gradient == 0) {
         int i=0;
-        for (int v=-kernel_size; v<=kernel_size; ++v) {
-            for (int u=-kernel_size; u<=kernel_size; ++u) {
+        for (int v=-radius; v<=radius; ++v) {
+            for (int u=-radius; u<=radius; ++u) {
                 vec4 texel = kernel_at(i) * texelFetch(u_tex, tex_index + ivec2(u, v), 0);
                 sum += texel.rgb;
                 ++i;
@@ -34,14 +39,14 @@ void main() {
         }
     } else {
         int i=0;
-        int kernel_side = 2 * kernel_size + 1;
+        int kernel_side = 2 * radius + 1;
         vec3 dX = vec3(0.0);
         vec3 dY = vec3(0.0);
-        for (int v=-kernel_size; v<=kernel_size; ++v) {
-            for (int u=-kernel_size; u<=kernel_size; ++u) {
+        for (int v=-radius; v<=radius; ++v) {
+            for (int u=-radius; u<=radius; ++u) {
                 vec3 texel = texelFetch(u_tex, tex_index + ivec2(u, v), 0).rgb;
                 dX += kernel_at(i) * texel;
-                dY += kernel_at(kernel_side - 1 - (v + kernel_size) + (u + kernel_size) * kernel_side) * texel;
+                dY += kernel_at(kernel_side - 1 - (v + radius) + (u + radius) * kernel_side) * texel;
                 ++i;
             }
         }
@@ -12,6 +12,9 @@ layout(location = 0) in vec2 in_texcoord;
 // savoula - mean + mean * ratio * stddev/(div-1)
 // phansca - mean + mean * pow * exp(-q*mean) + mean * ratio * stddev/(div-1)
 
+// kernel size the variant is built for, loops get fully unrolled, 0 reads it from descriptor
+layout(constant_id = 0) const int KERNEL_SIZE = 0;
+
 layout(std140, binding = 6) uniform LocalBinarizationDescriptor {
     int kernel_size;
     int equation_type;
@@ -24,12 +27,13 @@ void main() {
     ivec2 tex_size = textureSize(u_tex, 0);
     ivec2 tex_index = ivec2(in_texcoord * vec2(tex_size));
 
-    int kernel_area_size = (2 * kernel_size + 1) * (2 * kernel_size + 1);
+    int radius = KERNEL_SIZE > 0 ? KERNEL_SIZE : kernel_size;
+    int kernel_area_size = (2 * radius + 1) * (2 * radius + 1);
 
     float sum = 0.0;
     float sum_of_squares = 0.0;
-    for (int v=-kernel_size; v<=kernel_size; ++v) {
-        for (int u=-kernel_size; u<=kernel_size; ++u) {
+    for (int v=-radius; v<=radius; ++v) {
+        for (int u=-radius; u<=radius; ++u) {
             vec4 texel = texelFetch(u_tex, tex_index + ivec2(u, v), 0);
             float value = (texel.r + texel.g + texel.b) / 3.0;
             sum += value;
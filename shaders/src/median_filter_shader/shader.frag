@@ -6,6 +6,12 @@ layout(binding = 5) uniform sampler2D u_tex;
 
 layout(location = 0) in vec2 in_texcoord;
 
+// kernel size the variant is built for, array is sized to its window, 0 reads it from descriptor
+layout(constant_id = 0) const int KERNEL_SIZE = 0;
+// largest window when kernel size comes from descriptor, 7x7
+const int MAX_WINDOW_AREA = 49;
+const int WINDOW_AREA = KERNEL_SIZE > 0 ? (2 * KERNEL_SIZE + 1) * (2 * KERNEL_SIZE + 1) : MAX_WINDOW_AREA;
+
 layout(std140, binding = 6) uniform MedianFilterDescriptor {
     int kernel_size;
 };
@@ -14,10 +20,12 @@ void main() {
     ivec2 tex_size = textureSize(u_tex, 0);
     ivec2 tex_index = ivec2(in_texcoord * vec2(tex_size));
 
-    vec3 arr[49];
+    int radius = KERNEL_SIZE > 0 ? KERNEL_SIZE : kernel_size;
+
+    vec3 arr[WINDOW_AREA];
     int i=0;
-    for (int v=-kernel_size; v<=kernel_size; ++v) {
-        for (int u=-kernel_size; u<=kernel_size; ++u) {
+    for (int v=-radius; v<=radius; ++v) {
+        for (int u=-radius; u<=radius; ++u) {
             vec3 texel = texelFetch(u_tex, tex_index + ivec2(u, v), 0).rgb;
 
             arr[i] = texel;
@@ -35,5 +43,5 @@ void main() {
 
     vec4 texel = texture(u_tex, in_texcoord);
 
-    fragment = vec4(arr[((2*kernel_size+1)*(2*kernel_size+1))/2], texel.a);
+    fragment = vec4(arr[((2*radius+1)*(2*radius+1))/2], texel.a);
 }
\ No newline at end of file
@@ -1,63 +1,62 @@
 #include "Algorithm.hpp"
 
 #include <algorithm>
-#include <fstream>
-#include <charconv>
 
 #include <spdlog/spdlog.h>
 #include <glad/glad.h>
 
 using namespace bm;
 
-void ThresholdBinarizationAlgorithm::continuousSubmit(u32 buff_id) {
-    glNamedBufferSubData(
-        buff_id, 
-        0, sizeof(ThresholdBinarizationDescriptor), 
-        static_cast<const void*>(&descriptor)
-    );
+void ThresholdBinarizationAlgorithm::continuousSubmit(DescriptorRing& ring) {
+    ring.upload(descriptor);
 }
-void ThresholdBinarizationAlgorithm::submit(u32 buff_id) {
-    glNamedBufferSubData(
-        buff_id, 
-        0, sizeof(ThresholdBinarizationDescriptor), 
-        static_cast<const void*>(&descriptor)
-    );
+void ThresholdBinarizationAlgorithm::submit(DescriptorRing& ring) {
+    ring.upload(descriptor);
 }
 
-void OtsuBinarizationAlgorithm::prepare(const Histogram& histogram) {
-    std::array<f32, 256> normalized_mean_histogram;
-    histogram.normalizeForChannel(normalized_mean_histogram, Histogram::Channel::ALL);
-    
+u8 OtsuBinarizationAlgorithm::computeThreshold(const std::array<u32, 256>& histogram) {
+    f32 overall_count{ 0.F };
+    for (const auto count : histogram) {
+        overall_count += static_cast<f32>(count);
+    }
+    if (overall_count == 0.F) {
+        return 0U;
+    }
+
     std::array<f32, 256> sums;
     std::array<f32, 256> means;
-    sums[0] = normalized_mean_histogram[0];
+    sums[0] = static_cast<f32>(histogram[0]) / overall_count;
     means[0] = 0.F;
-    for (std::size_t i{ 1 }; i < normalized_mean_histogram.size(); ++i) {
-        sums[i] = sums[i-1] + normalized_mean_histogram[i];
-        means[i] = means[i-1] + normalized_mean_histogram[i] * static_cast<f32>(i);
+    for (std::size_t i{ 1 }; i < histogram.size(); ++i) {
+        const auto normalized = static_cast<f32>(histogram[i]) / overall_count;
+        sums[i] = sums[i-1] + normalized;
+        means[i] = means[i-1] + normalized * static_cast<f32>(i);
     }
 
     std::array<f32, 256> per_threshold_variance;
     for (std::size_t i{ 0 }; i < per_threshold_variance.size(); ++i) {
         const f32 weight0 = sums[i];
         const f32 weight1 = 1.F - weight0;
+        // empty class would give NaN which max_element can't skip
+        if (weight0 <= 0.F || weight1 <= 0.F) {
+            per_threshold_variance[i] = 0.F;
+            continue;
+        }
         const f32 mean0 = means[i] / weight0;
         const f32 mean1 = (means[255] - means[i]) / weight1;
         per_threshold_variance[i] = weight0 * weight1 * (mean0 - mean1) * (mean0 - mean1);
     }
 
     const auto max_variance = std::max_element(per_threshold_variance.cbegin(), per_threshold_variance.cend());
-    const auto threshold = std::distance(per_threshold_variance.cbegin(), max_variance);
+    return static_cast<u8>(std::distance(per_threshold_variance.cbegin(), max_variance));
+}
 
-    this->descriptor.threshold = static_cast<f32>(threshold) / 255.F;
+void OtsuBinarizationAlgorithm::prepare(const Histogram& histogram) {
+    this->descriptor.threshold = static_cast<f32>(computeThreshold(histogram.mean_sums)) / 255.F;
 }
-void OtsuBinarizationAlgorithm::continuousSubmit(u32 buff_id) {}
-void OtsuBinarizationAlgorithm::submit(u32 buff_id) {
-    glNamedBufferSubData(
-        buff_id, 
-        0, sizeof(OtsuBinarizationDescriptor), 
-        static_cast<const void*>(&descriptor)
-    );
+void OtsuBinarizationAlgorithm::continuousSubmit([[maybe_unused]] DescriptorRing& ring) {}
+void OtsuBinarizationAlgorithm::submit(DescriptorRing& ring) {
+    ring.upload(descriptor);
 }
 
 void EqualizationAlgorithm::prepare(const Histogram& histogram) {
@@ -95,169 +94,92 @@ void EqualizationAlgorithm::prepare(const Histogram& histogram) {
         descriptor.distributant_b0 = 0;
     }
 }
-void EqualizationAlgorithm::continuousSubmit(u32 buff_id) {
-    glNamedBufferSubData(
-        buff_id, 
-        0, sizeof(i32), 
-        static_cast<const void*>(&descriptor.range)
-    );
+void EqualizationAlgorithm::continuousSubmit(DescriptorRing& ring) {
+    // whole descriptor is hashed, distributants are only re-uploaded when they changed
+    ring.upload(descriptor);
 }
-void EqualizationAlgorithm::submit(u32 buff_id) {
-    glNamedBufferSubData(
-        buff_id, 
-        0, sizeof(EqualizationDescriptor), 
-        static_cast<const void*>(&descriptor)
-    );
+void EqualizationAlgorithm::submit(DescriptorRing& ring) {
+    ring.upload(descriptor);
 }
 
-void StretchingAlgorithm::prepare(const Image& image) {
-    const auto[min, max] = image.minMax<f32>();
-    descriptor.local_min[0] = min.r;
-    descriptor.local_min[1] = min.g;
-    descriptor.local_min[2] = min.b;
-
-    descriptor.local_max[0] = max.r;
-    descriptor.local_max[1] = max.g;
-    descriptor.local_max[2] = max.b;
+void StretchingAlgorithm::prepare(const Histogram& histogram) {
+    const std::array<Histogram::Channel, 3> channels{{ Histogram::Channel::R, Histogram::Channel::G, Histogram::Channel::B }};
+    for (std::size_t i{ 0 }; i < channels.size(); ++i) {
+        // flat channel would divide by zero in shader, low stays below 255 so high
+        // never passes 255 and white of flat channel isn't mapped to black
+        const auto low = std::min<i32>(histogram.percentile(channels[i], low_clip), 254);
+        const auto high = std::max<i32>(histogram.percentile(channels[i], high_clip), low + 1);
+        descriptor.local_min[i] = static_cast<f32>(low) / 255.F;
+        descriptor.local_max[i] = static_cast<f32>(high) / 255.F;
+    }
 }
-void StretchingAlgorithm::continuousSubmit(u32 buff_id) {
-    glNamedBufferSubData(
-        buff_id, 
-        0, sizeof(StretchingDescriptor), 
-        static_cast<const void*>(&descriptor)
-    );
+void StretchingAlgorithm::continuousSubmit(DescriptorRing& ring) {
+    ring.upload(descriptor);
 }
-void StretchingAlgorithm::submit(u32 buff_id) {
-    glNamedBufferSubData(
-        buff_id, 
-        0, sizeof(StretchingDescriptor), 
-        static_cast<const void*>(&descriptor)
-    );
+void StretchingAlgorithm::submit(DescriptorRing& ring) {
+    ring.upload(descriptor);
 }
 
-void LocalBinarizationAlgorithm::continuousSubmit(u32 buff_id) {
-    glNamedBufferSubData(
-        buff_id,
-        0, sizeof(LocalBinarizationDescriptor),
-        static_cast<const void*>(&descriptor)
-    );
+void LocalBinarizationAlgorithm::continuousSubmit(DescriptorRing& ring) {
+    ring.upload(descriptor);
 }
-void LocalBinarizationAlgorithm::submit(u32 buff_id) {
-    glNamedBufferSubData(
-        buff_id,
-        0, sizeof(LocalBinarizationDescriptor),
-        static_cast<const void*>(&descriptor)
-    );
+void LocalBinarizationAlgorithm::submit(DescriptorRing& ring) {
+    ring.upload(descriptor);
+}
+void LocalBinarizationAlgorithm::bindVariant() const {
+    shader.bind({{ KERNEL_SIZE_CONSTANT_ID, static_cast<u32>(descriptor.kernel_size) }});
 }
 
-void ConvolutionAlgorithm::prepare(const fs::path& filter_path) {
-    const auto filter_path_str = filter_path.string();
-
-    std::ifstream stream(filter_path);
-    if (!stream.good()) {
-        spdlog::error("Couldn't read filter from {}", filter_path_str);
+void ConvolutionAlgorithm::prepare(std::shared_ptr<const Filter> filter) {
+    this->filter = std::move(filter);
+    if (this->filter == nullptr) {
         return;
     }
-
-    std::string line;
-    std::getline(stream, line);
-
-    if (const auto result = std::from_chars(&line.front(), &line.back() + 1, descriptor.kernel_size);
-        result.ec != std::errc()) {
-        spdlog::error("Failed to parse kernel size from {}", filter_path_str);
-        return;
+    descriptor.kernel_size = this->filter->prepared.kernel.radius;
+    engine = this->filter->prepared.engine;
+}
+void ConvolutionAlgorithm::continuousSubmit([[maybe_unused]] DescriptorRing& ring) {}
+void ConvolutionAlgorithm::submit(DescriptorRing& ring) {
+    if (filter != nullptr && !filter->packed_taps.empty()) {
+        std::copy(filter->packed_taps.begin(), filter->packed_taps.end(), descriptor.kernel.begin());
     }
-    if (descriptor.kernel_size < 0 || descriptor.kernel_size > 10) {
-        spdlog::error("Kernel size declared in {} isn't in range [{}, {}], is {}", 
-            filter_path_str,
-            0, 10, 
-            descriptor.kernel_size
-        );
+    // bound range has to cover whole uniform block, unused taps are copied along
+    ring.upload(descriptor);
+}
+void ConvolutionAlgorithm::perform(Image& image) {
+    if (filter == nullptr) {
         return;
     }
-
-    const auto kernel_side_size = static_cast<std::size_t>(2 * descriptor.kernel_size + 1);
-
-    i32 line_num{ 0 };
-    for (std::size_t line_num{ 0 }; std::getline(stream, line); ++line_num) {
-        std::from_chars_result result{};
-        result.ptr = &line.front() - 1;
-        for (std::size_t i{0}; i<kernel_side_size; ++i) {
-            f32 value{ 0.F };
-            result = std::from_chars(result.ptr + 1, &line.back() + 1, value);
-            if (result.ec != std::errc()) {
-                spdlog::error("Failed to parse kernel value from {}", filter_path_str);
-                return;
-            }
-            descriptor.kernel[i + line_num * kernel_side_size] = value;
-        }
-    }
-    stream.close();
-
-    float kernel_elements_sum{0.F};
-    for (std::size_t i{0}; i < kernel_side_size*kernel_side_size; ++i) {
-        kernel_elements_sum += descriptor.kernel[i];
-    }
-    if (kernel_elements_sum > 0.F) {
-        for (std::size_t i{0}; i < kernel_side_size*kernel_side_size; ++i) {
-            descriptor.kernel[i] /= kernel_elements_sum;
-        }
-    }
+    performConvolution(image, filter->prepared, engine, { .gray_scale = descriptor.gray_scale, .gradient = descriptor.gradient }, fft);
 }
-void ConvolutionAlgorithm::continuousSubmit(u32 buff_id) {}
-void ConvolutionAlgorithm::submit(u32 buff_id) {
-    const auto kernel_size_in_bytes = sizeof(f32) *
-        (2 * descriptor.kernel_size + 1) * 
-        (2 * descriptor.kernel_size + 1);
-    glNamedBufferSubData(
-        buff_id,
-        0, offsetof(ConvolutionDescriptor, kernel) + kernel_size_in_bytes,
-        static_cast<const void*>(&descriptor)
-    );
+void ConvolutionAlgorithm::bindVariant() const {
+    shader.bind({{ KERNEL_SIZE_CONSTANT_ID, static_cast<u32>(descriptor.kernel_size) }});
 }
 
 void MedianFilterAlgorithm::prepare() {}
-void MedianFilterAlgorithm::continuousSubmit(u32 buff_id) {
-    glNamedBufferSubData(
-        buff_id,
-        0, sizeof(MedianFilterDescriptor),
-        static_cast<const void*>(&descriptor)
-    );
+void MedianFilterAlgorithm::continuousSubmit(DescriptorRing& ring) {
+    ring.upload(descriptor);
 }
-void MedianFilterAlgorithm::submit(u32 buff_id) {
-    glNamedBufferSubData(
-        buff_id,
-        0, sizeof(MedianFilterDescriptor),
-        static_cast<const void*>(&descriptor)
-    );
+void MedianFilterAlgorithm::submit(DescriptorRing& ring) {
+    ring.upload(descriptor);
+}
+void MedianFilterAlgorithm::bindVariant() const {
+    shader.bind({{ KERNEL_SIZE_CONSTANT_ID, static_cast<u32>(descriptor.kernel_size) }});
 }
-
 
 void PixelizationAlgorithm::prepare(u32 tex_id, u32 binding) {
     glBindImageTexture(binding, tex_id, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA8UI);
 }
-void PixelizationAlgorithm::continuousSubmit(u32 buff_id) {
-    glNamedBufferSubData(
-        buff_id,
-        0, sizeof(PixelizationDescriptor),
-        static_cast<const void*>(&descriptor)
-    );
+void PixelizationAlgorithm::continuousSubmit(DescriptorRing& ring) {
+    ring.upload(descriptor);
 }
-void PixelizationAlgorithm::submit(u32 buff_id) {
-    glNamedBufferSubData(
-        buff_id,
-        0, sizeof(PixelizationDescriptor),
-        static_cast<const void*>(&descriptor)
-    );
+void PixelizationAlgorithm::submit(DescriptorRing& ring) {
+    ring.upload(descriptor);
 }
 
-void GlobalFillAlgorithm::continuousSubmit(u32 buff_id) {
-    this->submit(buff_id);
+void GlobalFillAlgorithm::continuousSubmit(DescriptorRing& ring) {
+    this->submit(ring);
 }
-void GlobalFillAlgorithm::submit(u32 buff_id) {
-    glNamedBufferSubData(
-        buff_id,
-        0, sizeof(GlobalFillDescriptor),
-        static_cast<const void*>(&descriptor)
-    );
+void GlobalFillAlgorithm::submit(DescriptorRing& ring) {
+    ring.upload(descriptor);
 }
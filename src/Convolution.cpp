@@ -0,0 +1,461 @@
+#include "Convolution.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numbers>
+
+#include <spdlog/spdlog.h>
+
+#include "Hash.hpp"
+#include "Parallel.hpp"
+
+using namespace bm;
+
+using Plane = FftConvolution::Plane;
+using Complex = std::complex<f32>;
+
+// one GPU tap against one CPU multiply-add on all cores, rough but only has to separate orders of magnitude
+static constexpr f32 GPU_DIRECT_SPEEDUP{ 64.F };
+// multiply-adds of radix-2 butterfly and of complex product with spectrum
+static constexpr f32 BUTTERFLY_COST{ 4.F };
+static constexpr f32 SPECTRUM_PRODUCT_COST{ 4.F };
+static constexpr i32 MIN_FFT_TILE{ 16 };
+static constexpr i32 MAX_FFT_TILE{ 2048 };
+static constexpr f32 SEPARABILITY_EPSILON{ 1e-5F };
+
+Kernel Kernel::rotated() const {
+    Kernel result{ .radius = radius, .taps = std::vector<f32>(taps.size()) };
+    for (i32 v{ -radius }; v <= radius; ++v) {
+        for (i32 u{ -radius }; u <= radius; ++u) {
+            result.taps[static_cast<std::size_t>((v + radius) * side() + u + radius)] = at(-v, u);
+        }
+    }
+    return result;
+}
+
+u64 Kernel::hash() const {
+    const auto seed = hashBytes(&radius, sizeof(radius));
+    return hashBytes(taps.data(), taps.size() * sizeof(f32), seed);
+}
+
+const char* bm::engineName(ConvolutionEngine engine) {
+    switch (engine) {
+    case ConvolutionEngine::DIRECT: return "direct";
+    case ConvolutionEngine::SEPARABLE: return "separable";
+    case ConvolutionEngine::FFT: return "FFT";
+    }
+    return "unknown";
+}
+
+bool bm::separateKernel(const Kernel& kernel, std::vector<f32>& column, std::vector<f32>& row) {
+    const auto side = static_cast<std::size_t>(kernel.side());
+    column.assign(side, 0.F);
+    row.assign(side, 0.F);
+
+    // largest tap is the best conditioned pivot
+    const auto pivot_it = std::max_element(kernel.taps.begin(), kernel.taps.end(), [](f32 lhs, f32 rhs) {
+        return std::abs(lhs) < std::abs(rhs);
+    });
+    if (pivot_it == kernel.taps.end() || *pivot_it == 0.F) {
+        return true;
+    }
+    const auto pivot_index = static_cast<std::size_t>(pivot_it - kernel.taps.begin());
+    const auto pivot_u = static_cast<i32>(pivot_index % side) - kernel.radius;
+    const auto pivot_v = static_cast<i32>(pivot_index / side) - kernel.radius;
+    const auto pivot = *pivot_it;
+
+    for (i32 i{ -kernel.radius }; i <= kernel.radius; ++i) {
+        column[static_cast<std::size_t>(i + kernel.radius)] = kernel.at(pivot_u, i);
+        row[static_cast<std::size_t>(i + kernel.radius)] = kernel.at(i, pivot_v) / pivot;
+    }
+    for (i32 v{ -kernel.radius }; v <= kernel.radius; ++v) {
+        for (i32 u{ -kernel.radius }; u <= kernel.radius; ++u) {
+            const auto product = column[static_cast<std::size_t>(v + kernel.radius)] * row[static_cast<std::size_t>(u + kernel.radius)];
+            if (std::abs(kernel.at(u, v) - product) > SEPARABILITY_EPSILON * std::abs(pivot)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+ConvolutionEngine bm::chooseEngine(const Kernel& kernel, bool separable, i32 gpu_max_radius) {
+    const auto side = static_cast<f32>(kernel.side());
+
+    auto engine = ConvolutionEngine::FFT;
+    auto cost = FftConvolution::cost(kernel.radius);
+    if (separable && 2.F * side < cost) {
+        engine = ConvolutionEngine::SEPARABLE;
+        cost = 2.F * side;
+    }
+    if (kernel.radius <= gpu_max_radius && side * side / GPU_DIRECT_SPEEDUP < cost) {
+        engine = ConvolutionEngine::DIRECT;
+    }
+    return engine;
+}
+
+PreparedKernel PreparedKernel::prepare(Kernel kernel, i32 gpu_max_radius) {
+    PreparedKernel prepared;
+    prepared.rotated = kernel.rotated();
+    // rotation of rank one kernel is rank one as well
+    prepared.separable = separateKernel(kernel, prepared.column, prepared.row) &&
+        separateKernel(prepared.rotated, prepared.rotated_column, prepared.rotated_row);
+    prepared.engine = chooseEngine(kernel, prepared.separable, gpu_max_radius);
+    prepared.kernel = std::move(kernel);
+    return prepared;
+}
+
+// Plan of in-place radix-2 transform of size n
+struct FftPlan {
+    i32 n{ 0 };
+    std::vector<i32> reversed;
+    std::vector<Complex> twiddles;
+};
+
+static FftPlan makePlan(i32 n) {
+    FftPlan plan{ .n = n, .reversed = std::vector<i32>(static_cast<std::size_t>(n)), .twiddles = {} };
+    i32 bits{ 0 };
+    while ((1 << bits) < n) {
+        ++bits;
+    }
+    for (i32 i{ 0 }; i < n; ++i) {
+        i32 reversed{ 0 };
+        for (i32 b{ 0 }; b < bits; ++b) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        plan.reversed[static_cast<std::size_t>(i)] = reversed;
+    }
+    plan.twiddles.resize(static_cast<std::size_t>(n / 2));
+    for (i32 k{ 0 }; k < n / 2; ++k) {
+        const auto angle = -2. * std::numbers::pi * static_cast<f64>(k) / static_cast<f64>(n);
+        plan.twiddles[static_cast<std::size_t>(k)] = Complex(static_cast<f32>(std::cos(angle)), static_cast<f32>(std::sin(angle)));
+    }
+    return plan;
+}
+
+// unscaled, inverse uses conjugated twiddles
+static void transform(Complex* data, const FftPlan& plan, bool inverse) {
+    const auto n = plan.n;
+    for (i32 i{ 0 }; i < n; ++i) {
+        const auto j = plan.reversed[static_cast<std::size_t>(i)];
+        if (i < j) {
+            std::swap(data[i], data[j]);
+        }
+    }
+    for (i32 length{ 2 }; length <= n; length <<= 1) {
+        const auto half = length / 2;
+        const auto step = n / length;
+        for (i32 i{ 0 }; i < n; i += length) {
+            for (i32 j{ 0 }; j < half; ++j) {
+                auto twiddle = plan.twiddles[static_cast<std::size_t>(j * step)];
+                if (inverse) {
+                    twiddle = std::conj(twiddle);
+                }
+                const auto even = data[i + j];
+                const auto odd = data[i + j + half] * twiddle;
+                data[i + j] = even + odd;
+                data[i + j + half] = even - odd;
+            }
+        }
+    }
+}
+
+// rows, then columns through contiguous scratch
+static void transform2d(Complex* data, const FftPlan& plan, bool inverse, std::vector<Complex>& column) {
+    const auto n = plan.n;
+    for (i32 y{ 0 }; y < n; ++y) {
+        transform(data + static_cast<std::ptrdiff_t>(y) * n, plan, inverse);
+    }
+    column.resize(static_cast<std::size_t>(n));
+    for (i32 x{ 0 }; x < n; ++x) {
+        for (i32 y{ 0 }; y < n; ++y) {
+            column[static_cast<std::size_t>(y)] = data[static_cast<std::ptrdiff_t>(y) * n + x];
+        }
+        transform(column.data(), plan, inverse);
+        for (i32 y{ 0 }; y < n; ++y) {
+            data[static_cast<std::ptrdiff_t>(y) * n + x] = column[static_cast<std::size_t>(y)];
+        }
+    }
+}
+
+// Work per output pixel and channel with tiles of tile_size: forward transform plus inverse
+// and spectrum product, shared by two channels, over valid (not wrapped) part of tile.
+static f32 fftTileCost(i32 radius, i32 tile_size) {
+    const auto valid = tile_size - 2 * radius;
+    if (valid <= 0) {
+        return lim<f32>::infinity();
+    }
+    const auto area = static_cast<f32>(tile_size) * static_cast<f32>(tile_size);
+    const auto transform_cost = area * std::log2(static_cast<f32>(tile_size)) * BUTTERFLY_COST;
+    return (2.F * transform_cost + area * SPECTRUM_PRODUCT_COST) / (2.F * static_cast<f32>(valid) * static_cast<f32>(valid));
+}
+
+i32 FftConvolution::tileSize(i32 radius, i32 width, i32 height) {
+    i32 best{ 0 };
+    auto best_cost = lim<f32>::infinity();
+    for (i32 tile_size{ MIN_FFT_TILE }; tile_size <= MAX_FFT_TILE || best == 0; tile_size <<= 1) {
+        const auto cost = fftTileCost(radius, tile_size);
+        if (cost < best_cost) {
+            best = tile_size;
+            best_cost = cost;
+        }
+        // single tile already covers whole image, bigger ones only add padding
+        if (best != 0 && tile_size - 2 * radius >= std::max(width, height)) {
+            break;
+        }
+    }
+    return best;
+}
+
+f32 FftConvolution::cost(i32 radius) {
+    return fftTileCost(radius, tileSize(radius, MAX_FFT_TILE, MAX_FFT_TILE));
+}
+
+const std::vector<Complex>& FftConvolution::spectrum(const Kernel& kernel, i32 tile_size) {
+    const auto key = kernel.hash();
+    for (const auto& spectrum : spectra) {
+        if (spectrum.key == key && spectrum.tile_size == tile_size) {
+            return spectrum.values;
+        }
+    }
+
+    // taps are mirrored around origin (with wrap) so circular convolution gives shader's correlation
+    Spectrum result{ .key = key, .tile_size = tile_size, .values = std::vector<Complex>(static_cast<std::size_t>(tile_size * tile_size)) };
+    for (i32 v{ -kernel.radius }; v <= kernel.radius; ++v) {
+        for (i32 u{ -kernel.radius }; u <= kernel.radius; ++u) {
+            const auto x = (tile_size - u) % tile_size;
+            const auto y = (tile_size - v) % tile_size;
+            result.values[static_cast<std::size_t>(y * tile_size + x)] = kernel.at(u, v);
+        }
+    }
+    std::vector<Complex> column;
+    transform2d(result.values.data(), makePlan(tile_size), false, column);
+
+    if (spectra.size() >= MAX_SPECTRA) {
+        spectra.erase(spectra.begin());
+    }
+    spectra.push_back(std::move(result));
+    return spectra.back().values;
+}
+
+void FftConvolution::apply(
+    const std::vector<Plane>& planes, i32 width, i32 height,
+    const std::vector<const Kernel*>& kernels, std::vector<std::vector<Plane>>& out
+) {
+    i32 radius{ 0 };
+    for (const auto* kernel : kernels) {
+        radius = std::max(radius, kernel->radius);
+    }
+    const auto tile_size = tileSize(radius, width, height);
+    const auto valid = tile_size - 2 * radius;
+    const auto tiles_x = (width + valid - 1) / valid;
+    const auto tiles_y = (height + valid - 1) / valid;
+    const auto plan = makePlan(tile_size);
+    const auto scale = 1.F / (static_cast<f32>(tile_size) * static_cast<f32>(tile_size));
+
+    // copies, next spectrum() may evict previous one
+    std::vector<std::vector<Complex>> kernel_spectra;
+    for (const auto* kernel : kernels) {
+        kernel_spectra.push_back(spectrum(*kernel, tile_size));
+    }
+
+    out.assign(kernels.size(), std::vector<Plane>(planes.size(), Plane(static_cast<std::size_t>(width * height))));
+
+    parallelForBands(bandsNum(tiles_y, 1), tiles_y, [&](i32, i32 tile_row_begin, i32 tile_row_end) {
+        const auto area = static_cast<std::size_t>(tile_size * tile_size);
+        std::vector<Complex> input(area);
+        std::vector<Complex> product(area);
+        std::vector<Complex> column;
+        std::vector<i32> source_x(static_cast<std::size_t>(tile_size));
+
+        for (i32 tile_y{ tile_row_begin }; tile_y < tile_row_end; ++tile_y) {
+            for (i32 tile_x{ 0 }; tile_x < tiles_x; ++tile_x) {
+                const auto x0 = tile_x * valid;
+                const auto y0 = tile_y * valid;
+                const auto valid_width = std::min(valid, width - x0);
+                const auto valid_height = std::min(valid, height - y0);
+                for (i32 i{ 0 }; i < tile_size; ++i) {
+                    source_x[static_cast<std::size_t>(i)] = std::clamp(x0 - radius + i, 0, width - 1);
+                }
+
+                for (std::size_t p{ 0 }; p < planes.size(); p += 2) {
+                    const auto& real = planes[p];
+                    const auto* imag = p + 1 < planes.size() ? &planes[p + 1] : nullptr;
+                    for (i32 j{ 0 }; j < tile_size; ++j) {
+                        const auto source_row = static_cast<std::size_t>(std::clamp(y0 - radius + j, 0, height - 1) * width);
+                        auto* dst = &input[static_cast<std::size_t>(j * tile_size)];
+                        for (i32 i{ 0 }; i < tile_size; ++i) {
+                            const auto index = source_row + static_cast<std::size_t>(source_x[static_cast<std::size_t>(i)]);
+                            dst[i] = Complex(real[index], imag != nullptr ? (*imag)[index] : 0.F);
+                        }
+                    }
+                    transform2d(input.data(), plan, false, column);
+
+                    for (std::size_t k{ 0 }; k < kernels.size(); ++k) {
+                        const auto& kernel_spectrum = kernel_spectra[k];
+                        for (std::size_t i{ 0 }; i < area; ++i) {
+                            product[i] = input[i] * kernel_spectrum[i];
+                        }
+                        transform2d(product.data(), plan, true, column);
+
+                        auto& out_real = out[k][p];
+                        for (i32 j{ 0 }; j < valid_height; ++j) {
+                            const auto* src = &product[static_cast<std::size_t>((j + radius) * tile_size + radius)];
+                            const auto dst_index = static_cast<std::size_t>((y0 + j) * width + x0);
+                            for (i32 i{ 0 }; i < valid_width; ++i) {
+                                out_real[dst_index + static_cast<std::size_t>(i)] = src[i].real() * scale;
+                            }
+                            if (imag != nullptr) {
+                                auto& out_imag = out[k][p + 1];
+                                for (i32 i{ 0 }; i < valid_width; ++i) {
+                                    out_imag[dst_index + static_cast<std::size_t>(i)] = src[i].imag() * scale;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+static void convolveDirect(const Plane& in, Plane& out, i32 width, i32 height, const Kernel& kernel) {
+    out.resize(in.size());
+    parallelForBands(bandsNum(height, 16), height, [&](i32, i32 row_begin, i32 row_end) {
+        for (i32 y{ row_begin }; y < row_end; ++y) {
+            for (i32 x{ 0 }; x < width; ++x) {
+                f32 sum{ 0.F };
+                for (i32 v{ -kernel.radius }; v <= kernel.radius; ++v) {
+                    const auto* src = &in[static_cast<std::size_t>(std::clamp(y + v, 0, height - 1) * width)];
+                    for (i32 u{ -kernel.radius }; u <= kernel.radius; ++u) {
+                        sum += kernel.at(u, v) * src[std::clamp(x + u, 0, width - 1)];
+                    }
+                }
+                out[static_cast<std::size_t>(y * width + x)] = sum;
+            }
+        }
+    });
+}
+
+static void convolveSeparable(
+    const Plane& in, Plane& out, i32 width, i32 height, i32 radius,
+    const std::vector<f32>& column, const std::vector<f32>& row
+) {
+    Plane horizontal(in.size());
+    out.assign(in.size(), 0.F);
+    parallelForBands(bandsNum(height, 16), height, [&](i32, i32 row_begin, i32 row_end) {
+        for (i32 y{ row_begin }; y < row_end; ++y) {
+            const auto* src = &in[static_cast<std::size_t>(y * width)];
+            auto* dst = &horizontal[static_cast<std::size_t>(y * width)];
+            for (i32 x{ 0 }; x < width; ++x) {
+                f32 sum{ 0.F };
+                for (i32 u{ -radius }; u <= radius; ++u) {
+                    sum += row[static_cast<std::size_t>(u + radius)] * src[std::clamp(x + u, 0, width - 1)];
+                }
+                dst[x] = sum;
+            }
+        }
+    });
+    // vertical pass accumulates whole rows to keep access sequential
+    parallelForBands(bandsNum(height, 16), height, [&](i32, i32 row_begin, i32 row_end) {
+        for (i32 y{ row_begin }; y < row_end; ++y) {
+            auto* dst = &out[static_cast<std::size_t>(y * width)];
+            for (i32 v{ -radius }; v <= radius; ++v) {
+                const auto weight = column[static_cast<std::size_t>(v + radius)];
+                const auto* src = &horizontal[static_cast<std::size_t>(std::clamp(y + v, 0, height - 1) * width)];
+                for (i32 x{ 0 }; x < width; ++x) {
+                    dst[x] += weight * src[x];
+                }
+            }
+        }
+    });
+}
+
+void bm::performConvolution(
+    Image& image, const PreparedKernel& prepared, ConvolutionEngine engine,
+    const ConvolutionOptions& options, FftConvolution& fft
+) {
+    const auto& kernel = prepared.kernel;
+    if (image.width <= 0 || image.height <= 0 || kernel.taps.empty()) {
+        return;
+    }
+    const auto width = image.width;
+    const auto height = image.height;
+    const auto channels_num = image.format == PixelFormat::RGBA8 ? 3U : 1U;
+
+    std::vector<Plane> planes(channels_num, Plane(static_cast<std::size_t>(width * height)));
+    visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+        for (i32 y{ 0 }; y < height; ++y) {
+            const auto* row = image.row(y);
+            const auto offset = static_cast<std::size_t>(y * width);
+            for (i32 x{ 0 }; x < width; ++x) {
+                if constexpr (F == PixelFormat::RGBA8) {
+                    for (std::size_t c{ 0 }; c < 3; ++c) {
+                        planes[c][offset + static_cast<std::size_t>(x)] = row[4 * x + static_cast<i32>(c)];
+                    }
+                } else {
+                    planes[0][offset + static_cast<std::size_t>(x)] = PixelTraits<F>::gray(row, x);
+                }
+            }
+        }
+    });
+
+    std::vector<const Kernel*> kernels{ &kernel };
+    if (options.gradient) {
+        kernels.push_back(&prepared.rotated);
+    }
+
+    // results[k][c] is channel c convolved with kernels[k]
+    std::vector<std::vector<Plane>> results;
+    if (engine == ConvolutionEngine::FFT) {
+        fft.apply(planes, width, height, kernels, results);
+    } else {
+        if (engine == ConvolutionEngine::SEPARABLE && !prepared.separable) {
+            spdlog::warn("Kernel isn't separable, convolving directly");
+        }
+        const auto separable = engine == ConvolutionEngine::SEPARABLE && prepared.separable;
+        results.assign(kernels.size(), std::vector<Plane>(planes.size()));
+        for (std::size_t k{ 0 }; k < kernels.size(); ++k) {
+            const auto& column = k == 0 ? prepared.column : prepared.rotated_column;
+            const auto& row = k == 0 ? prepared.row : prepared.rotated_row;
+            for (std::size_t c{ 0 }; c < planes.size(); ++c) {
+                if (separable) {
+                    convolveSeparable(planes[c], results[k][c], width, height, kernel.radius, column, row);
+                } else {
+                    convolveDirect(planes[c], results[k][c], width, height, *kernels[k]);
+                }
+            }
+        }
+    }
+
+    const auto toByte = [](f32 value) {
+        return static_cast<u8>(std::clamp(value + .5F, 0.F, 255.F));
+    };
+    parallelForBands(bandsNum(height, 64), height, [&](i32, i32 row_begin, i32 row_end) {
+        visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+            std::array<f32, 3> values{};
+            for (i32 y{ row_begin }; y < row_end; ++y) {
+                auto* row = image.row(y);
+                const auto offset = static_cast<std::size_t>(y * width);
+                for (i32 x{ 0 }; x < width; ++x) {
+                    const auto index = offset + static_cast<std::size_t>(x);
+                    for (std::size_t c{ 0 }; c < channels_num; ++c) {
+                        const auto dx = results[0][c][index];
+                        values[c] = options.gradient ? std::sqrt(dx * dx + results[1][c][index] * results[1][c][index]) : dx;
+                    }
+                    if constexpr (F == PixelFormat::RGBA8) {
+                        if (options.gray_scale) {
+                            values[0] = values[1] = values[2] = (values[0] + values[1] + values[2]) / 3.F;
+                        }
+                        for (std::size_t c{ 0 }; c < 3; ++c) {
+                            row[4 * x + static_cast<i32>(c)] = toByte(values[c]);
+                        }
+                    } else {
+                        PixelTraits<F>::storeGray(row, x, toByte(values[0]));
+                    }
+                }
+            }
+        });
+    });
+}
@@ -0,0 +1,106 @@
+#include "DescriptorRing.hpp"
+
+#include <cstring>
+
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+
+#include "Hash.hpp"
+
+using namespace bm;
+
+static void waitFence(void*& fence) {
+    if (fence == nullptr) {
+        return;
+    }
+    auto* sync = reinterpret_cast<GLsync>(fence); // NOLINT
+    constexpr GLuint64 TIMEOUT_NS{ 1'000'000'000ULL };
+    while (glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, TIMEOUT_NS) == GL_TIMEOUT_EXPIRED) {
+        spdlog::warn("Still waiting for GPU to release descriptor ring region");
+    }
+    glDeleteSync(sync);
+    fence = nullptr;
+}
+
+DescriptorRing::DescriptorRing(u32 binding, std::size_t region_size) : binding(binding) {
+    i32 offset_alignment{ 0 };
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offset_alignment);
+    if (offset_alignment > 0) {
+        alignment = static_cast<std::size_t>(offset_alignment);
+    }
+    this->region_size = (region_size + alignment - 1) / alignment * alignment;
+
+    constexpr GLbitfield FLAGS{ GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT };
+    const auto buffer_size = static_cast<GLsizeiptr>(this->region_size * FRAMES_NUM);
+    glCreateBuffers(1, &buffer_id);
+    glNamedBufferStorage(buffer_id, buffer_size, nullptr, FLAGS);
+    mapped = static_cast<u8*>(glMapNamedBufferRange(buffer_id, 0, buffer_size, FLAGS));
+    if (mapped == nullptr) {
+        spdlog::error("Failed to map descriptor ring buffer");
+    }
+}
+
+void DescriptorRing::upload(const void* data, std::size_t size) {
+    // descriptors are at most few KB, hashing them is far cheaper than upload
+    const auto hash = hashBytes(data, size);
+    if (last_valid && last_hash == hash && last_size == size) {
+        // range with the same bytes is still bound
+        return;
+    }
+
+    if (size > region_size) {
+        spdlog::error("Descriptor of {} bytes doesn't fit into ring region of {} bytes", size, region_size);
+        return;
+    }
+    if (head + size > region_size) {
+        // region exhausted within one frame, wait until GPU is done with all of it
+        spdlog::warn("Descriptor ring region overflow, stalling");
+        glFinish();
+        head = 0;
+    }
+
+    const auto offset = frame * region_size + head;
+    std::memcpy(mapped + offset, data, size);
+    glBindBufferRange(
+        GL_UNIFORM_BUFFER, binding, buffer_id,
+        static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size)
+    );
+    head += (size + alignment - 1) / alignment * alignment;
+
+    last_hash = hash;
+    last_offset = offset;
+    last_size = size;
+    last_valid = true;
+}
+
+void DescriptorRing::beginFrame() {
+    frame = (frame + 1) % FRAMES_NUM;
+    head = 0;
+    waitFence(fences[frame]);
+    // last range is overwritten by uploads of this frame once its region comes around again
+    if (last_valid && last_offset / region_size == frame) {
+        last_valid = false;
+    }
+}
+
+void DescriptorRing::endFrame() {
+    if (fences[frame] != nullptr) {
+        glDeleteSync(reinterpret_cast<GLsync>(fences[frame])); // NOLINT
+    }
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void DescriptorRing::deinit() {
+    for (auto& fence : fences) {
+        if (fence != nullptr) {
+            glDeleteSync(reinterpret_cast<GLsync>(fence)); // NOLINT
+            fence = nullptr;
+        }
+    }
+    if (mapped != nullptr) {
+        glUnmapNamedBuffer(buffer_id);
+        mapped = nullptr;
+    }
+    glDeleteBuffers(1, &buffer_id);
+    buffer_id = 0;
+}
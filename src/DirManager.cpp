@@ -1,35 +1,266 @@
 #include "DirManager.hpp"
 
 #include <algorithm>
+#include <cctype>
 
 #include <spdlog/spdlog.h>
+#include <stb_image.h>
+
+#include "MappedImage.hpp"
 
 using namespace bm;
 
-DirManager::DirManager(fs::path&& dir_path, std::vector<std::string>&& accepted_extensions)         
-    : accepted_extensions(std::move(accepted_extensions)), dir_path(std::move(dir_path)) {
+// scanned entries are handed over to index in batches of this size
+static constexpr std::size_t SCAN_BATCH_SIZE{ 4096 };
+// while initial scan runs index is published at most this often
+static constexpr std::chrono::milliseconds SCAN_PUBLISH_INTERVAL{ 500 };
+
+static std::string lowercase(std::string str) {
+    std::transform(str.begin(), str.end(), str.begin(), [](u8 c) { return std::tolower(c); });
+    return str;
+}
+
+static bool pathLess(const DirManager::Entry& lhs, const DirManager::Entry& rhs) {
+    return lhs.path < rhs.path;
+}
+
+// entries come sorted by path, so stable sort keeps names in order within equal keys
+static void sortEntries(std::vector<DirManager::Entry>& entries, DirManager::SortKey key) {
+    using Entry = DirManager::Entry;
+    switch (key) {
+    case DirManager::SortKey::NAME:
+        std::stable_sort(entries.begin(), entries.end(), pathLess);
+        break;
+    case DirManager::SortKey::SIZE:
+        std::stable_sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+            return lhs.size < rhs.size;
+        });
+        break;
+    case DirManager::SortKey::MTIME:
+        // newest first
+        std::stable_sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+            return lhs.mtime > rhs.mtime;
+        });
+        break;
+    case DirManager::SortKey::PIXELS:
+        std::stable_sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+            return static_cast<i64>(lhs.width) * lhs.height < static_cast<i64>(rhs.width) * rhs.height;
+        });
+        break;
+    }
+}
+
+static std::vector<fs::path> pathsOf(const std::vector<DirManager::Entry>& entries) {
+    std::vector<fs::path> paths;
+    paths.reserve(entries.size());
+    for (const auto& entry : entries) {
+        paths.push_back(entry.path);
+    }
+    return paths;
+}
+
+DirManager::DirManager(fs::path&& dir_path, std::vector<std::string>&& accepted_extensions)
+    : dir_path(std::move(dir_path)), accepted_extensions(std::move(accepted_extensions)) {
 
+    for (auto& extension : this->accepted_extensions) {
+        extension = lowercase(std::move(extension));
+    }
     if (!fs::is_directory(this->dir_path)) {
-        spdlog::error("{} is not directory", this->dir_path.c_str());
-        return; 
-    }
-    refresh();
-}
-void DirManager::refresh() {
-    files.clear();
-    for (const auto& entry : fs::directory_iterator{dir_path}) {
-        if (entry.is_regular_file()) {
-            auto extension = entry.path().extension().string();
-            std::transform(
-                extension.begin(), 
-                extension.end(), 
-                extension.begin(), 
-                [](u8 c) { return std::tolower(c); }
-            );
-            
-            if (std::find(accepted_extensions.begin(), accepted_extensions.end(), extension) != accepted_extensions.end()) {
-                files.emplace_back(std::move(entry.path()));                
+        spdlog::error("{} is not directory", this->dir_path.string());
+        return;
+    }
+    // watched before scan so nothing changed during scan is missed
+    watcher.start(this->dir_path, [this](const fs::path& path, DirWatcher::Event event) {
+        update(path, event);
+    });
+    scanning = true;
+    scanner = std::thread([this] { scan(); });
+}
+
+DirManager::~DirManager() {
+    cancelled = true;
+    if (scanner.joinable()) {
+        scanner.join();
+    }
+    watcher.stop();
+}
+
+bool DirManager::isAccepted(const fs::path& path) const {
+    const auto extension = lowercase(path.extension().string());
+    return std::find(accepted_extensions.begin(), accepted_extensions.end(), extension) != accepted_extensions.end();
+}
+
+bool DirManager::readEntry(const fs::path& path, Entry& entry) {
+    std::error_code error;
+    entry.path = path;
+    entry.size = fs::file_size(path, error);
+    if (error) {
+        return false;
+    }
+    entry.mtime = fs::last_write_time(path, error);
+
+    // headers only, pixels aren't decoded (or faulted in for mapped formats)
+    if (MappedImage::isSupported(path)) {
+        if (!MappedImage::readSize(path, entry.width, entry.height)) {
+            entry.width = 0;
+            entry.height = 0;
+        }
+    } else {
+        int channels_num{ 0 };
+        if (stbi_info(path.string().c_str(), &entry.width, &entry.height, &channels_num) == 0) {
+            entry.width = 0;
+            entry.height = 0;
+        }
+    }
+    return true;
+}
+
+void DirManager::merge(std::vector<Entry>& batch) {
+    std::sort(batch.begin(), batch.end(), pathLess);
+    {
+        const std::lock_guard lock(mutex);
+        std::vector<Entry> merged;
+        merged.reserve(index.size() + batch.size());
+        auto it = index.begin();
+        for (auto& entry : batch) {
+            while (it != index.end() && it->path < entry.path) {
+                merged.push_back(std::move(*it++));
+            }
+            const auto removed = std::find(removed_during_scan.begin(), removed_during_scan.end(), entry.path) != removed_during_scan.end();
+            if ((it == index.end() || entry.path < it->path) && !removed) {
+                merged.push_back(std::move(entry));
             }
         }
+        std::move(it, index.end(), std::back_inserter(merged));
+        index = std::move(merged);
+    }
+    batch.clear();
+    ++generation;
+    // copying whole index after every batch would slow down scan of big directories
+    if (const auto now = std::chrono::steady_clock::now(); now - last_publish >= SCAN_PUBLISH_INTERVAL) {
+        last_publish = now;
+        publish();
     }
-}
\ No newline at end of file
+}
+
+void DirManager::publish() {
+    std::vector<Entry> sorted;
+    SortKey key{};
+    u64 published_generation{ 0 };
+    {
+        const std::lock_guard lock(mutex);
+        sorted = index;
+        key = publish_key;
+        published_generation = generation;
+    }
+    sortEntries(sorted, key);
+    auto sorted_files = pathsOf(sorted);
+
+    const std::lock_guard lock(mutex);
+    // scanner and watcher publish concurrently, older copy is dropped
+    if (published_generation <= snapshot_generation) {
+        return;
+    }
+    snapshot = std::move(sorted);
+    snapshot_files = std::move(sorted_files);
+    snapshot_key = key;
+    snapshot_generation = published_generation;
+}
+
+void DirManager::scan() {
+    std::vector<Entry> batch;
+    std::error_code error;
+    for (fs::directory_iterator it(dir_path, error), end; !error && it != end && !cancelled; it.increment(error)) {
+        if (!it->is_regular_file(error) || !isAccepted(it->path())) {
+            continue;
+        }
+        Entry entry;
+        if (readEntry(it->path(), entry)) {
+            batch.push_back(std::move(entry));
+        }
+        if (batch.size() >= SCAN_BATCH_SIZE) {
+            merge(batch);
+        }
+    }
+    if (error) {
+        spdlog::error("Failed to scan {}: {}", dir_path.string(), error.message());
+    }
+    merge(batch);
+    {
+        const std::lock_guard lock(mutex);
+        removed_during_scan.clear();
+        scanning = false;
+    }
+    ++generation;
+    publish();
+}
+
+void DirManager::update(const fs::path& path, DirWatcher::Event event) {
+    if (!isAccepted(path)) {
+        return;
+    }
+    Entry entry;
+    const auto exists = event == DirWatcher::Event::CHANGED && readEntry(path, entry);
+
+    {
+        const std::lock_guard lock(mutex);
+        const auto it = std::lower_bound(index.begin(), index.end(), path, [](const Entry& lhs, const fs::path& rhs) {
+            return lhs.path < rhs;
+        });
+        const auto found = it != index.end() && it->path == path;
+        if (scanning) {
+            // scanned batch may still hold entry read before removal
+            const auto removed = std::find(removed_during_scan.begin(), removed_during_scan.end(), path);
+            if (!exists && removed == removed_during_scan.end()) {
+                removed_during_scan.push_back(path);
+            } else if (exists && removed != removed_during_scan.end()) {
+                removed_during_scan.erase(removed);
+            }
+        }
+        if (exists && found) {
+            *it = std::move(entry);
+        } else if (exists) {
+            index.insert(it, std::move(entry));
+        } else if (found) {
+            index.erase(it);
+        } else {
+            return;
+        }
+        ++generation;
+    }
+    // scanner publishes whole index when it finishes
+    if (!scanning) {
+        publish();
+    }
+}
+
+bool DirManager::poll() {
+    SortKey key{};
+    {
+        const std::lock_guard lock(mutex);
+        if (snapshot_generation == polled_generation) {
+            return false;
+        }
+        polled_generation = snapshot_generation;
+        key = snapshot_key;
+        entries.swap(snapshot);
+        files.swap(snapshot_files);
+    }
+    // published just before sort key changed, rare enough to sort here
+    if (key != sort_key) {
+        sort(sort_key);
+    }
+    return true;
+}
+
+void DirManager::sort(SortKey key) {
+    sort_key = key;
+    {
+        const std::lock_guard lock(mutex);
+        publish_key = key;
+    }
+    // ties keep name order like in snapshots sorted from index
+    std::sort(entries.begin(), entries.end(), pathLess);
+    sortEntries(entries, key);
+    files = pathsOf(entries);
+}
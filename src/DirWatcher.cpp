@@ -0,0 +1,121 @@
+#include "DirWatcher.hpp"
+
+#include <chrono>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <spdlog/spdlog.h>
+
+using namespace bm;
+
+// how often running flag is checked
+static constexpr std::chrono::milliseconds POLL_INTERVAL{ 250 };
+
+bool DirWatcher::start(const fs::path& dir_path, Callback callback) {
+    stop();
+    if (!fs::is_directory(dir_path)) {
+        spdlog::error("{} is not directory", dir_path.string());
+        return false;
+    }
+    this->dir_path = dir_path;
+    this->callback = std::move(callback);
+    running = true;
+    std::promise<bool> ready;
+    auto watching = ready.get_future();
+    thread = std::thread([this, ready = std::move(ready)]() mutable { run(std::move(ready)); });
+    if (!watching.get()) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void DirWatcher::stop() {
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+#ifdef __linux__
+void DirWatcher::run(std::promise<bool> ready) {
+    const auto fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        spdlog::error("Failed to initialize inotify for {}", dir_path.string());
+        ready.set_value(false);
+        return;
+    }
+    // close_write/moved_to only fire once file content is complete
+    constexpr u32 MASK{ IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM };
+    if (inotify_add_watch(fd, dir_path.c_str(), MASK) < 0) {
+        spdlog::error("Failed to watch {}", dir_path.string());
+        close(fd);
+        ready.set_value(false);
+        return;
+    }
+    ready.set_value(true);
+
+    alignas(inotify_event) char buffer[4096];
+    while (running) {
+        pollfd poll_fd{ .fd = fd, .events = POLLIN, .revents = 0 };
+        if (poll(&poll_fd, 1, static_cast<int>(POLL_INTERVAL.count())) <= 0) {
+            continue;
+        }
+        const auto length = read(fd, buffer, sizeof(buffer));
+        for (ssize_t offset{ 0 }; offset < length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset); // NOLINT
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            if (event->len == 0 || (event->mask & IN_ISDIR) != 0) {
+                continue;
+            }
+            const auto removed = (event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0;
+            callback(dir_path / event->name, removed ? Event::REMOVED : Event::CHANGED);
+        }
+    }
+    close(fd);
+}
+#else
+static constexpr std::chrono::milliseconds RESCAN_INTERVAL{ 1000 };
+
+void DirWatcher::run(std::promise<bool> ready) {
+    const auto scan = [this] {
+        std::unordered_map<std::string, fs::file_time_type> times;
+        std::error_code error;
+        for (const auto& entry : fs::directory_iterator(dir_path, error)) {
+            if (entry.is_regular_file(error)) {
+                times.emplace(entry.path().string(), entry.last_write_time(error));
+            }
+        }
+        return times;
+    };
+
+    auto known = scan();
+    ready.set_value(true);
+    auto last_scan = std::chrono::steady_clock::now();
+    while (running) {
+        std::this_thread::sleep_for(POLL_INTERVAL);
+        if (std::chrono::steady_clock::now() - last_scan < RESCAN_INTERVAL) {
+            continue;
+        }
+        auto current = scan();
+        last_scan = std::chrono::steady_clock::now();
+        for (const auto& [path, time] : current) {
+            const auto it = known.find(path);
+            if (it == known.end() || it->second != time) {
+                callback(path, Event::CHANGED);
+            }
+        }
+        for (const auto& [path, time] : known) {
+            if (!current.contains(path)) {
+                callback(path, Event::REMOVED);
+            }
+        }
+        known = std::move(current);
+    }
+}
+#endif
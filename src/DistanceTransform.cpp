@@ -0,0 +1,140 @@
+#include "DistanceTransform.hpp"
+
+#include <algorithm>
+
+#include "Parallel.hpp"
+
+using namespace bm;
+
+// columns per band of column pass, so every band sweeps whole cache lines
+static constexpr i32 MIN_BAND_COLUMNS{ 64 };
+
+void DistanceTransform::compute(const Image& image, DistanceTo features, bool with_nearest) {
+    width = image.width;
+    height = image.height;
+    squared.assign(static_cast<std::size_t>(width) * static_cast<std::size_t>(height), NONE);
+    nearest.clear();
+    if (squared.empty()) {
+        return;
+    }
+    // row of nearest feature in column after column pass
+    std::vector<i32> feature_rows(squared.size(), -1);
+
+    // Column pass sweeps rows down and up, keeping nearest feature row of every column
+    // of band, so memory is read row by row although distances are along columns.
+    parallelForBands(bandsNum(width, MIN_BAND_COLUMNS), width, [&](i32, i32 begin, i32 end) {
+        visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+            const auto isFeature = [&](const u8* row, i32 x) {
+                return (PixelTraits<F>::gray(row, x) >= 128U) == (features == DistanceTo::BACKGROUND);
+            };
+            for (i32 y{ 0 }; y < height; ++y) {
+                const auto* row = image.row(y);
+                for (auto x{ begin }; x < end; ++x) {
+                    const auto i = index(x, y);
+                    if (isFeature(row, x)) {
+                        feature_rows[i] = y;
+                    } else if (y > 0) {
+                        feature_rows[i] = feature_rows[index(x, y - 1)];
+                    }
+                }
+            }
+        });
+        for (auto y{ height - 2 }; y >= 0; --y) {
+            for (auto x{ begin }; x < end; ++x) {
+                const auto below = feature_rows[index(x, y + 1)];
+                auto& current = feature_rows[index(x, y)];
+                if (below >= 0 && (current < 0 || below - y < y - current)) {
+                    current = below;
+                }
+            }
+        }
+        for (i32 y{ 0 }; y < height; ++y) {
+            for (auto x{ begin }; x < end; ++x) {
+                const auto i = index(x, y);
+                if (feature_rows[i] >= 0) {
+                    squared[i] = (y - feature_rows[i]) * (y - feature_rows[i]);
+                }
+            }
+        }
+    });
+
+    if (with_nearest) {
+        nearest.assign(squared.size(), -1);
+    }
+    // Row pass, distance at x is min over q of (x - q)^2 + column distance at q. Parabolas
+    // of columns with a feature form lower envelope, boundaries[k] is where parabola
+    // roots[k] starts to be lowest.
+    parallelForBands(bandsNum(height, 16), height, [&](i32, i32 begin, i32 end) {
+        std::vector<i32> roots(static_cast<std::size_t>(width));
+        std::vector<f64> boundaries(static_cast<std::size_t>(width) + 1);
+        std::vector<i32> column(static_cast<std::size_t>(width));
+        for (auto y{ begin }; y < end; ++y) {
+            auto* row = &squared[index(0, y)];
+            std::copy(row, row + width, column.begin());
+            const auto at = [&](i32 q) { return static_cast<f64>(column[static_cast<std::size_t>(q)]) + static_cast<f64>(q) * q; };
+
+            i32 k{ -1 };
+            for (i32 q{ 0 }; q < width; ++q) {
+                if (column[static_cast<std::size_t>(q)] == NONE) {
+                    continue;
+                }
+                f64 boundary{ -lim<f64>::infinity() };
+                while (k >= 0) {
+                    const auto root = roots[static_cast<std::size_t>(k)];
+                    boundary = (at(q) - at(root)) / (2. * (q - root));
+                    if (boundary > boundaries[static_cast<std::size_t>(k)]) {
+                        break;
+                    }
+                    --k;
+                    boundary = -lim<f64>::infinity();
+                }
+                ++k;
+                roots[static_cast<std::size_t>(k)] = q;
+                boundaries[static_cast<std::size_t>(k)] = boundary;
+                boundaries[static_cast<std::size_t>(k) + 1] = lim<f64>::infinity();
+            }
+            if (k < 0) {
+                // no feature in any column, row stays NONE
+                continue;
+            }
+
+            i32 j{ 0 };
+            for (i32 x{ 0 }; x < width; ++x) {
+                while (boundaries[static_cast<std::size_t>(j) + 1] < static_cast<f64>(x)) {
+                    ++j;
+                }
+                const auto root = roots[static_cast<std::size_t>(j)];
+                row[x] = (x - root) * (x - root) + column[static_cast<std::size_t>(root)];
+                if (with_nearest) {
+                    nearest[index(x, y)] = static_cast<i32>(index(root, feature_rows[index(root, y)]));
+                }
+            }
+        }
+    });
+}
+
+std::vector<f32> DistanceTransform::distances() const {
+    std::vector<f32> values(squared.size());
+    std::transform(squared.begin(), squared.end(), values.begin(), [](i32 value) {
+        return value == NONE ? lim<f32>::infinity() : std::sqrt(static_cast<f32>(value));
+    });
+    return values;
+}
+
+void bm::drawDistanceTransform(Image& image, const DistanceTransform& transform) {
+    i32 largest{ 0 };
+    for (const auto value : transform.squared) {
+        if (value != DistanceTransform::NONE) {
+            largest = std::max(largest, value);
+        }
+    }
+    const auto scale = largest > 0 ? 255.F / std::sqrt(static_cast<f32>(largest)) : 0.F;
+    image.convert(PixelFormat::GRAY8);
+    for (i32 y{ 0 }; y < std::min(transform.height, image.height); ++y) {
+        auto* row = image.row(y);
+        for (i32 x{ 0 }; x < std::min(transform.width, image.width); ++x) {
+            const auto value = transform.squared[transform.index(x, y)];
+            row[x] = value == DistanceTransform::NONE ? 255U : static_cast<u8>(std::lround(scale * std::sqrt(static_cast<f32>(value))));
+        }
+    }
+}
@@ -0,0 +1,151 @@
+#include "FilterRegistry.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <fstream>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+using namespace bm;
+
+static bool pathLess(const std::shared_ptr<const Filter>& lhs, const std::shared_ptr<const Filter>& rhs) {
+    return lhs->path < rhs->path;
+}
+
+FilterRegistry::FilterRegistry(fs::path dir_path, i32 gpu_max_radius)
+    : dir_path(std::move(dir_path)), gpu_max_radius(gpu_max_radius) {
+    if (!fs::is_directory(this->dir_path)) {
+        spdlog::error("{} is not directory", this->dir_path.string());
+        return;
+    }
+    // watched before scan so no edit is missed, files reported meanwhile are the newer version
+    watcher.start(this->dir_path, [this](const fs::path& path, DirWatcher::Event event) {
+        update(path, event);
+    });
+
+    std::vector<std::shared_ptr<const Filter>> loaded;
+    for (const auto& entry : fs::directory_iterator{ this->dir_path }) {
+        if (!entry.is_regular_file() || !isFilter(entry.path())) {
+            continue;
+        }
+        if (auto filter = load(entry.path(), gpu_max_radius); filter != nullptr) {
+            loaded.push_back(std::move(filter));
+        }
+    }
+
+    const std::lock_guard lock(mutex);
+    for (auto& filter : loaded) {
+        if (std::none_of(filters.begin(), filters.end(), [&](const auto& f) { return f->path == filter->path; })) {
+            filters.push_back(std::move(filter));
+        }
+    }
+    std::sort(filters.begin(), filters.end(), pathLess);
+    ++generation;
+}
+
+bool FilterRegistry::isFilter(const fs::path& path) {
+    auto extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](u8 c) { return std::tolower(c); });
+    return extension == ".ftr";
+}
+
+std::shared_ptr<const Filter> FilterRegistry::load(const fs::path& path, i32 gpu_max_radius) {
+    const auto path_str = path.string();
+
+    std::ifstream stream(path);
+    if (!stream.good()) {
+        spdlog::error("Couldn't read filter from {}", path_str);
+        return nullptr;
+    }
+
+    std::string line;
+    std::getline(stream, line);
+
+    Kernel kernel;
+    if (const auto result = std::from_chars(line.data(), line.data() + line.size(), kernel.radius);
+        result.ec != std::errc()) {
+        spdlog::error("Failed to parse kernel size from {}", path_str);
+        return nullptr;
+    }
+    if (kernel.radius < 0) {
+        spdlog::error("Kernel size declared in {} is negative, is {}", path_str, kernel.radius);
+        return nullptr;
+    }
+
+    const auto side = static_cast<std::size_t>(kernel.side());
+    kernel.taps.assign(side * side, 0.F);
+    for (std::size_t line_num{ 0 }; line_num < side && std::getline(stream, line); ++line_num) {
+        std::from_chars_result result{};
+        result.ptr = line.data() - 1;
+        for (std::size_t i{ 0 }; i < side; ++i) {
+            f32 value{ 0.F };
+            result = std::from_chars(result.ptr + 1, line.data() + line.size(), value);
+            if (result.ec != std::errc()) {
+                spdlog::error("Failed to parse kernel value from {}", path_str);
+                return nullptr;
+            }
+            kernel.taps[i + line_num * side] = value;
+        }
+    }
+
+    f32 taps_sum{ 0.F };
+    for (const auto tap : kernel.taps) {
+        taps_sum += tap;
+    }
+    if (taps_sum > 0.F) {
+        for (auto& tap : kernel.taps) {
+            tap /= taps_sum;
+        }
+    }
+
+    auto filter = std::make_shared<Filter>();
+    filter->path = path;
+    if (kernel.radius <= gpu_max_radius) {
+        // vec4 array elements are tightly packed floats, so row major taps already match std140
+        filter->packed_taps = kernel.taps;
+    }
+    filter->prepared = PreparedKernel::prepare(std::move(kernel), gpu_max_radius);
+    spdlog::debug("Loaded {}x{} filter {}, {} engine",
+        filter->prepared.kernel.side(), filter->prepared.kernel.side(), path_str, engineName(filter->prepared.engine));
+    return filter;
+}
+
+std::vector<std::shared_ptr<const Filter>> FilterRegistry::snapshot(u64& generation) const {
+    const std::lock_guard lock(mutex);
+    generation = this->generation;
+    return filters;
+}
+
+void FilterRegistry::update(const fs::path& path, DirWatcher::Event event) {
+    if (!isFilter(path)) {
+        return;
+    }
+    // parsed outside of lock, UI thread only waits for the swap
+    std::shared_ptr<const Filter> filter;
+    if (event == DirWatcher::Event::CHANGED) {
+        filter = load(path, gpu_max_radius);
+        if (filter == nullptr) {
+            // half written or broken file, previous version stays
+            return;
+        }
+    }
+
+    const std::lock_guard lock(mutex);
+    const auto it = std::find_if(filters.begin(), filters.end(), [&](const auto& f) { return f->path == path; });
+    if (filter == nullptr) {
+        if (it == filters.end()) {
+            return;
+        }
+        filters.erase(it);
+        spdlog::info("Filter {} removed", path.string());
+    } else if (it != filters.end()) {
+        *it = std::move(filter);
+        spdlog::info("Filter {} reloaded", path.string());
+    } else {
+        filters.insert(std::upper_bound(filters.begin(), filters.end(), filter, pathLess), filter);
+        spdlog::info("Filter {} added", path.string());
+    }
+    ++generation;
+}
@@ -0,0 +1,208 @@
+#include "ForegroundMask.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stack>
+
+#include "Parallel.hpp"
+
+using namespace bm;
+
+// block becomes foreground when at least this many of 3x3 blocks around it are
+static constexpr i32 MAJORITY{ 5 };
+
+// sum and sum of squares of gray values per block
+struct BlockStats {
+    i64 sum{ 0 };
+    i64 squares{ 0 };
+    i64 count{ 0 };
+};
+
+// labels 4-connected blocks of value, returns label of every block (-1 for other value) and sizes of labels
+static std::vector<i32> label(const std::vector<u8>& blocks, i32 blocks_x, i32 blocks_y, u8 value, std::vector<i32>& sizes) {
+    std::vector<i32> labels(blocks.size(), -1);
+    std::stack<i32> pending;
+    for (i32 start{ 0 }; start < static_cast<i32>(blocks.size()); ++start) {
+        if (blocks[static_cast<std::size_t>(start)] != value || labels[static_cast<std::size_t>(start)] >= 0) {
+            continue;
+        }
+        const auto current = static_cast<i32>(sizes.size());
+        sizes.push_back(0);
+        labels[static_cast<std::size_t>(start)] = current;
+        pending.push(start);
+        while (!pending.empty()) {
+            const auto at = pending.top();
+            pending.pop();
+            ++sizes.back();
+            const auto x = at % blocks_x;
+            const auto y = at / blocks_x;
+            const std::array<std::array<i32, 2>, 4> neighbours{{ { x - 1, y }, { x + 1, y }, { x, y - 1 }, { x, y + 1 } }};
+            for (const auto [nx, ny] : neighbours) {
+                if (nx < 0 || nx >= blocks_x || ny < 0 || ny >= blocks_y) {
+                    continue;
+                }
+                const auto next = static_cast<std::size_t>(ny * blocks_x + nx);
+                if (blocks[next] == value && labels[next] < 0) {
+                    labels[next] = current;
+                    pending.push(static_cast<i32>(next));
+                }
+            }
+        }
+    }
+    return labels;
+}
+
+void ForegroundMask::compute(const Image& image, const OrientationField& field, f32 min_deviation, f32 min_coherence) {
+    block_size = field.block_size;
+    blocks_x = field.blocks_x;
+    blocks_y = field.blocks_y;
+    const auto blocks_num = static_cast<std::size_t>(blocks_x) * static_cast<std::size_t>(blocks_y);
+    std::vector<BlockStats> stats(blocks_num);
+
+    // bands are whole block rows so every block is summed by one thread only
+    parallelForBands(bandsNum(blocks_y, 1), blocks_y, [&](i32, i32 block_row_begin, i32 block_row_end) {
+        visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+            const auto y_end = std::min(block_row_end * block_size, image.height);
+            for (auto y{ block_row_begin * block_size }; y < y_end; ++y) {
+                const auto* row = image.row(y);
+                auto* block_row = &stats[static_cast<std::size_t>((y / block_size) * blocks_x)];
+                for (i32 block_x{ 0 }; block_x < blocks_x; ++block_x) {
+                    const auto x_end = std::min((block_x + 1) * block_size, image.width);
+                    i64 sum{ 0 };
+                    i64 squares{ 0 };
+                    for (auto x{ block_x * block_size }; x < x_end; ++x) {
+                        const i64 value = PixelTraits<F>::gray(row, x);
+                        sum += value;
+                        squares += value * value;
+                    }
+                    block_row[block_x].sum += sum;
+                    block_row[block_x].squares += squares;
+                    block_row[block_x].count += x_end - block_x * block_size;
+                }
+            }
+        });
+    });
+
+    std::vector<u8> raw(blocks_num, 0U);
+    for (std::size_t i{ 0 }; i < blocks_num; ++i) {
+        const auto count = static_cast<f64>(std::max<i64>(stats[i].count, 1));
+        const auto mean = static_cast<f64>(stats[i].sum) / count;
+        const auto deviation = std::sqrt(std::max(static_cast<f64>(stats[i].squares) / count - mean * mean, 0.));
+        raw[i] = deviation >= static_cast<f64>(min_deviation) && field.coherence[i] >= min_coherence ? 1U : 0U;
+    }
+
+    // majority vote removes single noisy blocks and closes single block gaps
+    blocks.assign(blocks_num, 0U);
+    for (i32 block_y{ 0 }; block_y < blocks_y; ++block_y) {
+        for (i32 block_x{ 0 }; block_x < blocks_x; ++block_x) {
+            i32 votes{ 0 };
+            for (auto v{ std::max(block_y - 1, 0) }; v <= std::min(block_y + 1, blocks_y - 1); ++v) {
+                for (auto u{ std::max(block_x - 1, 0) }; u <= std::min(block_x + 1, blocks_x - 1); ++u) {
+                    votes += raw[static_cast<std::size_t>(v * blocks_x + u)];
+                }
+            }
+            blocks[static_cast<std::size_t>(block_y * blocks_x + block_x)] = votes >= MAJORITY ? 1U : 0U;
+        }
+    }
+
+    // only the largest foreground area is the print, background enclosed by it are holes in it
+    std::vector<i32> sizes;
+    const auto labels = label(blocks, blocks_x, blocks_y, 1U, sizes);
+    const auto largest = static_cast<i32>(std::max_element(sizes.begin(), sizes.end()) - sizes.begin());
+    for (std::size_t i{ 0 }; i < blocks_num; ++i) {
+        blocks[i] = !sizes.empty() && labels[i] == largest ? 1U : 0U;
+    }
+    std::vector<i32> background_sizes;
+    const auto background_labels = label(blocks, blocks_x, blocks_y, 0U, background_sizes);
+    std::vector<u8> touches_border(background_sizes.size(), 0U);
+    for (i32 block_y{ 0 }; block_y < blocks_y; ++block_y) {
+        for (i32 block_x{ 0 }; block_x < blocks_x; ++block_x) {
+            const auto i = static_cast<std::size_t>(block_y * blocks_x + block_x);
+            const auto on_border = block_x == 0 || block_y == 0 || block_x == blocks_x - 1 || block_y == blocks_y - 1;
+            if (on_border && background_labels[i] >= 0) {
+                touches_border[static_cast<std::size_t>(background_labels[i])] = 1U;
+            }
+        }
+    }
+    for (std::size_t i{ 0 }; i < blocks_num; ++i) {
+        if (background_labels[i] >= 0 && touches_border[static_cast<std::size_t>(background_labels[i])] == 0U) {
+            blocks[i] = 1U;
+        }
+    }
+
+    i32 min_x{ blocks_x };
+    i32 min_y{ blocks_y };
+    i32 max_x{ -1 };
+    i32 max_y{ -1 };
+    for (i32 block_y{ 0 }; block_y < blocks_y; ++block_y) {
+        for (i32 block_x{ 0 }; block_x < blocks_x; ++block_x) {
+            if (blocks[static_cast<std::size_t>(block_y * blocks_x + block_x)] != 0U) {
+                min_x = std::min(min_x, block_x);
+                min_y = std::min(min_y, block_y);
+                max_x = std::max(max_x, block_x);
+                max_y = std::max(max_y, block_y);
+            }
+        }
+    }
+    bounds = {};
+    if (max_x >= 0) {
+        bounds.x = min_x * block_size;
+        bounds.y = min_y * block_size;
+        bounds.width = std::min((max_x + 1) * block_size, image.width) - bounds.x;
+        bounds.height = std::min((max_y + 1) * block_size, image.height) - bounds.y;
+    }
+}
+
+f32 ForegroundMask::coverage() const {
+    if (blocks.empty()) {
+        return 0.F;
+    }
+    return static_cast<f32>(std::count(blocks.begin(), blocks.end(), 1U)) / static_cast<f32>(blocks.size());
+}
+
+ForegroundMask::Box ForegroundMask::grownBounds(const Image& image, i32 halo) const {
+    Box box;
+    box.x = std::max(bounds.x - halo, 0);
+    box.y = std::max(bounds.y - halo, 0);
+    box.width = std::min(bounds.x + bounds.width + halo, image.width) - box.x;
+    box.height = std::min(bounds.y + bounds.height + halo, image.height) - box.y;
+    return box;
+}
+
+Image ForegroundMask::crop(const Image& image, i32 halo) const {
+    const auto box = grownBounds(image, halo);
+    Image cropped(box.width, box.height, image.format);
+    visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+        using Traits = PixelTraits<F>;
+        for (i32 y{ 0 }; y < box.height; ++y) {
+            const auto* src = image.row(box.y + y);
+            auto* dst = cropped.row(y);
+            for (i32 x{ 0 }; x < box.width; ++x) {
+                if (foreground(box.x + x, box.y + y)) {
+                    Traits::store(dst, x, Traits::load(src, box.x + x));
+                } else {
+                    Traits::storeGray(dst, x, 255U);
+                }
+            }
+        }
+    });
+    return cropped;
+}
+
+void ForegroundMask::paste(Image& image, const Image& cropped, i32 halo) const {
+    const auto box = grownBounds(image, halo);
+    image.convert(cropped.format);
+    visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+        using Traits = PixelTraits<F>;
+        for (i32 y{ 0 }; y < box.height; ++y) {
+            const auto* src = cropped.row(y);
+            auto* dst = image.row(box.y + y);
+            for (i32 x{ 0 }; x < box.width; ++x) {
+                if (foreground(box.x + x, box.y + y)) {
+                    Traits::store(dst, box.x + x, Traits::load(src, x));
+                }
+            }
+        }
+    });
+}
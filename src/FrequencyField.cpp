@@ -0,0 +1,162 @@
+#include "FrequencyField.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Parallel.hpp"
+
+using namespace bm;
+
+// signatures flatter than this (max - min of gray average) hold no ridges
+static constexpr f32 MIN_SIGNATURE_CONTRAST{ 8.F };
+// crossing counts only once signature got this part of its contrast past mid level
+static constexpr f32 HYSTERESIS{ .15F };
+// ridge spacings may differ from their mean by this part of it
+static constexpr f32 MAX_SPACING_DEVIATION{ .3F };
+// invalid blocks take gaussian weighted mean of valid ones within this many blocks
+static constexpr i32 INTERPOLATION_RADIUS{ 3 };
+static constexpr f32 INTERPOLATION_SIGMA{ 1.5F };
+
+// mean distance between upward crossings of signature's mid level, 0 if it doesn't look like ridges.
+// Crossings use hysteresis and their spacing has to be regular, so noise alone isn't taken for ridges.
+static f32 signaturePeriod(const std::vector<f32>& signature) {
+    const auto [min_it, max_it] = std::minmax_element(signature.begin(), signature.end());
+    const auto contrast = *max_it - *min_it;
+    if (contrast < MIN_SIGNATURE_CONTRAST) {
+        return 0.F;
+    }
+    const auto mid = .5F * (*min_it + *max_it);
+    const auto hysteresis = HYSTERESIS * contrast;
+
+    std::vector<f32> crossings;
+    bool above = signature.front() > mid;
+    for (std::size_t k{ 1 }; k < signature.size(); ++k) {
+        if (!above && signature[k] > mid + hysteresis) {
+            above = true;
+            // crossing itself is interpolated between samples around mid level
+            auto j = k;
+            while (j > 1 && signature[j - 1] > mid) {
+                --j;
+            }
+            const auto rise = signature[j] - signature[j - 1];
+            const auto fraction = rise > 0.F ? (mid - signature[j - 1]) / rise : 0.F;
+            crossings.push_back(static_cast<f32>(j - 1) + std::clamp(fraction, 0.F, 1.F));
+        } else if (above && signature[k] < mid - hysteresis) {
+            above = false;
+        }
+    }
+    if (crossings.size() < 2) {
+        return 0.F;
+    }
+    const auto period = (crossings.back() - crossings.front()) / static_cast<f32>(crossings.size() - 1);
+    for (std::size_t i{ 1 }; i < crossings.size(); ++i) {
+        if (std::abs(crossings[i] - crossings[i - 1] - period) > MAX_SPACING_DEVIATION * period) {
+            return 0.F;
+        }
+    }
+    return period >= FrequencyField::MIN_PERIOD && period <= FrequencyField::MAX_PERIOD ? period : 0.F;
+}
+
+void FrequencyField::compute(const Image& image, const OrientationField& field, f32 default_period) {
+    block_size = field.block_size;
+    blocks_x = field.blocks_x;
+    blocks_y = field.blocks_y;
+    const auto blocks_num = static_cast<std::size_t>(blocks_x) * static_cast<std::size_t>(blocks_y);
+    frequency.assign(blocks_num, 0.F);
+    measured.assign(blocks_num, 0U);
+    if (blocks_num == 0 || image.width == 0 || image.height == 0) {
+        return;
+    }
+
+    // signatures sample arbitrary positions, so gray values have to be addressable directly
+    PixelBuffer converted;
+    const u8* gray = image.pixels.data();
+    if (image.format != PixelFormat::GRAY8) {
+        image.convertTo(PixelFormat::GRAY8, converted);
+        gray = converted.data();
+    }
+    const auto gray_stride = PixelTraits<PixelFormat::GRAY8>::stride(image.width);
+    const auto max_x = static_cast<f32>(image.width - 1);
+    const auto max_y = static_cast<f32>(image.height - 1);
+
+    parallelForBands(bandsNum(blocks_y, 1), blocks_y, [&](i32, i32 block_row_begin, i32 block_row_end) {
+        const auto length = 2 * block_size;
+        const auto width = block_size;
+        std::vector<f32> signature(static_cast<std::size_t>(length));
+        std::vector<f32> smoothed(static_cast<std::size_t>(length));
+        for (i32 block_y{ block_row_begin }; block_y < block_row_end; ++block_y) {
+            for (i32 block_x{ 0 }; block_x < blocks_x; ++block_x) {
+                const auto orientation = field.orientation[field.index(block_x, block_y)];
+                const auto ridge_x = std::cos(orientation);
+                const auto ridge_y = std::sin(orientation);
+                const auto centre_x = (static_cast<f32>(block_x) + .5F) * static_cast<f32>(block_size);
+                const auto centre_y = (static_cast<f32>(block_y) + .5F) * static_cast<f32>(block_size);
+
+                // k runs along ridge normal (-ridge_y, ridge_x), samples of one k lie on a line along ridge
+                for (i32 k{ 0 }; k < length; ++k) {
+                    const auto across = static_cast<f32>(k - length / 2) + .5F;
+                    const auto line_x = centre_x - across * ridge_y;
+                    const auto line_y = centre_y + across * ridge_x;
+                    f32 sum{ 0.F };
+                    for (i32 d{ 0 }; d < width; ++d) {
+                        const auto along = static_cast<f32>(d - width / 2) + .5F;
+                        const auto x = static_cast<std::size_t>(std::clamp(line_x + along * ridge_x, 0.F, max_x) + .5F);
+                        const auto y = static_cast<std::size_t>(std::clamp(line_y + along * ridge_y, 0.F, max_y) + .5F);
+                        sum += static_cast<f32>(gray[y * gray_stride + x]);
+                    }
+                    signature[static_cast<std::size_t>(k)] = sum / static_cast<f32>(width);
+                }
+                // [1 2 1] smoothing keeps single pixel noise from splitting peaks
+                smoothed.front() = signature.front();
+                smoothed.back() = signature.back();
+                for (i32 k{ 1 }; k + 1 < length; ++k) {
+                    const auto i = static_cast<std::size_t>(k);
+                    smoothed[i] = .25F * (signature[i - 1] + 2.F * signature[i] + signature[i + 1]);
+                }
+
+                if (const auto period = signaturePeriod(smoothed); period > 0.F) {
+                    frequency[index(block_x, block_y)] = 1.F / period;
+                    measured[index(block_x, block_y)] = 1U;
+                }
+            }
+        }
+    });
+
+    if (std::find(measured.begin(), measured.end(), 1U) == measured.end()) {
+        const auto period = std::clamp(default_period, MIN_PERIOD, MAX_PERIOD);
+        std::fill(frequency.begin(), frequency.end(), 1.F / period);
+        return;
+    }
+
+    // invalid blocks are filled from their valid (or already filled) neighbours until none is left
+    std::vector<f32> next = frequency;
+    for (bool missing{ true }; missing;) {
+        missing = false;
+        for (i32 block_y{ 0 }; block_y < blocks_y; ++block_y) {
+            for (i32 block_x{ 0 }; block_x < blocks_x; ++block_x) {
+                if (frequency[index(block_x, block_y)] > 0.F) {
+                    continue;
+                }
+                f32 weighted{ 0.F };
+                f32 weights{ 0.F };
+                for (auto v{ std::max(block_y - INTERPOLATION_RADIUS, 0) }; v <= std::min(block_y + INTERPOLATION_RADIUS, blocks_y - 1); ++v) {
+                    for (auto u{ std::max(block_x - INTERPOLATION_RADIUS, 0) }; u <= std::min(block_x + INTERPOLATION_RADIUS, blocks_x - 1); ++u) {
+                        const auto value = frequency[index(u, v)];
+                        if (value > 0.F) {
+                            const auto distance = static_cast<f32>((u - block_x) * (u - block_x) + (v - block_y) * (v - block_y));
+                            const auto weight = std::exp(-.5F * distance / (INTERPOLATION_SIGMA * INTERPOLATION_SIGMA));
+                            weighted += weight * value;
+                            weights += weight;
+                        }
+                    }
+                }
+                if (weights > 0.F) {
+                    next[index(block_x, block_y)] = weighted / weights;
+                } else {
+                    missing = true;
+                }
+            }
+        }
+        frequency = next;
+    }
+}
@@ -0,0 +1,203 @@
+#include "Gabor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#include <spdlog/spdlog.h>
+
+#include "Parallel.hpp"
+
+using namespace bm;
+
+// kernels are cut off at this many sigmas
+static constexpr f32 TRUNCATION_SIGMAS{ 2.F };
+// gray = 127.5 + OUTPUT_GAIN * response, unit response to matching sinusoid of deviation 1 is its amplitude sqrt(2)
+static constexpr f32 OUTPUT_GAIN{ 80.F };
+
+GaborBank GaborBank::make(i32 orientations_num, std::vector<f32> periods) {
+    GaborBank bank;
+    bank.orientations_num = std::max(orientations_num, 1);
+    bank.periods = std::move(periods);
+    std::sort(bank.periods.begin(), bank.periods.end());
+    bank.kernels.reserve(static_cast<std::size_t>(bank.orientations_num) * bank.periods.size());
+
+    for (i32 q{ 0 }; q < bank.orientations_num; ++q) {
+        const auto orientation = std::numbers::pi * static_cast<f64>(q) / static_cast<f64>(bank.orientations_num);
+        // oscillation runs across ridges, along normal of orientation
+        const auto normal_x = -std::sin(orientation);
+        const auto normal_y = std::cos(orientation);
+        for (const auto period : bank.periods) {
+            const auto sigma = static_cast<f64>(SIGMA_PER_PERIOD * period);
+            const auto frequency = 2. * std::numbers::pi / static_cast<f64>(period);
+
+            Kernel kernel;
+            kernel.radius = static_cast<i32>(std::ceil(TRUNCATION_SIGMAS * sigma));
+            const auto taps_num = static_cast<std::size_t>(2 * kernel.radius + 1);
+            std::vector<f64> envelope(taps_num);
+            f64 envelope_sum{ 0. };
+            for (i32 t{ -kernel.radius }; t <= kernel.radius; ++t) {
+                const auto value = std::exp(-.5 * static_cast<f64>(t * t) / (sigma * sigma));
+                envelope[static_cast<std::size_t>(t + kernel.radius)] = value;
+                envelope_sum += value;
+            }
+            // cos^2 averages to 1/2, so (sum of envelope)^2 has to be 2
+            const auto scale = std::sqrt(2.) / envelope_sum;
+
+            kernel.row_re.resize(taps_num);
+            kernel.row_im.resize(taps_num);
+            kernel.column_re.resize(taps_num);
+            kernel.column_im.resize(taps_num);
+            for (i32 t{ -kernel.radius }; t <= kernel.radius; ++t) {
+                const auto i = static_cast<std::size_t>(t + kernel.radius);
+                const auto g = scale * envelope[i];
+                kernel.row_re[i] = static_cast<f32>(g * std::cos(frequency * normal_x * t));
+                kernel.row_im[i] = static_cast<f32>(g * std::sin(frequency * normal_x * t));
+                kernel.column_re[i] = static_cast<f32>(g * std::cos(frequency * normal_y * t));
+                kernel.column_im[i] = static_cast<f32>(g * std::sin(frequency * normal_y * t));
+            }
+            bank.max_radius = std::max(bank.max_radius, kernel.radius);
+            bank.kernels.push_back(std::move(kernel));
+        }
+    }
+    return bank;
+}
+
+const GaborBank::Kernel& GaborBank::select(f32 orientation, f32 period) const {
+    const auto step = std::numbers::pi_v<f32> / static_cast<f32>(orientations_num);
+    const auto q = static_cast<i32>(std::lround(orientation / step)) % orientations_num;
+    const auto nearest = std::min_element(periods.begin(), periods.end(), [&](f32 lhs, f32 rhs) {
+        return std::abs(lhs - period) < std::abs(rhs - period);
+    });
+    const auto p = static_cast<std::size_t>(nearest - periods.begin());
+    return kernels[static_cast<std::size_t>((q + orientations_num) % orientations_num) * periods.size() + p];
+}
+
+void bm::performGaborEnhancement(Image& image, const OrientationField& field, const FrequencyField& frequency, const GaborBank& bank,
+    const ForegroundMask* mask) {
+    if (field.empty() || bank.kernels.empty() || image.width == 0 || image.height == 0) {
+        return;
+    }
+    if (field.blocks_x != (image.width + field.block_size - 1) / field.block_size ||
+        field.blocks_y != (image.height + field.block_size - 1) / field.block_size) {
+        spdlog::error("Orientation field of {}x{} blocks doesn't belong to {}x{} image",
+            field.blocks_x, field.blocks_y, image.width, image.height);
+        return;
+    }
+    if (frequency.blocks_x != field.blocks_x || frequency.blocks_y != field.blocks_y) {
+        spdlog::error("Frequency field of {}x{} blocks doesn't match orientation field", frequency.blocks_x, frequency.blocks_y);
+        return;
+    }
+    if (mask != nullptr && (mask->blocks_x != field.blocks_x || mask->blocks_y != field.blocks_y)) {
+        spdlog::warn("Foreground mask of {}x{} blocks doesn't match orientation field, whole image is enhanced",
+            mask->blocks_x, mask->blocks_y);
+        mask = nullptr;
+    }
+    const auto padding = bank.max_radius;
+    const auto plane_width = image.width + 2 * padding;
+    const auto plane_height = image.height + 2 * padding;
+    const auto plane_index = [&](i32 x, i32 y) {
+        return static_cast<std::size_t>(y + padding) * static_cast<std::size_t>(plane_width) + static_cast<std::size_t>(x + padding);
+    };
+
+    // gray plane with edges replicated into padding, kernels never have to clamp
+    std::vector<f32> plane(static_cast<std::size_t>(plane_width) * static_cast<std::size_t>(plane_height));
+    const auto bands_num = bandsNum(image.height, 64);
+    std::vector<f64> band_sums(static_cast<std::size_t>(bands_num), 0.);
+    std::vector<f64> band_squares(static_cast<std::size_t>(bands_num), 0.);
+    parallelForBands(bands_num, plane_height, [&](i32 band, i32 begin, i32 end) {
+        visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+            for (i32 plane_y{ begin }; plane_y < end; ++plane_y) {
+                const auto y = plane_y - padding;
+                const auto* row = image.row(std::clamp(y, 0, image.height - 1));
+                auto* out = &plane[plane_index(-padding, y)];
+                for (i32 x{ 0 }; x < image.width; ++x) {
+                    out[x + padding] = static_cast<f32>(PixelTraits<F>::gray(row, x));
+                }
+                std::fill(out, out + padding, out[padding]);
+                std::fill(out + padding + image.width, out + plane_width, out[padding + image.width - 1]);
+                if (y >= 0 && y < image.height) {
+                    for (i32 x{ 0 }; x < image.width; ++x) {
+                        const auto value = static_cast<f64>(out[x + padding]);
+                        band_sums[static_cast<std::size_t>(band)] += value;
+                        band_squares[static_cast<std::size_t>(band)] += value * value;
+                    }
+                }
+            }
+        });
+    });
+    f64 sum{ 0. };
+    f64 squares{ 0. };
+    for (i32 band{ 0 }; band < bands_num; ++band) {
+        sum += band_sums[static_cast<std::size_t>(band)];
+        squares += band_squares[static_cast<std::size_t>(band)];
+    }
+    const auto pixels_num = static_cast<f64>(image.width) * static_cast<f64>(image.height);
+    const auto mean = static_cast<f32>(sum / pixels_num);
+    const auto deviation = static_cast<f32>(std::sqrt(std::max(squares / pixels_num - (sum / pixels_num) * (sum / pixels_num), 1.)));
+    // constant offset doesn't change relative response, so only deviation is divided out here
+    const auto gain = OUTPUT_GAIN / deviation;
+
+    // bands are whole block rows, each block writes only its own pixels
+    parallelForBands(bandsNum(field.blocks_y, 1), field.blocks_y, [&](i32, i32 block_row_begin, i32 block_row_end) {
+        const auto block_size = field.block_size;
+        const auto scratch_size = static_cast<std::size_t>(block_size + 2 * bank.max_radius) * static_cast<std::size_t>(block_size);
+        std::vector<f32> rows_re(scratch_size);
+        std::vector<f32> rows_im(scratch_size);
+        std::vector<f32> response(static_cast<std::size_t>(block_size));
+
+        visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+            for (i32 block_y{ block_row_begin }; block_y < block_row_end; ++block_y) {
+                const auto y0 = block_y * block_size;
+                const auto y1 = std::min(y0 + block_size, image.height);
+                for (i32 block_x{ 0 }; block_x < field.blocks_x; ++block_x) {
+                    if (mask != nullptr && mask->blocks[field.index(block_x, block_y)] == 0U) {
+                        continue;
+                    }
+                    const auto x0 = block_x * block_size;
+                    const auto x1 = std::min(x0 + block_size, image.width);
+                    const auto block_width = static_cast<std::size_t>(x1 - x0);
+                    const auto& kernel = bank.select(field.orientation[field.index(block_x, block_y)], frequency.period(block_x, block_y));
+                    const auto radius = kernel.radius;
+
+                    // complex row pass over block's columns, radius rows above and below included
+                    for (auto y{ y0 - radius }; y < y1 + radius; ++y) {
+                        const auto* src = &plane[plane_index(x0, y)];
+                        auto* re = &rows_re[static_cast<std::size_t>(y - y0 + radius) * block_width];
+                        auto* im = &rows_im[static_cast<std::size_t>(y - y0 + radius) * block_width];
+                        for (std::size_t x{ 0 }; x < block_width; ++x) {
+                            f32 sum_re{ 0.F };
+                            f32 sum_im{ 0.F };
+                            for (i32 t{ -radius }; t <= radius; ++t) {
+                                const auto value = src[static_cast<std::ptrdiff_t>(x) + t] - mean;
+                                sum_re += value * kernel.row_re[static_cast<std::size_t>(t + radius)];
+                                sum_im += value * kernel.row_im[static_cast<std::size_t>(t + radius)];
+                            }
+                            re[x] = sum_re;
+                            im[x] = sum_im;
+                        }
+                    }
+
+                    // column pass keeps real part only, vectorized across the block's row
+                    for (auto y{ y0 }; y < y1; ++y) {
+                        std::fill(response.begin(), response.end(), 0.F);
+                        for (i32 t{ -radius }; t <= radius; ++t) {
+                            const auto* re = &rows_re[static_cast<std::size_t>(y - y0 + radius + t) * block_width];
+                            const auto* im = &rows_im[static_cast<std::size_t>(y - y0 + radius + t) * block_width];
+                            const auto c_re = kernel.column_re[static_cast<std::size_t>(t + radius)];
+                            const auto c_im = kernel.column_im[static_cast<std::size_t>(t + radius)];
+                            for (std::size_t x{ 0 }; x < block_width; ++x) {
+                                response[x] += re[x] * c_re - im[x] * c_im;
+                            }
+                        }
+                        auto* row = image.row(y);
+                        for (std::size_t x{ 0 }; x < block_width; ++x) {
+                            const auto gray = std::clamp(127.5F + gain * response[x], 0.F, 255.F);
+                            PixelTraits<F>::storeGray(row, x0 + static_cast<i32>(x), static_cast<u8>(gray));
+                        }
+                    }
+                }
+            }
+        });
+    });
+}
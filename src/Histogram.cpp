@@ -1,5 +1,13 @@
 #include "Histogram.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "Parallel.hpp"
+
 using namespace bm;
 
 void Histogram::clear() {
@@ -9,22 +17,109 @@ void Histogram::clear() {
     std::fill(b_sums.begin(), b_sums.end(), 0);
 }
 
-void Histogram::set(const u8* data, std::size_t len, std::size_t channels_num) {
-    full_sum = len / channels_num;
+// rows per band below which spawning another thread doesn't pay off
+static constexpr i32 MIN_BAND_ROWS{ 64 };
+
+// per band partial result, merged after all bands are done
+struct BandSums {
+    std::array<u32, 256> mean_sums{};
+    std::array<u32, 256> r_sums{};
+    std::array<u32, 256> g_sums{};
+    std::array<u32, 256> b_sums{};
+    std::size_t ones{ 0 };
+};
 
-    const auto data_span = std::span<const u8>(data, len);
-    for (std::size_t i{ 0 }; i<data_span.size(); i+=channels_num) {
-        const auto r = data_span[i + 0];
-        const auto g = data_span[i + 1];
-        const auto b = data_span[i + 2];
+template<PixelFormat F>
+static void accumulateRows(BandSums& sums, const Image& image, i32 row_begin, i32 row_end) {
+    const auto width = static_cast<std::size_t>(image.width);
+    if constexpr (F == PixelFormat::RGBA8) {
+        for (i32 y{ row_begin }; y < row_end; ++y) {
+            const auto* row = image.row(y);
+            for (std::size_t x{ 0 }; x < width; ++x) {
+                const auto r = row[4 * x + 0];
+                const auto g = row[4 * x + 1];
+                const auto b = row[4 * x + 2];
 
-        ++r_sums[r];                
-        ++g_sums[g];                
-        ++b_sums[b];       
-        ++mean_sums[static_cast<std::size_t>(r + g + b) / 3UL];
+                ++sums.r_sums[r];
+                ++sums.g_sums[g];
+                ++sums.b_sums[b];
+                ++sums.mean_sums[static_cast<std::size_t>(r + g + b) / 3UL];
+            }
+        }
+    } else if constexpr (F == PixelFormat::GRAY8) {
+        // neighbouring pixels are usually equal, four interleaved histograms keep
+        // increments of the same bin from waiting on each other
+        std::array<std::array<u32, 256>, 4> partial{};
+        for (i32 y{ row_begin }; y < row_end; ++y) {
+            const auto* row = image.row(y);
+            std::size_t x{ 0 };
+            for (; x + 4 <= width; x += 4) {
+                ++partial[0][row[x + 0]];
+                ++partial[1][row[x + 1]];
+                ++partial[2][row[x + 2]];
+                ++partial[3][row[x + 3]];
+            }
+            for (; x < width; ++x) {
+                ++partial[0][row[x]];
+            }
+        }
+        for (std::size_t i{ 0 }; i < 256; ++i) {
+            sums.mean_sums[i] = partial[0][i] + partial[1][i] + partial[2][i] + partial[3][i];
+        }
+    } else {
+        // ones are counted per word, padding bits are masked out
+        const auto words_per_row = image.stride / sizeof(u64);
+        const u64 tail_mask = (image.width % 64) == 0 ? ~u64{ 0 } : (u64{ 1 } << (image.width % 64)) - 1;
+        for (i32 y{ row_begin }; y < row_end; ++y) {
+            for (std::size_t w{ 0 }; w < words_per_row; ++w) {
+                u64 word{ 0 };
+                std::memcpy(&word, image.row(y) + w * sizeof(u64), sizeof(u64));
+                const auto mask = w + 1 == words_per_row ? tail_mask : ~u64{ 0 };
+                sums.ones += static_cast<std::size_t>(std::popcount(word & mask));
+            }
+        }
     }
 }
 
+template<PixelFormat F>
+static void setImpl(Histogram& histogram, const Image& image) {
+    std::vector<BandSums> bands(static_cast<std::size_t>(bandsNum(image.height, MIN_BAND_ROWS)));
+    parallelForBands(static_cast<i32>(bands.size()), image.height, [&](i32 band, i32 row_begin, i32 row_end) {
+        accumulateRows<F>(bands[static_cast<std::size_t>(band)], image, row_begin, row_end);
+    });
+
+    std::size_t ones{ 0 };
+    for (const auto& band : bands) {
+        for (std::size_t i{ 0 }; i < 256; ++i) {
+            histogram.mean_sums[i] += band.mean_sums[i];
+            if constexpr (F == PixelFormat::RGBA8) {
+                histogram.r_sums[i] += band.r_sums[i];
+                histogram.g_sums[i] += band.g_sums[i];
+                histogram.b_sums[i] += band.b_sums[i];
+            }
+        }
+        ones += band.ones;
+    }
+    if constexpr (F == PixelFormat::BINARY1) {
+        histogram.mean_sums[255] += static_cast<u32>(ones);
+        histogram.mean_sums[0] += static_cast<u32>(histogram.full_sum - ones);
+    }
+    if constexpr (F != PixelFormat::RGBA8) {
+        // every channel histogram is the same
+        histogram.r_sums = histogram.mean_sums;
+        histogram.g_sums = histogram.mean_sums;
+        histogram.b_sums = histogram.mean_sums;
+    }
+}
+
+void Histogram::set(const Image& image) {
+    full_sum = static_cast<std::size_t>(image.width) * static_cast<std::size_t>(image.height);
+
+    visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+        setImpl<F>(*this, image);
+    });
+}
+
 void Histogram::computeDistributantForChannel(std::array<f32, 256>& result, Channel channel) const {
     const auto overall_count_f = static_cast<f32>(full_sum);
 
@@ -57,4 +152,28 @@ void Histogram::normalizeForChannel(std::array<f32, 256>& result, Channel channe
     for (std::size_t i{ 0 }; i < result.size(); ++i) {
         result[i] = static_cast<f32>((*sums)[i]) / overall_count_f;
     }
-}
\ No newline at end of file
+}
+
+u8 Histogram::percentile(Channel channel, f32 fraction) const {
+    const std::array<u32, 256>* sums = nullptr;
+    switch (channel) {
+    case Channel::R: sums = &r_sums; break;
+    case Channel::G: sums = &g_sums; break;
+    case Channel::B: sums = &b_sums; break;
+    case Channel::ALL: sums = &mean_sums; break;
+    }
+
+    // at least one pixel has to be reached so 0 and 1 yield min and max value
+    const auto rank = std::clamp(
+        static_cast<std::size_t>(std::ceil(static_cast<f64>(std::clamp(fraction, 0.F, 1.F)) * static_cast<f64>(full_sum))),
+        std::size_t{ 1 }, std::max(full_sum, std::size_t{ 1 })
+    );
+    std::size_t sum{ 0 };
+    for (std::size_t i{ 0 }; i < sums->size(); ++i) {
+        sum += (*sums)[i];
+        if (sum >= rank) {
+            return static_cast<u8>(i);
+        }
+    }
+    return 255U;
+}
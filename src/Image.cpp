@@ -1,15 +1,52 @@
 #include "Image.hpp"
 
+#include <cstring>
 #include <exception>
+#include <fstream>
+#include <mutex>
+#include <vector>
 
 #include <stb_image.h>
 #include <stb_image_write.h>
 
 #include <spdlog/spdlog.h>
 
+#include "MappedImage.hpp"
+
 using namespace bm;
 
-constexpr int DESIRED_CHANNELS_NUM{ 4 };
+template<PixelFormat Src, PixelFormat Dst>
+static void convertRows(const Image& src, u8* dst, std::size_t dst_stride) {
+    for (i32 y{ 0 }; y < src.height; ++y) {
+        const auto* src_row = src.row(y);
+        auto* dst_row = dst + static_cast<std::size_t>(y) * dst_stride;
+        if constexpr (Dst == PixelFormat::BINARY1) {
+            // whole words at once, padding bits end up cleared
+            for (i32 x0{ 0 }; x0 < src.width; x0 += 64) {
+                u64 word{ 0 };
+                const auto x_end = std::min(x0 + 64, src.width);
+                for (i32 x{ x0 }; x < x_end; ++x) {
+                    const auto bit = PixelTraits<Src>::gray(src_row, x) >= PixelTraits<Dst>::THRESHOLD;
+                    word |= static_cast<u64>(bit) << (x - x0);
+                }
+                std::memcpy(dst_row + (x0 / 64) * sizeof(u64), &word, sizeof(u64));
+            }
+        } else if constexpr (Dst == PixelFormat::RGBA8) {
+            for (i32 x{ 0 }; x < src.width; ++x) {
+                const auto px = PixelTraits<Src>::load(src_row, x);
+                auto* dst_px = dst_row + 4 * x;
+                dst_px[0] = px.r;
+                dst_px[1] = px.g;
+                dst_px[2] = px.b;
+                dst_px[3] = 255U;
+            }
+        } else {
+            for (i32 x{ 0 }; x < src.width; ++x) {
+                PixelTraits<Dst>::storeGray(dst_row, x, PixelTraits<Src>::gray(src_row, x));
+            }
+        }
+    }
+}
 
 Image::Image(const std::filesystem::path& image_path) {
     if (update(image_path)) {
@@ -17,12 +54,89 @@ Image::Image(const std::filesystem::path& image_path) {
     }
 }
 
-void Image::save(const std::filesystem::path& save_to_path) const {
+Image::Image(i32 width, i32 height, PixelFormat format)
+    : width(width), height(height), format(format) {
+    visitFormat(format, [&]<PixelFormat F>(FormatTag<F>) {
+        channels_num = PixelTraits<F>::channels_num;
+        stride = PixelTraits<F>::stride(width);
+    });
+    pixels.resize(stride * static_cast<std::size_t>(height));
+    if (!pixels.empty()) {
+        std::memset(pixels.data(), 0, pixels.size());
+    }
+}
+
+Image Image::sharing(const std::shared_ptr<const Image>& image) {
+    Image shared(0, 0, image->format);
+    shared.width = image->width;
+    shared.height = image->height;
+    shared.channels_num = image->channels_num;
+    shared.stride = image->stride;
+    shared.current_path = image->current_path;
+    // aliasing pointer keeps whole image (and adopted mapping of its pixels) alive
+    shared.pixels = PixelBuffer::share(std::shared_ptr<const u8>(image, image->pixels.data()), image->pixels.size());
+    return shared;
+}
+
+// stbi_write_png_compression_level is a global, png encodes are serialized so concurrent saves don't race on it
+static std::mutex png_write_mutex;
+
+template<PixelFormat F>
+static bool writePgm(const Image& image, std::ofstream& stream) {
+    stream << "P5\n" << image.width << ' ' << image.height << "\n255\n";
+    if constexpr (F == PixelFormat::GRAY8) {
+        stream.write(reinterpret_cast<const char*>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size())); // NOLINT
+    } else {
+        std::vector<u8> row(static_cast<std::size_t>(image.width));
+        for (i32 y{ 0 }; y < image.height; ++y) {
+            for (i32 x{ 0 }; x < image.width; ++x) {
+                row[static_cast<std::size_t>(x)] = PixelTraits<F>::gray(image.row(y), x);
+            }
+            stream.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size())); // NOLINT
+        }
+    }
+    return stream.good();
+}
+
+template<PixelFormat F>
+static bool writePbm(const Image& image, std::ofstream& stream) {
+    // pbm rows are MSB first and 1 means black
+    stream << "P4\n" << image.width << ' ' << image.height << '\n';
+    std::vector<u8> row(static_cast<std::size_t>((image.width + 7) / 8));
+    for (i32 y{ 0 }; y < image.height; ++y) {
+        const auto* src_row = image.row(y);
+        if constexpr (F == PixelFormat::BINARY1) {
+            for (std::size_t i{ 0 }; i < row.size(); ++i) {
+                const auto reversed = static_cast<u8>(~src_row[i]);
+                u8 byte{ 0 };
+                for (u32 bit{ 0 }; bit < 8; ++bit) {
+                    byte = static_cast<u8>(byte | (((reversed >> bit) & 1U) << (7U - bit)));
+                }
+                row[i] = byte;
+            }
+            // padding bits of last byte have to be zero
+            if (const auto tail = image.width % 8; tail != 0) {
+                row.back() = static_cast<u8>(row.back() & (0xFFU << (8 - tail)));
+            }
+        } else {
+            std::fill(row.begin(), row.end(), 0U);
+            for (i32 x{ 0 }; x < image.width; ++x) {
+                if (PixelTraits<F>::gray(src_row, x) < PixelTraits<PixelFormat::BINARY1>::THRESHOLD) {
+                    row[static_cast<std::size_t>(x / 8)] |= static_cast<u8>(0x80U >> (x % 8));
+                }
+            }
+        }
+        stream.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size())); // NOLINT
+    }
+    return stream.good();
+}
+
+bool Image::save(const std::filesystem::path& save_to_path, const SaveOptions& options) const {
     const auto save_to_path_str = save_to_path.string();
 
-    if (!std::filesystem::is_regular_file(save_to_path)) {
-        spdlog::error("File can only be saved to regular file path", save_to_path_str);
-        return;
+    if (std::filesystem::exists(save_to_path) && !std::filesystem::is_regular_file(save_to_path)) {
+        spdlog::error("File can only be saved to regular file path (passed {})", save_to_path_str);
+        return false;
     }
 
     auto extension = save_to_path.extension().string();
@@ -32,30 +146,57 @@ void Image::save(const std::filesystem::path& save_to_path) const {
         extension.begin(), 
         [](u8 c) { return std::tolower(c); }
     );
+
+    if (extension == ".pgm" || extension == ".pbm") {
+        std::ofstream stream(save_to_path, std::ios::binary);
+        if (!stream.good()) {
+            spdlog::error("Failed to open {} for writing", save_to_path_str);
+            return false;
+        }
+        const auto written = visitFormat(format, [&]<PixelFormat F>(FormatTag<F>) {
+            return extension == ".pgm" ? writePgm<F>(*this, stream) : writePbm<F>(*this, stream);
+        });
+        if (!written) {
+            spdlog::error("Failed to write image as {} to {}", extension, save_to_path_str);
+        }
+        return written;
+    }
+
+    // stbi can't write packed bits
+    PixelBuffer unpacked;
+    const u8* data = pixels.data();
+    if (format == PixelFormat::BINARY1) {
+        convertTo(PixelFormat::GRAY8, unpacked);
+        data = unpacked.data();
+    }
+
     if (std::strcmp(extension.c_str(), ".jpg") == 0 || std::strcmp(extension.c_str(), ".jpeg") == 0) {
         if (stbi_write_jpg(
             save_to_path_str.c_str(),
             width, height, channels_num, 
-            static_cast<const void*>(pixels.data()),
-            100
+            static_cast<const void*>(data),
+            options.jpg_quality
         ) == 0) {
             spdlog::error("Failed to write image as jpg to {}", save_to_path_str);
-            return;
+            return false;
         }
     } else if (std::strcmp(extension.c_str(), ".png") == 0) {
+        std::lock_guard lock(png_write_mutex);
+        stbi_write_png_compression_level = options.png_compression_level;
         if (stbi_write_png(
             save_to_path_str.c_str(),
             width, height, channels_num, 
-            static_cast<const void*>(pixels.data()),
+            static_cast<const void*>(data),
             width * channels_num
         ) == 0) {
             spdlog::error("Failed to write image as png to {}", save_to_path_str);
-            return;
+            return false;
         }
     } else {
-        spdlog::error("Wrong file extension can save only jpg/jpeg and png (passed {})", extension);
-        return;
+        spdlog::error("Wrong file extension can save only jpg/jpeg, png, pgm and pbm (passed {})", extension);
+        return false;
     }
+    return true;
 }
 
 bool Image::update(const std::filesystem::path& update_from_path) {
@@ -66,15 +207,55 @@ bool Image::update(const std::filesystem::path& update_from_path) {
         return false;
     }
 
+    if (MappedImage::isSupported(update_from_path)) {
+        MappedImage mapped;
+        // 16 bit and ascii netpbm variants can't be mapped, stbi still decodes those
+        if (mapped.open(update_from_path)) {
+            if (mapped.view.encoding == ImageView::Encoding::GRAY8 && mapped.view.max_value == 255 &&
+                mapped.view.stride == static_cast<std::size_t>(mapped.view.width)) {
+                // payload is used in place, pages are read on first access
+                width = mapped.view.width;
+                height = mapped.view.height;
+                channels_num = PixelTraits<PixelFormat::GRAY8>::channels_num;
+                format = PixelFormat::GRAY8;
+                stride = mapped.view.stride;
+                pixels = mapped.takePixels();
+            } else {
+                const auto target = mapped.view.encoding == ImageView::Encoding::PBM1 ? PixelFormat::BINARY1 : PixelFormat::GRAY8;
+                auto decoded = mapped.toImage(target);
+                width = decoded.width;
+                height = decoded.height;
+                channels_num = decoded.channels_num;
+                format = decoded.format;
+                stride = decoded.stride;
+                pixels = std::move(decoded.pixels);
+            }
+            return true;
+        }
+        if (update_from_path.extension() == ".raw") {
+            return false;
+        }
+    }
+
     int width       { 0 };
     int height      { 0 };
     int channels_num{ 0 };
+    if (stbi_info(update_from_path_str.c_str(), &width, &height, &channels_num) == 0) {
+        spdlog::error("Failed to load image from {}", update_from_path_str);
+        return false;
+    }
+    // gray and gray+alpha files don't need to be expanded to rgba
+    const auto format = channels_num <= 2 ? PixelFormat::GRAY8 : PixelFormat::RGBA8;
+    const auto desired_channels_num = format == PixelFormat::GRAY8 ?
+        PixelTraits<PixelFormat::GRAY8>::channels_num :
+        PixelTraits<PixelFormat::RGBA8>::channels_num;
+
     auto* img_ptr = stbi_load(
         update_from_path_str.c_str(), 
         &width, 
         &height, 
         &channels_num, 
-        DESIRED_CHANNELS_NUM
+        desired_channels_num
     );
 
     if (img_ptr == nullptr) {
@@ -84,16 +265,39 @@ bool Image::update(const std::filesystem::path& update_from_path) {
 
     this->width = width;
     this->height = height;
-    this->channels_num = DESIRED_CHANNELS_NUM;
-    pixels.resize(static_cast<std::size_t>(width * height * DESIRED_CHANNELS_NUM));
-
-    std::copy(
-        img_ptr, std::next(img_ptr, static_cast<std::ptrdiff_t>(pixels.size())), 
-        pixels.begin()
+    this->channels_num = desired_channels_num;
+    this->format = format;
+    this->stride = static_cast<std::size_t>(width) * static_cast<std::size_t>(desired_channels_num);
+    // stbi allocates from PixelPool (see res/stbi/stbi.cpp), decoded buffer is taken over as is
+    pixels = PixelBuffer::adopt(
+        img_ptr,
+        stride * static_cast<std::size_t>(height),
+        stbi_image_free
     );
 
-    stbi_image_free(img_ptr);
-    img_ptr = nullptr;
-
     return true;
+}
+
+void Image::convertTo(PixelFormat target, PixelBuffer& out) const {
+    visitFormat(target, [&]<PixelFormat Dst>(FormatTag<Dst>) {
+        const auto dst_stride = PixelTraits<Dst>::stride(width);
+        out.resize(dst_stride * static_cast<std::size_t>(height));
+        visitFormat(format, [&]<PixelFormat Src>(FormatTag<Src>) {
+            convertRows<Src, Dst>(*this, out.data(), dst_stride);
+        });
+    });
+}
+
+void Image::convert(PixelFormat target) {
+    if (target == format) {
+        return;
+    }
+    PixelBuffer converted;
+    convertTo(target, converted);
+    pixels = std::move(converted);
+    format = target;
+    visitFormat(format, [&]<PixelFormat F>(FormatTag<F>) {
+        channels_num = PixelTraits<F>::channels_num;
+        stride = PixelTraits<F>::stride(width);
+    });
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include "ImageCache.hpp"
+
+#include <spdlog/spdlog.h>
+
+using namespace bm;
+
+static bool stampOf(const fs::path& path, ImageCache::Stamp& stamp) {
+    std::error_code ec;
+    stamp.mtime = fs::last_write_time(path, ec);
+    if (ec) { return false; }
+    stamp.size = fs::file_size(path, ec);
+    return !ec;
+}
+
+static std::size_t imageBytes(const Image& image) {
+    return image.pixels.size();
+}
+
+ImageCache::ImageCache(std::size_t budget_bytes, std::size_t workers_num)
+    : budget_bytes(budget_bytes), workers(workers_num) {}
+
+std::shared_ptr<const Image> ImageCache::acquire(const fs::path& path) {
+    Stamp stamp;
+    if (!stampOf(path, stamp)) {
+        spdlog::error("Failed to stat {}", path.string());
+        return nullptr;
+    }
+    return load(path.string(), stamp);
+}
+
+void ImageCache::prefetch(const fs::path& path) {
+    auto path_str = path.string();
+    {
+        std::lock_guard lock(mutex);
+        if (index.contains(path_str) || in_flight.contains(path_str) || queued.contains(path_str)) {
+            return;
+        }
+        queued.insert(path_str);
+    }
+    workers.submit([this, path_str = std::move(path_str)] {
+        {
+            std::lock_guard lock(mutex);
+            // request was dropped by prefetchNeighbours in the meantime
+            if (queued.erase(path_str) == 0) {
+                return;
+            }
+        }
+        Stamp stamp;
+        if (stampOf(path_str, stamp)) {
+            load(path_str, stamp);
+        }
+    });
+}
+
+void ImageCache::prefetchNeighbours(const std::vector<fs::path>& files, std::size_t index, std::size_t radius) {
+    workers.discardPending();
+    {
+        std::lock_guard lock(mutex);
+        queued.clear();
+    }
+    if (index >= files.size()) {
+        return;
+    }
+    // nearest neighbours first, workers pick tasks in submission order
+    for (std::size_t distance{ 1 }; distance <= radius; ++distance) {
+        if (index + distance < files.size()) {
+            prefetch(files[index + distance]);
+        }
+        if (index >= distance) {
+            prefetch(files[index - distance]);
+        }
+    }
+}
+
+void ImageCache::setBudget(std::size_t budget_bytes) {
+    std::lock_guard lock(mutex);
+    this->budget_bytes = budget_bytes;
+    evict(0);
+}
+
+void ImageCache::clear() {
+    std::lock_guard lock(mutex);
+    entries.clear();
+    index.clear();
+    used_bytes = 0;
+}
+
+std::shared_ptr<const Image> ImageCache::load(const std::string& path, Stamp stamp) {
+    std::promise<std::shared_ptr<const Image>> promise;
+    {
+        std::unique_lock lock(mutex);
+        if (auto image = lookup(path, stamp); image != nullptr) {
+            return image;
+        }
+        if (const auto found = in_flight.find(path); found != in_flight.end()) {
+            // someone else is already decoding this file, wait for it
+            auto future = found->second;
+            lock.unlock();
+            return future.get();
+        }
+        in_flight.emplace(path, promise.get_future().share());
+    }
+
+    auto image = std::make_shared<Image>(path);
+    std::shared_ptr<const Image> result = image->current_path.empty() ? nullptr : std::move(image);
+
+    {
+        std::lock_guard lock(mutex);
+        if (result != nullptr) {
+            insert(path, stamp, result);
+        }
+        in_flight.erase(path);
+    }
+    promise.set_value(result);
+
+    return result;
+}
+
+std::shared_ptr<const Image> ImageCache::lookup(const std::string& path, Stamp stamp) {
+    const auto found = index.find(path);
+    if (found == index.end()) {
+        return nullptr;
+    }
+    const auto entry = found->second;
+    if (entry->stamp != stamp) {
+        used_bytes -= imageBytes(*entry->image);
+        entries.erase(entry);
+        index.erase(found);
+        return nullptr;
+    }
+    entries.splice(entries.begin(), entries, entry);
+    return entry->image;
+}
+
+void ImageCache::insert(const std::string& path, Stamp stamp, std::shared_ptr<const Image> image) {
+    const auto bytes = imageBytes(*image);
+    if (bytes > budget_bytes) {
+        return;
+    }
+    if (const auto found = index.find(path); found != index.end()) {
+        used_bytes -= imageBytes(*found->second->image);
+        entries.erase(found->second);
+        index.erase(found);
+    }
+    evict(bytes);
+
+    entries.push_front(Entry{ path, stamp, std::move(image) });
+    index[path] = entries.begin();
+    used_bytes += bytes;
+}
+
+void ImageCache::evict(std::size_t required_bytes) {
+    while (!entries.empty() && used_bytes + required_bytes > budget_bytes) {
+        const auto& last = entries.back();
+        used_bytes -= imageBytes(*last.image);
+        index.erase(last.path);
+        entries.pop_back();
+    }
+}
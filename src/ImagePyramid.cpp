@@ -0,0 +1,109 @@
+#include "ImagePyramid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Parallel.hpp"
+
+using namespace bm;
+
+// levels are cheap to reduce, bands thinner than this aren't worth a thread
+static constexpr i32 MIN_BAND_ROWS{ 64 };
+
+// dst is half of src (rounded down, at least 1) in both directions, odd last
+// row/column is dropped as in GL mip chain, 1 px wide/tall source is repeated
+template<i32 Channels>
+static void reduceRows(const u8* src, std::size_t src_stride, i32 src_width, i32 src_height, Image& dst, i32 begin, i32 end) {
+    for (i32 y{ begin }; y < end; ++y) {
+        const auto* row0 = src + static_cast<std::size_t>(std::min(2 * y, src_height - 1)) * src_stride;
+        const auto* row1 = src + static_cast<std::size_t>(std::min(2 * y + 1, src_height - 1)) * src_stride;
+        auto* out = dst.row(y);
+        if (src_width == 1) {
+            for (i32 c{ 0 }; c < Channels; ++c) {
+                out[c] = static_cast<u8>((row0[c] + row1[c] + 1) >> 1);
+            }
+            continue;
+        }
+        // plain loop over u8 rows, vectorized by compiler
+        for (i32 x{ 0 }; x < dst.width; ++x) {
+            const auto* a = row0 + 2 * x * Channels;
+            const auto* b = row1 + 2 * x * Channels;
+            for (i32 c{ 0 }; c < Channels; ++c) {
+                out[x * Channels + c] = static_cast<u8>((a[c] + a[c + Channels] + b[c] + b[c + Channels] + 2) >> 2);
+            }
+        }
+    }
+}
+
+void ImagePyramid::build(const Image& image) {
+    const u8* src = image.pixels.data();
+    auto src_stride = image.stride;
+    auto format = image.format;
+    if (image.format == PixelFormat::BINARY1) {
+        image.convertTo(PixelFormat::GRAY8, base_scratch);
+        src = base_scratch.data();
+        src_stride = PixelTraits<PixelFormat::GRAY8>::stride(image.width);
+        format = PixelFormat::GRAY8;
+    } else {
+        base_scratch.reset();
+    }
+
+    const auto levels_num = Texture2D::levelsNum(image.width, image.height);
+    levels.clear();
+    levels.reserve(static_cast<std::size_t>(levels_num - 1));
+    auto src_width = image.width;
+    auto src_height = image.height;
+    for (i32 level{ 1 }; level < levels_num; ++level) {
+        auto& dst = levels.emplace_back(std::max(src_width / 2, 1), std::max(src_height / 2, 1), format);
+        parallelForBands(bandsNum(dst.height, MIN_BAND_ROWS), dst.height, [&](i32, i32 begin, i32 end) {
+            if (format == PixelFormat::RGBA8) {
+                reduceRows<4>(src, src_stride, src_width, src_height, dst, begin, end);
+            } else {
+                reduceRows<1>(src, src_stride, src_width, src_height, dst, begin, end);
+            }
+        });
+        src = dst.pixels.data();
+        src_stride = dst.stride;
+        src_width = dst.width;
+        src_height = dst.height;
+    }
+
+    pending_level = levels_num - 1;
+    uploaded_level = levels_num;
+}
+
+void ImagePyramid::upload(const Texture2D& texture, const Image& image, std::size_t budget) {
+    std::size_t uploaded{ 0 };
+    while (pending_level >= 0 && (uploaded == 0 || uploaded < budget)) {
+        if (pending_level == 0) {
+            const auto* data = base_scratch.empty() ? image.pixels.data() : base_scratch.data();
+            texture.update(data, 0);
+            uploaded += base_scratch.empty() ? image.pixels.size() : base_scratch.size();
+        } else {
+            const auto& level = levels[static_cast<std::size_t>(pending_level - 1)];
+            texture.update(level.pixels.data(), pending_level);
+            uploaded += level.pixels.size();
+        }
+        uploaded_level = pending_level;
+        --pending_level;
+    }
+}
+
+void ImagePyramid::flush(const Texture2D& texture, const Image& image) {
+    upload(texture, image, lim<std::size_t>::max());
+}
+
+void ImagePyramid::regenerate(const Texture2D& texture) {
+    texture.generateMipmap();
+    pending_level = -1;
+    uploaded_level = 0;
+}
+
+i32 ImagePyramid::selectLevel(f32 texels_per_px) const {
+    const auto finest = std::min(uploaded_level, levelsNum() - 1);
+    if (!(texels_per_px > 1.F)) {
+        return finest;
+    }
+    const auto level = static_cast<i32>(std::lround(std::log2(texels_per_px)));
+    return std::clamp(level, finest, levelsNum() - 1);
+}
@@ -0,0 +1,361 @@
+#include "MappedImage.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <spdlog/spdlog.h>
+
+using namespace bm;
+
+static u8* mapFile(const fs::path& path, std::size_t& length) {
+#ifdef _WIN32
+    auto* file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    LARGE_INTEGER file_size{};
+    if (GetFileSizeEx(file, &file_size) == 0 || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return nullptr;
+    }
+    // copy-on-write, view stays valid after handles are closed
+    auto* mapping = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        return nullptr;
+    }
+    auto* base = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+    length = static_cast<std::size_t>(file_size.QuadPart);
+    return static_cast<u8*>(base);
+#else
+    const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC); // NOLINT
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat file_stat{};
+    if (::fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    length = static_cast<std::size_t>(file_stat.st_size);
+    // private so algorithms may write in place, only touched pages get copied
+    auto* base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) { // NOLINT
+        return nullptr;
+    }
+    ::madvise(base, length, MADV_SEQUENTIAL);
+    return static_cast<u8*>(base);
+#endif
+}
+
+static void unmapFile(u8* base, std::size_t length) {
+#ifdef _WIN32
+    (void)length;
+    UnmapViewOfFile(base);
+#else
+    ::munmap(base, length);
+#endif
+}
+
+// PixelBuffer deleters only get data pointer, mapping base/length of adopted views are looked up here
+struct AdoptedMapping {
+    u8* base;
+    std::size_t length;
+};
+static std::mutex adopted_mutex;
+static std::unordered_map<const void*, AdoptedMapping> adopted_mappings;
+
+static void releaseAdoptedMapping(void* data) {
+    std::optional<AdoptedMapping> mapping;
+    {
+        std::lock_guard lock(adopted_mutex);
+        if (const auto it = adopted_mappings.find(data); it != adopted_mappings.end()) {
+            mapping = it->second;
+            adopted_mappings.erase(it);
+        }
+    }
+    if (mapping) {
+        unmapFile(mapping->base, mapping->length);
+    }
+}
+
+// netpbm header tokens are separated by whitespace, '#' starts comment running to end of line
+static std::optional<std::size_t> readPnmNumber(const u8* data, std::size_t length, std::size_t& offset) {
+    while (offset < length) {
+        if (data[offset] == '#') {
+            while (offset < length && data[offset] != '\n') { ++offset; }
+        } else if (std::isspace(data[offset]) != 0) {
+            ++offset;
+        } else {
+            break;
+        }
+    }
+    std::size_t value{ 0 };
+    const auto start = offset;
+    while (offset < length && std::isdigit(data[offset]) != 0 && offset - start < 10) {
+        value = value * 10 + static_cast<std::size_t>(data[offset] - '0');
+        ++offset;
+    }
+    if (offset == start) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+struct Layout {
+    std::size_t width{ 0 };
+    std::size_t height{ 0 };
+    std::size_t stride{ 0 };
+    std::size_t offset{ 0 };
+    ImageView::Encoding encoding{ ImageView::Encoding::GRAY8 };
+    // largest gray sample of pgm, see ImageView::max_value
+    std::size_t max_value{ 255 };
+};
+
+static std::optional<Layout> parsePnmHeader(const u8* data, std::size_t length) {
+    if (length < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '4')) {
+        spdlog::error("Only binary pgm (P5) and pbm (P4) files can be mapped");
+        return std::nullopt;
+    }
+    Layout layout;
+    layout.encoding = data[1] == '5' ? ImageView::Encoding::GRAY8 : ImageView::Encoding::PBM1;
+
+    std::size_t offset{ 2 };
+    const auto width = readPnmNumber(data, length, offset);
+    const auto height = readPnmNumber(data, length, offset);
+    if (!width || !height) {
+        spdlog::error("Malformed netpbm header");
+        return std::nullopt;
+    }
+    layout.width = *width;
+    layout.height = *height;
+    if (layout.encoding == ImageView::Encoding::GRAY8) {
+        const auto max_value = readPnmNumber(data, length, offset);
+        if (!max_value || *max_value == 0 || *max_value > 255) {
+            spdlog::error("Only 8 bit pgm files can be mapped");
+            return std::nullopt;
+        }
+        layout.max_value = *max_value;
+        layout.stride = layout.width;
+    } else {
+        layout.stride = (layout.width + 7) / 8;
+    }
+    // exactly one whitespace character separates header from payload
+    layout.offset = offset + 1;
+    return layout;
+}
+
+static std::optional<Layout> parseSidecarHeader(const fs::path& header_path) {
+    std::ifstream stream(header_path);
+    if (!stream.good()) {
+        spdlog::error("Raw image needs sidecar header {}", header_path.string());
+        return std::nullopt;
+    }
+    Layout layout;
+    std::string key;
+    std::size_t value{ 0 };
+    while (stream >> key >> value) {
+        if (key == "width") {
+            layout.width = value;
+        } else if (key == "height") {
+            layout.height = value;
+        } else if (key == "stride") {
+            layout.stride = value;
+        } else if (key == "offset") {
+            layout.offset = value;
+        } else {
+            spdlog::warn("Unknown key {} in {}", key, header_path.string());
+        }
+    }
+    if (layout.stride == 0) {
+        layout.stride = layout.width;
+    }
+    if (layout.stride < layout.width) {
+        spdlog::error("Raw image stride can't be smaller than its width ({})", header_path.string());
+        return std::nullopt;
+    }
+    return layout;
+}
+
+static std::string lowerExtension(const fs::path& path) {
+    auto extension = path.extension().string();
+    std::transform(
+        extension.begin(),
+        extension.end(),
+        extension.begin(),
+        [](u8 c) { return std::tolower(c); }
+    );
+    return extension;
+}
+
+bool MappedImage::readSize(const fs::path& path, i32& width, i32& height) {
+    std::optional<Layout> layout;
+    if (lowerExtension(path) == ".raw") {
+        layout = parseSidecarHeader(fs::path(path).concat(".hdr"));
+    } else {
+        // netpbm header with comments fits easily, payload isn't read
+        std::array<u8, 4096> header{};
+        std::ifstream stream(path, std::ios::binary);
+        stream.read(reinterpret_cast<char*>(header.data()), static_cast<std::streamsize>(header.size())); // NOLINT
+        layout = parsePnmHeader(header.data(), static_cast<std::size_t>(stream.gcount()));
+    }
+    const auto max_side = static_cast<std::size_t>(lim<i32>::max());
+    if (!layout || layout->width > max_side || layout->height > max_side) {
+        return false;
+    }
+    width = static_cast<i32>(layout->width);
+    height = static_cast<i32>(layout->height);
+    return true;
+}
+
+MappedImage::MappedImage(MappedImage&& other) noexcept
+    : base(std::exchange(other.base, nullptr)),
+      length(std::exchange(other.length, 0)),
+      view(std::exchange(other.view, {})) {}
+
+MappedImage& MappedImage::operator=(MappedImage&& other) noexcept {
+    if (this != &other) {
+        close();
+        base = std::exchange(other.base, nullptr);
+        length = std::exchange(other.length, 0);
+        view = std::exchange(other.view, {});
+    }
+    return *this;
+}
+
+MappedImage::~MappedImage() {
+    close();
+}
+
+bool MappedImage::isSupported(const fs::path& path) {
+    const auto extension = lowerExtension(path);
+    return extension == ".pgm" || extension == ".pbm" || extension == ".raw";
+}
+
+bool MappedImage::open(const fs::path& path) {
+    close();
+    const auto path_str = path.string();
+
+    const auto is_raw = lowerExtension(path) == ".raw";
+    std::optional<Layout> layout;
+    if (is_raw) {
+        layout = parseSidecarHeader(fs::path(path).concat(".hdr"));
+        if (!layout) {
+            return false;
+        }
+    }
+
+    base = mapFile(path, length);
+    if (base == nullptr) {
+        spdlog::error("Failed to map {}", path_str);
+        length = 0;
+        return false;
+    }
+
+    if (!is_raw) {
+        layout = parsePnmHeader(base, length);
+    }
+    const auto max_side = static_cast<std::size_t>(lim<i32>::max());
+    if (!layout || layout->width == 0 || layout->height == 0 || layout->width > max_side || layout->height > max_side ||
+        layout->offset > length || (length - layout->offset) / layout->stride < layout->height) {
+        spdlog::error("{} is truncated or has invalid dimensions", path_str);
+        close();
+        return false;
+    }
+
+    view.data = base + layout->offset;
+    view.width = static_cast<i32>(layout->width);
+    view.height = static_cast<i32>(layout->height);
+    view.stride = layout->stride;
+    view.encoding = layout->encoding;
+    view.max_value = static_cast<u32>(layout->max_value);
+    return true;
+}
+
+void MappedImage::close() {
+    if (base != nullptr) {
+        unmapFile(base, length);
+    }
+    base = nullptr;
+    length = 0;
+    view = {};
+}
+
+PixelBuffer MappedImage::takePixels() {
+    if (base == nullptr || view.encoding != ImageView::Encoding::GRAY8) {
+        return {};
+    }
+    auto* data = const_cast<u8*>(view.data); // NOLINT mapping is private and writable
+    {
+        std::lock_guard lock(adopted_mutex);
+        adopted_mappings.emplace(data, AdoptedMapping{ base, length });
+    }
+    auto pixels = PixelBuffer::adopt(data, view.stride * static_cast<std::size_t>(view.height), releaseAdoptedMapping);
+    base = nullptr;
+    length = 0;
+    view = {};
+    return pixels;
+}
+
+Image MappedImage::toImage(PixelFormat format) const {
+    Image image(view.width, view.height, format);
+    visitFormat(format, [&]<PixelFormat F>(FormatTag<F>) {
+        for (i32 y{ 0 }; y < view.height; ++y) {
+            auto* dst_row = image.row(y);
+            const auto* src_row = view.row(y);
+            if constexpr (F == PixelFormat::BINARY1) {
+                if (view.encoding == ImageView::Encoding::PBM1) {
+                    // flip bit order and polarity byte by byte, image rows start zeroed
+                    for (std::size_t i{ 0 }; i < (static_cast<std::size_t>(view.width) + 7) / 8; ++i) {
+                        const auto inverted = static_cast<u8>(~src_row[i]);
+                        u8 byte{ 0 };
+                        for (u32 bit{ 0 }; bit < 8; ++bit) {
+                            byte = static_cast<u8>(byte | (((inverted >> bit) & 1U) << (7U - bit)));
+                        }
+                        dst_row[i] = byte;
+                    }
+                    if (const auto tail = view.width % 8; tail != 0) {
+                        auto& last = dst_row[(view.width - 1) / 8];
+                        last = static_cast<u8>(last & ((1U << tail) - 1U));
+                    }
+                    continue;
+                }
+            } else if constexpr (F == PixelFormat::GRAY8) {
+                if (view.encoding == ImageView::Encoding::GRAY8 && view.max_value == 255) {
+                    std::memcpy(dst_row, src_row, static_cast<std::size_t>(view.width));
+                    continue;
+                }
+            }
+            for (i32 x{ 0 }; x < view.width; ++x) {
+                PixelTraits<F>::storeGray(dst_row, x, view.gray(x, y));
+                if constexpr (F == PixelFormat::RGBA8) {
+                    // alpha isn't written by storeGray
+                    dst_row[4 * x + 3] = 255U;
+                }
+            }
+        }
+    });
+    return image;
+}
@@ -0,0 +1,310 @@
+#include "Minutiae.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+
+#include <spdlog/spdlog.h>
+
+#include "Parallel.hpp"
+
+using namespace bm;
+
+// CN >= 3 pixels this close to each other belong to one junction
+static constexpr i32 JUNCTION_RADIUS{ 2 };
+// side of square marking minutia
+static constexpr i32 MARK_RADIUS{ 3 };
+
+RidgeMap::RidgeMap(const Image& skeleton)
+    : width(skeleton.width)
+    , height(skeleton.height)
+    , stride(skeleton.width + 2)
+    , ridges(static_cast<std::size_t>(stride) * static_cast<std::size_t>(skeleton.height + 2), 0U) {
+    visitFormat(skeleton.format, [&]<PixelFormat F>(FormatTag<F>) {
+        for (i32 y{ 0 }; y < skeleton.height; ++y) {
+            const auto* row = skeleton.row(y);
+            auto* dst = &ridges[static_cast<std::size_t>((y + 1) * stride + 1)];
+            for (i32 x{ 0 }; x < skeleton.width; ++x) {
+                dst[x] = PixelTraits<F>::gray(row, x) < 128U ? 1U : 0U;
+            }
+        }
+    });
+}
+
+i32 RidgeMap::crossingNumber(i32 x, i32 y) const {
+    i32 transitions{ 0 };
+    for (std::size_t i{ 0 }; i < CIRCLE.size(); ++i) {
+        const auto& a = CIRCLE[i];
+        const auto& b = CIRCLE[(i + 1) % CIRCLE.size()];
+        transitions += ridge(x + a[0], y + a[1]) != ridge(x + b[0], y + b[1]) ? 1 : 0;
+    }
+    return transitions / 2;
+}
+
+void SpatialHash::build(const std::vector<Minutia>& minutiae, i32 width, i32 height, i32 cell_size) {
+    this->cell_size = std::max(cell_size, 1);
+    cells_x = std::max((width + this->cell_size - 1) / this->cell_size, 1);
+    cells_y = std::max((height + this->cell_size - 1) / this->cell_size, 1);
+    const auto cellOf = [&](const Minutia& minutia) {
+        const auto x = std::clamp(minutia.x / this->cell_size, 0, cells_x - 1);
+        const auto y = std::clamp(minutia.y / this->cell_size, 0, cells_y - 1);
+        return static_cast<std::size_t>(y * cells_x + x);
+    };
+
+    cell_begin.assign(static_cast<std::size_t>(cells_x) * static_cast<std::size_t>(cells_y) + 1, 0);
+    for (const auto& minutia : minutiae) {
+        ++cell_begin[cellOf(minutia) + 1];
+    }
+    for (std::size_t cell{ 1 }; cell < cell_begin.size(); ++cell) {
+        cell_begin[cell] += cell_begin[cell - 1];
+    }
+    items.assign(minutiae.size(), 0);
+    auto next = cell_begin;
+    for (std::size_t i{ 0 }; i < minutiae.size(); ++i) {
+        items[static_cast<std::size_t>(next[cellOf(minutiae[i])]++)] = static_cast<i32>(i);
+    }
+}
+
+static i32 squaredDistance(const Minutia& a, const Minutia& b) {
+    return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y);
+}
+
+std::vector<Minutia> bm::detectMinutiae(const Image& skeleton) {
+    if (skeleton.width == 0 || skeleton.height == 0) {
+        return {};
+    }
+    const RidgeMap map(skeleton);
+
+    const auto bands = bandsNum(skeleton.height, 64);
+    std::vector<std::vector<Minutia>> found(static_cast<std::size_t>(bands));
+    parallelForBands(bands, skeleton.height, [&](i32 band, i32 begin, i32 end) {
+        auto& out = found[static_cast<std::size_t>(band)];
+        for (auto y{ begin }; y < end; ++y) {
+            for (i32 x{ 0 }; x < skeleton.width; ++x) {
+                if (!map.ridge(x, y)) {
+                    continue;
+                }
+                const auto crossing_number = map.crossingNumber(x, y);
+                if (crossing_number == 1) {
+                    out.push_back({ x, y, Minutia::Type::ENDING });
+                } else if (crossing_number >= 3) {
+                    out.push_back({ x, y, Minutia::Type::BIFURCATION });
+                }
+            }
+        }
+    });
+    std::vector<Minutia> candidates;
+    for (const auto& band : found) {
+        candidates.insert(candidates.end(), band.begin(), band.end());
+    }
+
+    // junction of a skeleton that isn't perfectly thin has several CN >= 3 pixels, first one stands for it
+    SpatialHash hash;
+    hash.build(candidates, skeleton.width, skeleton.height, JUNCTION_RADIUS);
+    std::vector<Minutia> minutiae;
+    for (std::size_t i{ 0 }; i < candidates.size(); ++i) {
+        const auto& minutia = candidates[i];
+        bool duplicate{ false };
+        if (minutia.type == Minutia::Type::BIFURCATION) {
+            hash.forEachNear(minutia.x, minutia.y, JUNCTION_RADIUS, [&](i32 j) {
+                const auto& other = candidates[static_cast<std::size_t>(j)];
+                duplicate = duplicate || (static_cast<std::size_t>(j) < i && other.type == Minutia::Type::BIFURCATION &&
+                    squaredDistance(minutia, other) <= JUNCTION_RADIUS * JUNCTION_RADIUS);
+            });
+        }
+        if (!duplicate) {
+            minutiae.push_back(minutia);
+        }
+    }
+    return minutiae;
+}
+
+namespace {
+
+struct Trace {
+    enum class End : u8 { NONE, JUNCTION, ENDING };
+
+    End end{ End::NONE };
+    i32 x{ 0 };
+    i32 y{ 0 };
+};
+
+}
+
+// Follows ridge from ending for at most max_length pixels. Neighbours of every pixel
+// left behind are marked visited, so 8-connected staircases aren't walked back.
+static Trace traceRidge(const RidgeMap& map, const Minutia& start, i32 max_length, std::vector<std::array<i32, 2>>& visited) {
+    visited.clear();
+    visited.push_back({ start.x, start.y });
+    const auto isVisited = [&](i32 x, i32 y) {
+        return std::find(visited.begin(), visited.end(), std::array<i32, 2>{ x, y }) != visited.end();
+    };
+
+    i32 x{ start.x };
+    i32 y{ start.y };
+    for (i32 length{ 0 }; length < max_length; ++length) {
+        std::array<std::array<i32, 2>, 8> candidates{};
+        std::size_t candidates_num{ 0 };
+        for (i32 v{ -1 }; v <= 1; ++v) {
+            for (i32 u{ -1 }; u <= 1; ++u) {
+                if ((u != 0 || v != 0) && map.ridge(x + u, y + v) && !isVisited(x + u, y + v)) {
+                    candidates[candidates_num++] = { x + u, y + v };
+                }
+            }
+        }
+        if (candidates_num == 0) {
+            // ridge may also just run into pixels already left behind
+            return length > 0 && map.crossingNumber(x, y) == 1 ? Trace{ Trace::End::ENDING, x, y } : Trace{};
+        }
+        for (std::size_t i{ 0 }; i < candidates_num; ++i) {
+            if (map.crossingNumber(candidates[i][0], candidates[i][1]) >= 3) {
+                return { Trace::End::JUNCTION, candidates[i][0], candidates[i][1] };
+            }
+        }
+        // orthogonal step keeps the diagonal one from skipping a pixel of the ridge
+        auto next = candidates[0];
+        for (std::size_t i{ 0 }; i < candidates_num; ++i) {
+            if (candidates[i][0] == x || candidates[i][1] == y) {
+                next = candidates[i];
+                break;
+            }
+        }
+        visited.insert(visited.end(), candidates.begin(), candidates.begin() + static_cast<std::ptrdiff_t>(candidates_num));
+        x = next[0];
+        y = next[1];
+    }
+    return {};
+}
+
+// minutia is within distance of image border or of background block of mask
+static bool nearBorder(const Minutia& minutia, const Image& skeleton, i32 distance, const ForegroundMask* mask) {
+    if (minutia.x < distance || minutia.y < distance ||
+        minutia.x >= skeleton.width - distance || minutia.y >= skeleton.height - distance) {
+        return true;
+    }
+    if (mask == nullptr) {
+        return false;
+    }
+    const auto block_x0 = std::max((minutia.x - distance) / mask->block_size, 0);
+    const auto block_y0 = std::max((minutia.y - distance) / mask->block_size, 0);
+    const auto block_x1 = std::min((minutia.x + distance) / mask->block_size, mask->blocks_x - 1);
+    const auto block_y1 = std::min((minutia.y + distance) / mask->block_size, mask->blocks_y - 1);
+    for (auto block_y{ block_y0 }; block_y <= block_y1; ++block_y) {
+        for (auto block_x{ block_x0 }; block_x <= block_x1; ++block_x) {
+            if (mask->blocks[static_cast<std::size_t>(block_y * mask->blocks_x + block_x)] == 0U) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+std::vector<Minutia> bm::removeFalseMinutiae(const std::vector<Minutia>& minutiae, const Image& skeleton,
+    const MinutiaeFilter& filter, const ForegroundMask* mask, MinutiaeStats& stats) {
+    stats = {};
+    stats.detected = minutiae.size();
+    if (mask != nullptr && !mask->matches(skeleton)) {
+        spdlog::warn("Foreground mask doesn't match skeleton, only image border is used");
+        mask = nullptr;
+    }
+    const RidgeMap map(skeleton);
+    const auto ridge_distance = std::max(filter.ridge_distance, 1.F);
+    SpatialHash hash;
+    hash.build(minutiae, skeleton.width, skeleton.height, static_cast<i32>(std::ceil(ridge_distance)));
+
+    enum Verdict : u8 { KEPT, BORDER, SPUR, PAIR };
+    std::vector<u8> verdicts(minutiae.size(), KEPT);
+    for (std::size_t i{ 0 }; i < minutiae.size(); ++i) {
+        if (nearBorder(minutiae[i], skeleton, filter.border_distance, mask)) {
+            verdicts[i] = BORDER;
+        }
+    }
+
+    // spurs end in junction, short ridges in another ending, both minutiae at the ends are false
+    std::vector<std::array<i32, 2>> visited;
+    for (std::size_t i{ 0 }; i < minutiae.size(); ++i) {
+        const auto& minutia = minutiae[i];
+        if (minutia.type != Minutia::Type::ENDING || verdicts[i] != KEPT) {
+            continue;
+        }
+        const auto trace = traceRidge(map, minutia, filter.max_spur_length, visited);
+        if (trace.end == Trace::End::NONE) {
+            continue;
+        }
+        verdicts[i] = SPUR;
+        const auto end_type = trace.end == Trace::End::JUNCTION ? Minutia::Type::BIFURCATION : Minutia::Type::ENDING;
+        const Minutia end{ trace.x, trace.y, end_type };
+        hash.forEachNear(end.x, end.y, JUNCTION_RADIUS, [&](i32 j) {
+            const auto& other = minutiae[static_cast<std::size_t>(j)];
+            if (other.type == end_type && verdicts[static_cast<std::size_t>(j)] == KEPT &&
+                squaredDistance(end, other) <= JUNCTION_RADIUS * JUNCTION_RADIUS) {
+                verdicts[static_cast<std::size_t>(j)] = SPUR;
+            }
+        });
+    }
+
+    // pairs are judged on verdicts before this pass, so result doesn't depend on order of minutiae
+    const auto before_pairs = verdicts;
+    const auto max_squared = ridge_distance * ridge_distance;
+    const auto radius = static_cast<i32>(std::ceil(ridge_distance));
+    for (std::size_t i{ 0 }; i < minutiae.size(); ++i) {
+        if (before_pairs[i] != KEPT) {
+            continue;
+        }
+        hash.forEachNear(minutiae[i].x, minutiae[i].y, radius, [&](i32 j) {
+            const auto other = static_cast<std::size_t>(j);
+            if (other > i && before_pairs[other] == KEPT &&
+                static_cast<f32>(squaredDistance(minutiae[i], minutiae[other])) < max_squared) {
+                verdicts[i] = PAIR;
+                verdicts[other] = PAIR;
+            }
+        });
+    }
+
+    std::vector<Minutia> kept;
+    for (std::size_t i{ 0 }; i < minutiae.size(); ++i) {
+        switch (verdicts[i]) {
+        case KEPT: kept.push_back(minutiae[i]); break;
+        case BORDER: ++stats.border; break;
+        case SPUR: ++stats.spurs; break;
+        case PAIR: ++stats.pairs; break;
+        default: break;
+        }
+    }
+    return kept;
+}
+
+void bm::drawMinutiae(Image& image, const std::vector<Minutia>& minutiae) {
+    image.convert(PixelFormat::RGBA8);
+    for (const auto& minutia : minutiae) {
+        const Pixel<u8> color = minutia.type == Minutia::Type::ENDING ? Pixel<u8>{ 255U, 0U, 0U } : Pixel<u8>{ 0U, 0U, 255U };
+        for (auto y{ std::max(minutia.y - MARK_RADIUS, 0) }; y <= std::min(minutia.y + MARK_RADIUS, image.height - 1); ++y) {
+            for (auto x{ std::max(minutia.x - MARK_RADIUS, 0) }; x <= std::min(minutia.x + MARK_RADIUS, image.width - 1); ++x) {
+                if (std::abs(x - minutia.x) == MARK_RADIUS || std::abs(y - minutia.y) == MARK_RADIUS) {
+                    PixelTraits<PixelFormat::RGBA8>::store(image.row(y), x, color);
+                }
+            }
+        }
+    }
+}
+
+bool bm::writeMinutiae(const fs::path& path, const std::vector<Minutia>& minutiae, const MinutiaeStats& stats) {
+    std::ofstream stream(path);
+    if (!stream.is_open()) {
+        spdlog::error("Failed to open {} for writing", path.string());
+        return false;
+    }
+    const auto endings = std::count_if(minutiae.begin(), minutiae.end(),
+        [](const Minutia& minutia) { return minutia.type == Minutia::Type::ENDING; });
+    stream << "ridge_ending_points = " << endings << '\n';
+    stream << "bifurcation_points = " << minutiae.size() - static_cast<std::size_t>(endings) << '\n';
+    stream << "detected_points = " << stats.detected << '\n';
+    stream << "removed_border_points = " << stats.border << '\n';
+    stream << "removed_spur_points = " << stats.spurs << '\n';
+    stream << "removed_pair_points = " << stats.pairs << '\n';
+    for (const auto& minutia : minutiae) {
+        stream << (minutia.type == Minutia::Type::ENDING ? "ending " : "bifurcation ") << minutia.x << ' ' << minutia.y << '\n';
+    }
+    return true;
+}
@@ -0,0 +1,272 @@
+#include "Morphology.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "Parallel.hpp"
+
+using namespace bm;
+
+namespace {
+
+// extremum of gray values, the same for 64 binary pixels of word at once
+struct Minimum {
+    static u8 combine(u8 a, u8 b) { return std::min(a, b); }
+    static u64 combine(u64 a, u64 b) { return a & b; }
+    template<typename T>
+    static constexpr T identity() { return static_cast<T>(~T{ 0 }); }
+};
+
+struct Maximum {
+    static u8 combine(u8 a, u8 b) { return std::max(a, b); }
+    static u64 combine(u64 a, u64 b) { return a | b; }
+    template<typename T>
+    static constexpr T identity() { return T{ 0 }; }
+};
+
+}
+
+// van Herk/Gil-Werman over line of values with blocks of window's length: prefix extrema
+// from block start and suffix extrema to block end meet in every window, so
+// out[i] = line[i..i + window - 1] is combine(suffix[i], prefix[i + window - 1]).
+template<typename Op, typename T>
+static void windowExtrema(const T* line, std::size_t length, i32 window, std::vector<T>& prefix, std::vector<T>& suffix) {
+    const auto block = static_cast<std::size_t>(window);
+    prefix.resize(length);
+    suffix.resize(length);
+    for (std::size_t start{ 0 }; start < length; start += block) {
+        const auto end = std::min(start + block, length);
+        prefix[start] = line[start];
+        for (auto i{ start + 1 }; i < end; ++i) {
+            prefix[i] = Op::combine(prefix[i - 1], line[i]);
+        }
+        suffix[end - 1] = line[end - 1];
+        for (auto i{ end - 1 }; i > start; --i) {
+            suffix[i - 1] = Op::combine(suffix[i], line[i - 1]);
+        }
+    }
+}
+
+// Row pass of gray image, channels are separated into padded lines of their own.
+template<typename Op>
+static void grayRows(Image& image, i32 radius) {
+    const auto channels = std::min(image.channels_num, 3);
+    const auto window = 2 * radius + 1;
+    const auto length = static_cast<std::size_t>(image.width + 2 * radius);
+    parallelForBands(bandsNum(image.height, 16), image.height, [&](i32, i32 begin, i32 end) {
+        std::vector<u8> line(length, Op::template identity<u8>());
+        std::vector<u8> prefix;
+        std::vector<u8> suffix;
+        for (auto y{ begin }; y < end; ++y) {
+            auto* row = image.row(y);
+            for (i32 channel{ 0 }; channel < channels; ++channel) {
+                for (i32 x{ 0 }; x < image.width; ++x) {
+                    line[static_cast<std::size_t>(x + radius)] = row[x * image.channels_num + channel];
+                }
+                windowExtrema<Op>(line.data(), length, window, prefix, suffix);
+                for (i32 x{ 0 }; x < image.width; ++x) {
+                    row[x * image.channels_num + channel] =
+                        Op::combine(suffix[static_cast<std::size_t>(x)], prefix[static_cast<std::size_t>(x + window - 1)]);
+                }
+            }
+        }
+    });
+}
+
+// Column pass, whole rows of source are combined element by element (bytes of gray
+// rows or words of binary ones). Band reads rows radius above and below itself.
+template<typename Op, typename T, typename Store>
+static void columns(const std::vector<T>& source, std::size_t row_length, i32 height, i32 radius, Store&& store) {
+    const auto window = 2 * radius + 1;
+    parallelForBands(bandsNum(height, 16), height, [&](i32, i32 begin, i32 end) {
+        const auto first = begin - radius;
+        const auto rows = static_cast<std::size_t>(end - begin + 2 * radius);
+        const auto block = static_cast<std::size_t>(window);
+        std::vector<T> prefix(rows * row_length);
+        std::vector<T> suffix(rows * row_length);
+        const std::vector<T> outside(row_length, Op::template identity<T>());
+        const auto input = [&](std::size_t j) {
+            const auto y = first + static_cast<i32>(j);
+            return y < 0 || y >= height ? outside.data() : source.data() + static_cast<std::size_t>(y) * row_length;
+        };
+
+        for (std::size_t j{ 0 }; j < rows; ++j) {
+            const auto* in = input(j);
+            auto* out = prefix.data() + j * row_length;
+            if (j % block == 0) {
+                std::copy(in, in + row_length, out);
+            } else {
+                const auto* previous = out - row_length;
+                for (std::size_t i{ 0 }; i < row_length; ++i) {
+                    out[i] = Op::combine(previous[i], in[i]);
+                }
+            }
+        }
+        for (auto j{ rows }; j-- > 0;) {
+            const auto* in = input(j);
+            auto* out = suffix.data() + j * row_length;
+            if (j % block == block - 1 || j + 1 == rows) {
+                std::copy(in, in + row_length, out);
+            } else {
+                const auto* next = out + row_length;
+                for (std::size_t i{ 0 }; i < row_length; ++i) {
+                    out[i] = Op::combine(next[i], in[i]);
+                }
+            }
+        }
+
+        std::vector<T> result(row_length);
+        for (auto y{ begin }; y < end; ++y) {
+            const auto j = static_cast<std::size_t>(y - begin);
+            const auto* from = suffix.data() + j * row_length;
+            const auto* to = prefix.data() + (j + static_cast<std::size_t>(window) - 1) * row_length;
+            for (std::size_t i{ 0 }; i < row_length; ++i) {
+                result[i] = Op::combine(from[i], to[i]);
+            }
+            store(y, result.data());
+        }
+    });
+}
+
+template<typename Op>
+static void grayColumns(Image& image, i32 radius) {
+    const auto row_length = image.stride;
+    std::vector<u8> source(row_length * static_cast<std::size_t>(image.height));
+    for (i32 y{ 0 }; y < image.height; ++y) {
+        std::memcpy(source.data() + static_cast<std::size_t>(y) * row_length, image.row(y), row_length);
+    }
+    const auto alpha = image.channels_num == 4;
+    columns<Op>(source, row_length, image.height, radius, [&](i32 y, const u8* result) {
+        auto* row = image.row(y);
+        std::memcpy(row, result, row_length);
+        if (alpha) {
+            const auto* original = source.data() + static_cast<std::size_t>(y) * row_length;
+            for (std::size_t i{ 3 }; i < row_length; i += 4) {
+                row[i] = original[i];
+            }
+        }
+    });
+}
+
+// dst bit x is src bit x + shift, bits from outside of row are identity
+template<typename Op>
+static void shiftBits(const std::vector<u64>& src, std::vector<u64>& dst, i32 shift) {
+    const auto words = static_cast<i32>(src.size());
+    const auto word_shift = (shift >= 0 ? shift : -shift) / 64;
+    const auto bit_shift = (shift >= 0 ? shift : -shift) % 64;
+    const auto at = [&](i32 i) { return i >= 0 && i < words ? src[static_cast<std::size_t>(i)] : Op::template identity<u64>(); };
+    for (i32 i{ 0 }; i < words; ++i) {
+        if (shift >= 0) {
+            const auto low = at(i + word_shift);
+            dst[static_cast<std::size_t>(i)] = bit_shift == 0 ? low : (low >> bit_shift) | (at(i + word_shift + 1) << (64 - bit_shift));
+        } else {
+            const auto high = at(i - word_shift);
+            dst[static_cast<std::size_t>(i)] = bit_shift == 0 ? high : (high << bit_shift) | (at(i - word_shift - 1) >> (64 - bit_shift));
+        }
+    }
+}
+
+// Row pass of binary image. Bits of word can't be split into blocks, window is put
+// together from power of two lengths instead, log2(window) shifts per 64 pixels.
+template<typename Op>
+static void binaryRows(Image& image, i32 radius) {
+    const auto words = image.stride / sizeof(u64);
+    // row is moved radius pixels right into padded words, so window starting at x is centred on x
+    const auto padded = words + static_cast<std::size_t>(radius + 63) / 64 + 1;
+    const auto tail_bits = image.width % 64;
+    const auto tail_mask = tail_bits == 0 ? ~u64{ 0 } : (u64{ 1 } << tail_bits) - 1;
+    const auto window = 2 * radius + 1;
+    parallelForBands(bandsNum(image.height, 16), image.height, [&](i32, i32 begin, i32 end) {
+        std::vector<u64> bits(padded);
+        std::vector<u64> power(padded);
+        std::vector<u64> window_bits(padded);
+        std::vector<u64> shifted(padded);
+        for (auto y{ begin }; y < end; ++y) {
+            auto* row = image.row(y);
+            // bits past width take no part
+            std::fill(bits.begin(), bits.end(), Op::template identity<u64>());
+            std::memcpy(bits.data(), row, words * sizeof(u64));
+            bits[words - 1] = (bits[words - 1] & tail_mask) | (Op::template identity<u64>() & ~tail_mask);
+            shiftBits<Op>(bits, power, -radius);
+
+            // window_bits(x) combines power(x..x + covered - 1), power(x) itself power(x..x + power_length - 1)
+            std::fill(window_bits.begin(), window_bits.end(), Op::template identity<u64>());
+            i32 covered{ 0 };
+            for (i32 power_length{ 1 }; covered < window; power_length *= 2) {
+                if ((window & power_length) != 0) {
+                    shiftBits<Op>(power, shifted, covered);
+                    for (std::size_t i{ 0 }; i < padded; ++i) {
+                        window_bits[i] = Op::combine(window_bits[i], shifted[i]);
+                    }
+                    covered += power_length;
+                }
+                if (covered < window) {
+                    shiftBits<Op>(power, shifted, power_length);
+                    for (std::size_t i{ 0 }; i < padded; ++i) {
+                        power[i] = Op::combine(power[i], shifted[i]);
+                    }
+                }
+            }
+            window_bits[words - 1] &= tail_mask;
+            std::memcpy(row, window_bits.data(), words * sizeof(u64));
+        }
+    });
+}
+
+template<typename Op>
+static void binaryColumns(Image& image, i32 radius) {
+    const auto words = image.stride / sizeof(u64);
+    std::vector<u64> source(words * static_cast<std::size_t>(image.height));
+    for (i32 y{ 0 }; y < image.height; ++y) {
+        std::memcpy(source.data() + static_cast<std::size_t>(y) * words, image.row(y), words * sizeof(u64));
+    }
+    columns<Op>(source, words, image.height, radius, [&](i32 y, const u64* result) {
+        std::memcpy(image.row(y), result, words * sizeof(u64));
+    });
+}
+
+template<typename Op>
+static void extremum(Image& image, StructuringElement element) {
+    const auto binary = image.format == PixelFormat::BINARY1;
+    if (element.radius_x > 0) {
+        binary ? binaryRows<Op>(image, element.radius_x) : grayRows<Op>(image, element.radius_x);
+    }
+    if (element.radius_y > 0) {
+        binary ? binaryColumns<Op>(image, element.radius_y) : grayColumns<Op>(image, element.radius_y);
+    }
+}
+
+const char* bm::morphologyName(MorphologyOperation operation) {
+    switch (operation) {
+    case MorphologyOperation::ERODE: return "Erode";
+    case MorphologyOperation::DILATE: return "Dilate";
+    case MorphologyOperation::OPEN: return "Open";
+    case MorphologyOperation::CLOSE: return "Close";
+    }
+    return "";
+}
+
+void bm::performMorphology(Image& image, MorphologyOperation operation, StructuringElement element) {
+    if (image.width == 0 || image.height == 0) {
+        return;
+    }
+    element.radius_x = std::max(element.radius_x, 0);
+    element.radius_y = std::max(element.radius_y, 0);
+    switch (operation) {
+    case MorphologyOperation::ERODE:
+        extremum<Minimum>(image, element);
+        break;
+    case MorphologyOperation::DILATE:
+        extremum<Maximum>(image, element);
+        break;
+    case MorphologyOperation::OPEN:
+        extremum<Minimum>(image, element);
+        extremum<Maximum>(image, element);
+        break;
+    case MorphologyOperation::CLOSE:
+        extremum<Maximum>(image, element);
+        extremum<Minimum>(image, element);
+        break;
+    }
+}
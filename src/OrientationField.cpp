@@ -0,0 +1,166 @@
+#include "OrientationField.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numbers>
+
+#include "Parallel.hpp"
+
+using namespace bm;
+
+// coherence below this means block holds no ridges worth drawing
+static constexpr f32 MIN_DRAWN_COHERENCE{ .05F };
+
+// doubled-angle sums of gradients, xx_yy is sum of gx^2 - gy^2, xy of 2 gx gy, energy of gx^2 + gy^2
+struct Moments {
+    i64 xx_yy{ 0 };
+    i64 xy{ 0 };
+    i64 energy{ 0 };
+
+    Moments& operator+=(const Moments& other) {
+        xx_yy += other.xx_yy;
+        xy += other.xy;
+        energy += other.energy;
+        return *this;
+    }
+    Moments operator-(const Moments& other) const {
+        return { xx_yy - other.xx_yy, xy - other.xy, energy - other.energy };
+    }
+    Moments operator+(const Moments& other) const {
+        return { xx_yy + other.xx_yy, xy + other.xy, energy + other.energy };
+    }
+};
+
+// gray row with edge pixel repeated on both sides, so x - 1 and x + 1 are always valid
+template<PixelFormat F>
+static void loadPaddedRow(const Image& image, i32 y, std::vector<i32>& out) {
+    const auto* row = image.row(std::clamp(y, 0, image.height - 1));
+    for (i32 x{ 0 }; x < image.width; ++x) {
+        out[static_cast<std::size_t>(x + 1)] = PixelTraits<F>::gray(row, x);
+    }
+    out.front() = out[1];
+    out.back() = out[static_cast<std::size_t>(image.width)];
+}
+
+void OrientationField::compute(const Image& image, i32 block_size, i32 smoothing_radius) {
+    this->block_size = std::max(block_size, 1);
+    blocks_x = (image.width + this->block_size - 1) / this->block_size;
+    blocks_y = (image.height + this->block_size - 1) / this->block_size;
+    const auto blocks_num = static_cast<std::size_t>(blocks_x) * static_cast<std::size_t>(blocks_y);
+    std::vector<Moments> blocks(blocks_num);
+
+    // bands are whole block rows so every block is summed by one thread only
+    parallelForBands(bandsNum(blocks_y, 1), blocks_y, [&](i32, i32 block_row_begin, i32 block_row_end) {
+        visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+            const auto padded_width = static_cast<std::size_t>(image.width + 2);
+            std::array<std::vector<i32>, 3> rows;
+            for (auto& row : rows) {
+                row.resize(padded_width);
+            }
+            std::vector<i32> xx_yy(static_cast<std::size_t>(image.width));
+            std::vector<i32> xy(static_cast<std::size_t>(image.width));
+            std::vector<i32> energy(static_cast<std::size_t>(image.width));
+
+            const auto y_begin = block_row_begin * this->block_size;
+            const auto y_end = std::min(block_row_end * this->block_size, image.height);
+            loadPaddedRow<F>(image, y_begin - 1, rows[0]);
+            loadPaddedRow<F>(image, y_begin, rows[1]);
+            for (i32 y{ y_begin }; y < y_end; ++y) {
+                auto& up = rows[static_cast<std::size_t>((y - y_begin) % 3)];
+                auto& mid = rows[static_cast<std::size_t>((y - y_begin + 1) % 3)];
+                auto& down = rows[static_cast<std::size_t>((y - y_begin + 2) % 3)];
+                loadPaddedRow<F>(image, y + 1, down);
+
+                // Sobel and its doubled-angle products fused into one branch free loop
+                const auto* u = up.data();
+                const auto* m = mid.data();
+                const auto* d = down.data();
+                for (i32 x{ 0 }; x < image.width; ++x) {
+                    const auto gx = (u[x + 2] + 2 * m[x + 2] + d[x + 2]) - (u[x] + 2 * m[x] + d[x]);
+                    const auto gy = (d[x] + 2 * d[x + 1] + d[x + 2]) - (u[x] + 2 * u[x + 1] + u[x + 2]);
+                    xx_yy[static_cast<std::size_t>(x)] = gx * gx - gy * gy;
+                    xy[static_cast<std::size_t>(x)] = 2 * gx * gy;
+                    energy[static_cast<std::size_t>(x)] = gx * gx + gy * gy;
+                }
+
+                auto* block_row = &blocks[index(0, y / this->block_size)];
+                for (i32 block_x{ 0 }; block_x < blocks_x; ++block_x) {
+                    const auto x_end = std::min((block_x + 1) * this->block_size, image.width);
+                    Moments sum;
+                    for (auto x{ block_x * this->block_size }; x < x_end; ++x) {
+                        sum.xx_yy += xx_yy[static_cast<std::size_t>(x)];
+                        sum.xy += xy[static_cast<std::size_t>(x)];
+                        sum.energy += energy[static_cast<std::size_t>(x)];
+                    }
+                    block_row[block_x] += sum;
+                }
+            }
+        });
+    });
+
+    // integral[(y + 1) * (blocks_x + 1) + x + 1] is sum of blocks [0, x] x [0, y]
+    const auto integral_width = static_cast<std::size_t>(blocks_x + 1);
+    std::vector<Moments> integral(integral_width * static_cast<std::size_t>(blocks_y + 1));
+    for (i32 block_y{ 0 }; block_y < blocks_y; ++block_y) {
+        Moments row_sum;
+        for (i32 block_x{ 0 }; block_x < blocks_x; ++block_x) {
+            row_sum += blocks[index(block_x, block_y)];
+            const auto at = static_cast<std::size_t>(block_y + 1) * integral_width + static_cast<std::size_t>(block_x + 1);
+            integral[at] = integral[at - integral_width] + row_sum;
+        }
+    }
+
+    smoothing_radius = std::max(smoothing_radius, 0);
+    orientation.resize(blocks_num);
+    coherence.resize(blocks_num);
+    for (i32 block_y{ 0 }; block_y < blocks_y; ++block_y) {
+        const auto top = static_cast<std::size_t>(std::max(block_y - smoothing_radius, 0));
+        const auto bottom = static_cast<std::size_t>(std::min(block_y + smoothing_radius + 1, blocks_y));
+        for (i32 block_x{ 0 }; block_x < blocks_x; ++block_x) {
+            const auto left = static_cast<std::size_t>(std::max(block_x - smoothing_radius, 0));
+            const auto right = static_cast<std::size_t>(std::min(block_x + smoothing_radius + 1, blocks_x));
+            const auto sum =
+                integral[bottom * integral_width + right] - integral[top * integral_width + right] -
+                integral[bottom * integral_width + left] + integral[top * integral_width + left];
+
+            // averaged vector points along gradient (doubled), ridges run perpendicular to it
+            const auto xx_yy = static_cast<f64>(sum.xx_yy);
+            const auto xy = static_cast<f64>(sum.xy);
+            auto angle = .5 * std::atan2(xy, xx_yy) + .5 * std::numbers::pi;
+            if (angle >= std::numbers::pi) {
+                angle -= std::numbers::pi;
+            }
+            orientation[index(block_x, block_y)] = static_cast<f32>(angle);
+            coherence[index(block_x, block_y)] = sum.energy > 0 ?
+                static_cast<f32>(std::hypot(xx_yy, xy) / static_cast<f64>(sum.energy)) : 0.F;
+        }
+    }
+}
+
+void bm::drawOrientationField(Image& image, const OrientationField& field) {
+    image.convert(PixelFormat::RGBA8);
+    const Pixel<u8> color{ 255U, 0U, 0U };
+    const auto half_length = .4F * static_cast<f32>(field.block_size);
+    for (i32 block_y{ 0 }; block_y < field.blocks_y; ++block_y) {
+        for (i32 block_x{ 0 }; block_x < field.blocks_x; ++block_x) {
+            if (field.coherence[field.index(block_x, block_y)] < MIN_DRAWN_COHERENCE) {
+                continue;
+            }
+            const auto angle = field.orientation[field.index(block_x, block_y)];
+            const auto dx = std::cos(angle);
+            const auto dy = std::sin(angle);
+            const auto centre_x = (static_cast<f32>(block_x) + .5F) * static_cast<f32>(field.block_size);
+            const auto centre_y = (static_cast<f32>(block_y) + .5F) * static_cast<f32>(field.block_size);
+            const auto steps = static_cast<i32>(std::ceil(2.F * half_length));
+            for (i32 step{ 0 }; step <= steps; ++step) {
+                const auto t = -half_length + static_cast<f32>(step);
+                const auto x = static_cast<i32>(std::lround(centre_x + t * dx));
+                const auto y = static_cast<i32>(std::lround(centre_y + t * dy));
+                if (x >= 0 && x < image.width && y >= 0 && y < image.height) {
+                    PixelTraits<PixelFormat::RGBA8>::store(image.row(y), x, color);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,280 @@
+#include "PixelBuffer.hpp"
+
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+using namespace bm;
+
+namespace {
+
+struct BlockHeader {
+    std::size_t class_index;
+    std::size_t capacity;
+};
+static_assert(sizeof(BlockHeader) <= PixelPool::ALIGNMENT);
+
+constexpr std::size_t UNPOOLED{ lim<std::size_t>::max() };
+
+BlockHeader* headerOf(const void* ptr) {
+    return reinterpret_cast<BlockHeader*>(const_cast<u8*>(static_cast<const u8*>(ptr) - PixelPool::ALIGNMENT)); // NOLINT
+}
+
+void* blockData(void* block) {
+    return static_cast<u8*>(block) + PixelPool::ALIGNMENT;
+}
+
+std::size_t roundUp(std::size_t value, std::size_t multiple) {
+    return ((value + multiple - 1) / multiple) * multiple;
+}
+
+}
+
+PixelPool& PixelPool::instance() {
+    static PixelPool pool;
+    return pool;
+}
+
+void* PixelPool::allocate(std::size_t size) {
+    const auto total = size + ALIGNMENT;
+
+    auto class_log2 = static_cast<std::size_t>(std::bit_width(total - 1));
+    if (class_log2 < MIN_CLASS_LOG2 || class_log2 - MIN_CLASS_LOG2 >= CLASSES_NUM) {
+        const auto block_size = roundUp(total, ALIGNMENT);
+        void* block = std::aligned_alloc(ALIGNMENT, block_size);
+        if (block == nullptr) {
+            return nullptr;
+        }
+        *static_cast<BlockHeader*>(block) = BlockHeader{ UNPOOLED, block_size - ALIGNMENT };
+        return blockData(block);
+    }
+
+    const auto class_index = class_log2 - MIN_CLASS_LOG2;
+    const auto block_size = std::size_t{ 1 } << class_log2;
+    void* block = nullptr;
+    {
+        std::lock_guard lock(mutex);
+        auto& blocks = free_blocks[class_index];
+        if (!blocks.empty()) {
+            block = blocks.back();
+            blocks.pop_back();
+            retained_bytes -= block_size;
+        }
+    }
+    if (block == nullptr) {
+        block = std::aligned_alloc(ALIGNMENT, block_size);
+        if (block == nullptr) {
+            return nullptr;
+        }
+    }
+    *static_cast<BlockHeader*>(block) = BlockHeader{ class_index, block_size - ALIGNMENT };
+    return blockData(block);
+}
+
+void* PixelPool::reallocate(void* ptr, std::size_t size) {
+    if (ptr == nullptr) {
+        return allocate(size);
+    }
+    const auto old_capacity = capacity(ptr);
+    if (size <= old_capacity) {
+        return ptr;
+    }
+    void* new_ptr = allocate(size);
+    if (new_ptr != nullptr) {
+        std::memcpy(new_ptr, ptr, old_capacity);
+        release(ptr);
+    }
+    return new_ptr;
+}
+
+void PixelPool::release(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    auto* header = headerOf(ptr);
+    void* block = header;
+    if (header->class_index == UNPOOLED) {
+        std::free(block);
+        return;
+    }
+
+    const auto block_size = header->capacity + ALIGNMENT;
+    {
+        std::lock_guard lock(mutex);
+        if (retained_bytes + block_size <= max_retained_bytes) {
+            free_blocks[header->class_index].push_back(block);
+            retained_bytes += block_size;
+            return;
+        }
+    }
+    std::free(block);
+}
+
+std::size_t PixelPool::capacity(const void* ptr) {
+    return headerOf(ptr)->capacity;
+}
+
+void PixelPool::trim(std::size_t max_retained_bytes) {
+    std::lock_guard lock(mutex);
+    this->max_retained_bytes = max_retained_bytes;
+    // largest blocks go first
+    for (auto class_index = CLASSES_NUM; class_index-- > 0 && retained_bytes > max_retained_bytes;) {
+        auto& blocks = free_blocks[class_index];
+        const auto block_size = std::size_t{ 1 } << (class_index + MIN_CLASS_LOG2);
+        while (!blocks.empty() && retained_bytes > max_retained_bytes) {
+            std::free(blocks.back());
+            blocks.pop_back();
+            retained_bytes -= block_size;
+        }
+    }
+}
+
+PixelPool::~PixelPool() {
+    trim(0);
+}
+
+void* bm::pixelPoolMalloc(std::size_t size) {
+    return PixelPool::instance().allocate(size);
+}
+void* bm::pixelPoolRealloc(void* ptr, std::size_t size) {
+    return PixelPool::instance().reallocate(ptr, size);
+}
+void bm::pixelPoolFree(void* ptr) {
+    PixelPool::instance().release(ptr);
+}
+
+PixelBuffer::PixelBuffer(const PixelBuffer& other) {
+    if (other.shared()) {
+        *this = share(other.shared_, other.size_);
+        return;
+    }
+    resize(other.size_);
+    if (size_ > 0) {
+        std::memcpy(data_, other.data_, size_);
+    }
+}
+
+PixelBuffer::PixelBuffer(PixelBuffer&& other) noexcept
+    : data_(other.data_), size_(other.size_), capacity_(other.capacity_), deleter_(other.deleter_)
+    , shared_(std::move(other.shared_)), shared_flag_(other.shared()) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.capacity_ = 0;
+    other.deleter_ = nullptr;
+    other.shared_flag_.store(false, std::memory_order_release);
+}
+
+PixelBuffer& PixelBuffer::operator=(const PixelBuffer& other) {
+    if (this != &other) {
+        if (other.shared()) {
+            return *this = share(other.shared_, other.size_);
+        }
+        // same sized images reuse current block
+        resize(other.size_);
+        if (size_ > 0) {
+            std::memcpy(data_, other.data_, size_);
+        }
+    }
+    return *this;
+}
+
+PixelBuffer& PixelBuffer::operator=(PixelBuffer&& other) noexcept {
+    if (this != &other) {
+        reset();
+        data_ = other.data_;
+        size_ = other.size_;
+        capacity_ = other.capacity_;
+        deleter_ = other.deleter_;
+        shared_ = std::move(other.shared_);
+        shared_flag_.store(other.shared(), std::memory_order_release);
+        other.data_ = nullptr;
+        other.size_ = 0;
+        other.capacity_ = 0;
+        other.deleter_ = nullptr;
+        other.shared_flag_.store(false, std::memory_order_release);
+    }
+    return *this;
+}
+
+PixelBuffer::~PixelBuffer() {
+    reset();
+}
+
+PixelBuffer PixelBuffer::adopt(u8* data, std::size_t size, Deleter deleter) {
+    PixelBuffer buffer;
+    buffer.data_ = data;
+    buffer.size_ = size;
+    buffer.capacity_ = deleter == pixelPoolFree ? PixelPool::capacity(data) : size;
+    buffer.deleter_ = deleter;
+    return buffer;
+}
+
+PixelBuffer PixelBuffer::share(std::shared_ptr<const u8> data, std::size_t size) {
+    PixelBuffer buffer;
+    if (data == nullptr || size == 0) {
+        return buffer;
+    }
+    // never written through while shared, mutable accessors copy first
+    buffer.data_ = const_cast<u8*>(data.get()); // NOLINT
+    buffer.size_ = size;
+    buffer.capacity_ = size;
+    buffer.shared_ = std::move(data);
+    buffer.shared_flag_.store(true, std::memory_order_release);
+    return buffer;
+}
+
+void PixelBuffer::copyShared() {
+    // first rows of parallel bands can be requested at once, only one of them copies
+    static std::mutex copy_mutex;
+    std::lock_guard lock(copy_mutex);
+    if (!shared_flag_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    auto* copy = static_cast<u8*>(pixelPoolMalloc(size_));
+    if (copy == nullptr) {
+        throw std::bad_alloc();
+    }
+    std::memcpy(copy, data_, size_);
+    data_ = copy;
+    capacity_ = PixelPool::capacity(copy);
+    deleter_ = pixelPoolFree;
+    shared_.reset();
+    shared_flag_.store(false, std::memory_order_release);
+}
+
+void PixelBuffer::resize(std::size_t size) {
+    if (shared()) {
+        // shrinking keeps contents, so shared pixels are copied, growing drops them
+        if (size <= size_) {
+            copyShared();
+        } else {
+            reset();
+        }
+    }
+    if (size <= capacity_) {
+        size_ = size;
+        return;
+    }
+    reset();
+    data_ = static_cast<u8*>(pixelPoolMalloc(size));
+    if (data_ == nullptr) {
+        throw std::bad_alloc();
+    }
+    size_ = size;
+    capacity_ = PixelPool::capacity(data_);
+    deleter_ = pixelPoolFree;
+}
+
+void PixelBuffer::reset() {
+    if (data_ != nullptr && deleter_ != nullptr) {
+        deleter_(data_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    capacity_ = 0;
+    deleter_ = nullptr;
+    shared_.reset();
+    shared_flag_.store(false, std::memory_order_release);
+}
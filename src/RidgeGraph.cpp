@@ -0,0 +1,328 @@
+#include "RidgeGraph.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <spdlog/spdlog.h>
+
+using namespace bm;
+
+// node pixels are labeled with node index, others with one of these
+static constexpr i32 NOT_RIDGE{ -1 };
+static constexpr i32 UNVISITED{ -2 };
+static constexpr i32 VISITED{ -3 };
+// pixel of 8-connected corner stepped around, tracer falls back to it at dead ends
+static constexpr i32 CORNER{ -4 };
+// shorter walks ending in their own node only went around a corner of it
+static constexpr i32 MIN_LOOP_LENGTH{ 3 };
+
+// Labels junctions (8-connected groups of CN >= 3 pixels) and endings as nodes.
+static void labelNodes(const RidgeMap& map, std::vector<i32>& labels, std::vector<RidgeGraph::Node>& nodes) {
+    std::vector<std::array<i32, 2>> pending;
+    for (i32 y{ 0 }; y < map.height; ++y) {
+        for (i32 x{ 0 }; x < map.width; ++x) {
+            if (!map.ridge(x, y) || labels[map.index(x, y)] != UNVISITED) {
+                continue;
+            }
+            const auto crossing_number = map.crossingNumber(x, y);
+            if (crossing_number == 1) {
+                labels[map.index(x, y)] = static_cast<i32>(nodes.size());
+                nodes.push_back({ x, y, RidgeGraph::Node::Type::ENDING, 0 });
+            } else if (crossing_number >= 3) {
+                const auto node = static_cast<i32>(nodes.size());
+                nodes.push_back({ x, y, RidgeGraph::Node::Type::BIFURCATION, 0 });
+                labels[map.index(x, y)] = node;
+                pending.push_back({ x, y });
+                while (!pending.empty()) {
+                    const auto [px, py] = pending.back();
+                    pending.pop_back();
+                    for (const auto [dx, dy] : RidgeMap::CIRCLE) {
+                        const auto nx = px + dx;
+                        const auto ny = py + dy;
+                        if (map.ridge(nx, ny) && labels[map.index(nx, ny)] == UNVISITED && map.crossingNumber(nx, ny) >= 3) {
+                            labels[map.index(nx, ny)] = node;
+                            pending.push_back({ nx, ny });
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+namespace {
+
+// Follows ridges from node pixels and appends them as edges
+struct Tracer {
+    const RidgeMap& map;
+    std::vector<i32>& labels;
+    RidgeGraph& graph;
+
+    [[nodiscard]] i32& label(i32 x, i32 y, std::size_t code) const {
+        return labels[map.index(x + RidgeMap::CIRCLE[code][0], y + RidgeMap::CIRCLE[code][1])];
+    }
+
+    // Neighbours of node pixel that are adjacent in circular order belong to one ridge,
+    // every such run starts one edge from its orthogonal pixel, the rest are corners.
+    void traceFrom(i32 node, i32 x, i32 y) {
+        std::array<bool, 8> free{};
+        for (std::size_t i{ 0 }; i < free.size(); ++i) {
+            free[i] = label(x, y, i) == UNVISITED;
+        }
+        // run covering all neighbours is started at index 0, others at their first pixel
+        const auto all_free = std::all_of(free.begin(), free.end(), [](bool value) { return value; });
+        for (std::size_t i{ 0 }; i < free.size(); ++i) {
+            const auto previous = (i + free.size() - 1) % free.size();
+            if (!free[i] || (free[previous] && !(all_free && i == 0))) {
+                continue;
+            }
+            std::size_t run_length{ 1 };
+            while (run_length < free.size() && free[(i + run_length) % free.size()]) {
+                ++run_length;
+            }
+            auto start = i;
+            for (std::size_t k{ 0 }; k < run_length; ++k) {
+                if ((i + k) % 2 == 0) {
+                    start = (i + k) % free.size();
+                    break;
+                }
+            }
+            // earlier edge of this node may have come back through the run already
+            if (label(x, y, start) != UNVISITED) {
+                continue;
+            }
+            for (std::size_t k{ 0 }; k < run_length; ++k) {
+                auto& neighbour = label(x, y, (i + k) % free.size());
+                if ((i + k) % free.size() != start && neighbour == UNVISITED) {
+                    neighbour = CORNER;
+                }
+            }
+            traceEdge(node, x, y, static_cast<u8>(start));
+        }
+
+        // ending right next to another node has no pixels of its own to trace
+        auto& current = graph.nodes[static_cast<std::size_t>(node)];
+        if (current.type != RidgeGraph::Node::Type::ENDING || current.degree > 0) {
+            return;
+        }
+        for (std::size_t i{ 0 }; i < RidgeMap::CIRCLE.size(); ++i) {
+            const auto other = label(x, y, i);
+            if (other >= 0 && other != node &&
+                (graph.nodes[static_cast<std::size_t>(other)].type != RidgeGraph::Node::Type::ENDING || other > node)) {
+                addEdge({ node, other, x, y, graph.codes.size(), 1 });
+                graph.codes.push_back(static_cast<u8>(i));
+                return;
+            }
+        }
+    }
+
+    // neighbour has untraced ridge pixel or node next to it that isn't next to (x, y) too
+    [[nodiscard]] bool leadsOn(i32 x, i32 y, std::size_t code) const {
+        const auto nx = x + RidgeMap::CIRCLE[code][0];
+        const auto ny = y + RidgeMap::CIRCLE[code][1];
+        for (const auto [dx, dy] : RidgeMap::CIRCLE) {
+            if (std::abs(nx + dx - x) <= 1 && std::abs(ny + dy - y) <= 1) {
+                continue;
+            }
+            const auto beyond = labels[map.index(nx + dx, ny + dy)];
+            if (beyond == UNVISITED || beyond >= 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    [[nodiscard]] static i32 codeOf(i32 dx, i32 dy) {
+        return static_cast<i32>(std::find(RidgeMap::CIRCLE.begin(), RidgeMap::CIRCLE.end(), std::array<i32, 2>{ dx, dy }) -
+            RidgeMap::CIRCLE.begin());
+    }
+
+    // Diagonal step into node cuts pixel next to both, which then wouldn't start an edge of its
+    // own. Pixels in other runs around the node pixel are its other ridges and are left alone.
+    void cutIntoNode(i32 x, i32 y, u8 code) {
+        const auto nx = x + RidgeMap::CIRCLE[code][0];
+        const auto ny = y + RidgeMap::CIRCLE[code][1];
+        const auto from = codeOf(x - nx, y - ny);
+        for (std::size_t i{ 0 }; i < RidgeMap::CIRCLE.size(); ++i) {
+            const auto px = x + RidgeMap::CIRCLE[i][0];
+            const auto py = y + RidgeMap::CIRCLE[i][1];
+            if (labels[map.index(px, py)] != UNVISITED || std::abs(px - nx) > 1 || std::abs(py - ny) > 1) {
+                continue;
+            }
+            const auto distance = std::abs(codeOf(px - nx, py - ny) - from);
+            if (distance == 1 || distance == 7) {
+                labels[map.index(px, py)] = CORNER;
+            }
+        }
+    }
+
+    void traceEdge(i32 node, i32 x, i32 y, u8 first_code) {
+        RidgeGraph::Edge edge{ node, -1, x, y, graph.codes.size(), 0 };
+        auto code = first_code;
+        auto cx = x;
+        auto cy = y;
+        for (;;) {
+            graph.codes.push_back(code);
+            ++edge.chain_length;
+            cx += RidgeMap::CIRCLE[code][0];
+            cy += RidgeMap::CIRCLE[code][1];
+            auto& current = labels[map.index(cx, cy)];
+            if (current >= 0) {
+                edge.to = current;
+                break;
+            }
+            current = VISITED;
+
+            // junction ends the edge, ending only if ridge doesn't go on past it (one pixel spur),
+            // otherwise ridge goes on through the best ranked pixel and neighbours it cuts are corners
+            i32 next_node{ -1 };
+            i32 next_ending{ -1 };
+            i32 next{ -1 };
+            i32 next_rank{ -1 };
+            i32 corner{ -1 };
+            i32 corner_rank{ -1 };
+            for (std::size_t i{ 0 }; i < RidgeMap::CIRCLE.size(); ++i) {
+                const auto neighbour = label(cx, cy, i);
+                const auto orthogonal = i % 2 == 0;
+                if (neighbour >= 0) {
+                    const auto too_short_loop = neighbour == node && edge.chain_length < MIN_LOOP_LENGTH;
+                    auto& chosen = graph.nodes[static_cast<std::size_t>(neighbour)].type == RidgeGraph::Node::Type::ENDING ?
+                        next_ending : next_node;
+                    if (!too_short_loop && (chosen < 0 || orthogonal)) {
+                        chosen = static_cast<i32>(i);
+                    }
+                } else if (neighbour == UNVISITED || neighbour == CORNER) {
+                    // step leading on past current pixel's neighbourhood wins, then orthogonal one
+                    const auto rank = (leadsOn(cx, cy, i) ? 2 : 0) + (orthogonal ? 1 : 0);
+                    auto& chosen = neighbour == UNVISITED ? next : corner;
+                    auto& chosen_rank = neighbour == UNVISITED ? next_rank : corner_rank;
+                    if (rank > chosen_rank) {
+                        chosen = static_cast<i32>(i);
+                        chosen_rank = rank;
+                    }
+                }
+            }
+            if (next_node >= 0 || (next < 0 && next_ending >= 0)) {
+                code = static_cast<u8>(next_node >= 0 ? next_node : next_ending);
+                cutIntoNode(cx, cy, code);
+                continue;
+            }
+            if (next < 0) {
+                next = corner;
+            }
+            if (next < 0) {
+                // ridge ran into pixels of another edge, last pixel becomes ending
+                graph.nodes.push_back({ cx, cy, RidgeGraph::Node::Type::ENDING, 0 });
+                edge.to = static_cast<i32>(graph.nodes.size() - 1);
+                current = edge.to;
+                break;
+            }
+            // only neighbours touching the next pixel are corners of this ridge, others may start another one
+            const auto& step = RidgeMap::CIRCLE[static_cast<std::size_t>(next)];
+            for (std::size_t i{ 0 }; i < RidgeMap::CIRCLE.size(); ++i) {
+                const auto& other = RidgeMap::CIRCLE[i];
+                if (static_cast<i32>(i) != next && label(cx, cy, i) == UNVISITED &&
+                    std::abs(other[0] - step[0]) <= 1 && std::abs(other[1] - step[1]) <= 1) {
+                    label(cx, cy, i) = CORNER;
+                }
+            }
+            code = static_cast<u8>(next);
+        }
+        addEdge(edge);
+    }
+
+    void addEdge(const RidgeGraph::Edge& edge) {
+        ++graph.nodes[static_cast<std::size_t>(edge.from)].degree;
+        ++graph.nodes[static_cast<std::size_t>(edge.to)].degree;
+        graph.edges.push_back(edge);
+    }
+};
+
+}
+
+void RidgeGraph::build(const Image& skeleton) {
+    nodes.clear();
+    edges.clear();
+    codes.clear();
+    width = skeleton.width;
+    height = skeleton.height;
+    const RidgeMap map(skeleton);
+    std::vector<i32> labels(map.ridges.size(), NOT_RIDGE);
+    for (std::size_t i{ 0 }; i < labels.size(); ++i) {
+        labels[i] = map.ridges[i] != 0U ? UNVISITED : NOT_RIDGE;
+    }
+    labelNodes(map, labels, nodes);
+
+    Tracer tracer{ map, labels, *this };
+    for (i32 y{ 0 }; y < map.height; ++y) {
+        for (i32 x{ 0 }; x < map.width; ++x) {
+            const auto label = labels[map.index(x, y)];
+            if (label >= 0) {
+                tracer.traceFrom(label, x, y);
+            }
+        }
+    }
+    // what is left are closed ridges, pixel where one is met becomes its node
+    for (i32 y{ 0 }; y < map.height; ++y) {
+        for (i32 x{ 0 }; x < map.width; ++x) {
+            if (labels[map.index(x, y)] == UNVISITED && map.crossingNumber(x, y) == 2) {
+                const auto node = static_cast<i32>(nodes.size());
+                nodes.push_back({ x, y, Node::Type::LOOP, 0 });
+                labels[map.index(x, y)] = node;
+                tracer.traceFrom(node, x, y);
+            }
+        }
+    }
+}
+
+std::vector<std::array<i32, 2>> RidgeGraph::polyline(const Edge& edge) const {
+    std::vector<std::array<i32, 2>> points;
+    points.reserve(static_cast<std::size_t>(edge.chain_length) + 1);
+    points.push_back({ edge.x, edge.y });
+    for (i32 i{ 0 }; i < edge.chain_length; ++i) {
+        const auto& step = RidgeMap::CIRCLE[codes[edge.chain_begin + static_cast<std::size_t>(i)]];
+        points.push_back({ points.back()[0] + step[0], points.back()[1] + step[1] });
+    }
+    return points;
+}
+
+f32 RidgeGraph::length(const Edge& edge) const {
+    const auto first = codes.begin() + static_cast<std::ptrdiff_t>(edge.chain_begin);
+    const auto diagonal = std::count_if(first, first + edge.chain_length, [](u8 code) { return code % 2 != 0; });
+    return static_cast<f32>(edge.chain_length - diagonal) + std::sqrt(2.F) * static_cast<f32>(diagonal);
+}
+
+std::size_t RidgeGraph::bytes() const {
+    return nodes.size() * sizeof(Node) + edges.size() * sizeof(Edge) + codes.size() * sizeof(u8);
+}
+
+void bm::drawRidgeGraph(Image& image, const RidgeGraph& graph) {
+    if (image.width != graph.width || image.height != graph.height) {
+        spdlog::error("Ridge graph traced on {}x{} image can't be drawn into {}x{} one",
+            graph.width, graph.height, image.width, image.height);
+        return;
+    }
+    image.convert(PixelFormat::RGBA8);
+    // hue steps by golden angle, so neighbouring edges get distinct colors
+    f32 hue{ 0.F };
+    for (const auto& edge : graph.edges) {
+        hue = std::fmod(hue + 137.508F, 360.F);
+        const auto sector = hue / 60.F;
+        const auto fall = static_cast<u8>(255.F * (1.F - std::abs(std::fmod(sector, 2.F) - 1.F)));
+        static constexpr std::array<std::array<i32, 3>, 6> ORDER{{ { 0, 1, 2 }, { 1, 0, 2 }, { 2, 0, 1 }, { 2, 1, 0 }, { 1, 2, 0 }, { 0, 2, 1 } }};
+        const auto& order = ORDER[static_cast<std::size_t>(sector) % ORDER.size()];
+        std::array<u8, 3> channels{};
+        channels[static_cast<std::size_t>(order[0])] = 255U;
+        channels[static_cast<std::size_t>(order[1])] = fall;
+        const Pixel<u8> color{ channels[0], channels[1], channels[2] };
+        const auto points = graph.polyline(edge);
+        // end pixels belong to nodes
+        for (std::size_t i{ 1 }; i + 1 < points.size(); ++i) {
+            PixelTraits<PixelFormat::RGBA8>::store(image.row(points[i][1]), points[i][0], color);
+        }
+    }
+    for (const auto& node : graph.nodes) {
+        const Pixel<u8> color = node.type == RidgeGraph::Node::Type::BIFURCATION ? Pixel<u8>{ 0U, 0U, 0U } : Pixel<u8>{ 128U, 128U, 128U };
+        PixelTraits<PixelFormat::RGBA8>::store(image.row(node.y), node.x, color);
+    }
+}
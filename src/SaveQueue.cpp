@@ -0,0 +1,72 @@
+#include "SaveQueue.hpp"
+
+#include <memory>
+
+using namespace bm;
+
+SaveQueue::SaveQueue(std::size_t workers_num, std::size_t max_in_flight)
+    : max_in_flight(std::max(max_in_flight, std::size_t{ 1 })), workers(workers_num) {}
+
+void SaveQueue::submit(Image image, fs::path path, SaveOptions options, Callback callback) {
+    {
+        std::unique_lock lock(mutex);
+        cv.wait(lock, [this] { return in_flight < max_in_flight; });
+        ++in_flight;
+    }
+    enqueue(std::move(image), std::move(path), options, std::move(callback));
+}
+
+bool SaveQueue::trySubmit(const Image& image, fs::path path, SaveOptions options, Callback callback) {
+    {
+        std::lock_guard lock(mutex);
+        if (in_flight >= max_in_flight) {
+            return false;
+        }
+        ++in_flight;
+    }
+    enqueue(Image(image), std::move(path), options, std::move(callback));
+    return true;
+}
+
+void SaveQueue::enqueue(Image&& image, fs::path&& path, SaveOptions options, Callback&& callback) {
+    // std::function needs copyable callables, job is shared instead of moved in
+    auto job = std::make_shared<Completion>(Completion{ std::move(path), false, std::move(callback) });
+    auto job_image = std::make_shared<Image>(std::move(image));
+    workers.submit([this, job, job_image, options] {
+        job->success = job_image->save(job->path, options);
+        job_image->pixels.reset();
+        {
+            std::lock_guard lock(mutex);
+            completions.push_back(std::move(*job));
+            --in_flight;
+        }
+        cv.notify_all();
+    });
+}
+
+std::size_t SaveQueue::poll() {
+    std::deque<Completion> finished;
+    {
+        std::lock_guard lock(mutex);
+        finished.swap(completions);
+    }
+    for (auto& completion : finished) {
+        if (completion.callback) {
+            completion.callback(completion.path, completion.success);
+        }
+    }
+    return finished.size();
+}
+
+void SaveQueue::wait() {
+    {
+        std::unique_lock lock(mutex);
+        cv.wait(lock, [this] { return in_flight == 0; });
+    }
+    poll();
+}
+
+std::size_t SaveQueue::pending() {
+    std::lock_guard lock(mutex);
+    return in_flight;
+}
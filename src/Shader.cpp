@@ -1,25 +1,19 @@
 #include "Shader.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <exception>
 #include <fstream>
+#include <sstream>
 
 #include <spdlog/spdlog.h>
 #include <glad/glad.h>
 
-using namespace bm;
+#include "Hash.hpp"
 
-Shader::Shader(Type type, const std::vector<std::filesystem::path>& paths) : type_(type) {
-    int ext_num{0};
-    bool is_arb_spirv_supported{false};
-    glGetIntegerv(GL_NUM_EXTENSIONS, &ext_num);
-    for (int i{0}; i<ext_num; ++i) {
-        const auto ext_str = std::string_view(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)));
-        if (ext_str == "GL_ARB_gl_spirv") {
-            is_arb_spirv_supported = true;
-            break;
-        }
-    }
+using namespace bm;
 
+Shader::Shader(Type type, const std::vector<std::filesystem::path>& paths) : type_(type), paths_(paths) {
     const auto sh_count = static_cast<std::size_t>(type);
     if (paths.size() != sh_count) {
         throw std::runtime_error(spdlog::fmt_lib::format(
@@ -29,46 +23,206 @@ Shader::Shader(Type type, const std::vector<std::filesystem::path>& paths) : typ
             sh_count
         ));
     }
-    const auto enums = type == Type::VERTEX_FRAGMENT ? std::vector<std::uint32_t>({
-        GL_VERTEX_SHADER,
-        GL_FRAGMENT_SHADER
-    }) : std::vector<std::uint32_t>({
-        GL_COMPUTE_SHADER
-    });
+}
+
+const Shader::Capabilities& Shader::capabilities() {
+    static const Capabilities caps = [] {
+        Capabilities result;
+        int ext_num{0};
+        glGetIntegerv(GL_NUM_EXTENSIONS, &ext_num);
+        for (int i{0}; i<ext_num; ++i) {
+            const auto ext_str = std::string_view(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)));
+            if (ext_str == "GL_ARB_gl_spirv") {
+                result.arb_spirv = true;
+                break;
+            }
+        }
+        int binary_formats_num{0};
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binary_formats_num);
+        result.program_binary = binary_formats_num > 0;
+
+        for (const auto name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+            if (const auto* str = glGetString(name); str != nullptr) {
+                result.driver += reinterpret_cast<const char*>(str);
+            }
+            result.driver += '|';
+        }
+        return result;
+    }();
+    return caps;
+}
+
+static std::vector<char> readFile(const std::filesystem::path& path) {
+    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    if (!stream.good()) {
+        return {};
+    }
+    std::vector<char> bytes(static_cast<std::size_t>(stream.tellg()));
+    stream.seekg(0);
+    stream.read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    return bytes;
+}
+
+void Shader::create() const {
+    if (prog_id_ == 0) {
+        prog_id_ = build({});
+    }
+}
+
+std::uint32_t Shader::build(const Specialization &constants) const {
+    const auto& caps = capabilities();
+    const auto sh_count = static_cast<std::size_t>(type_);
 
     std::uint32_t is_spirv{ 0 };
-    for (const auto& path : paths) {
+    for (const auto& path : paths_) {
         is_spirv += static_cast<std::uint32_t>(path.extension().string() == ".spv");
     }
     if (is_spirv != 0 && is_spirv != sh_count) {
         throw std::runtime_error("Spirv shaders and runtime compiled shaders can't be combined");
     } 
-    if (is_spirv == sh_count && !is_arb_spirv_supported) {
+    if (is_spirv == sh_count && !caps.arb_spirv) {
         throw std::runtime_error("Tried to pass spirv shaders but spirv shaders aren't supported on this GPU");
     }
 
-    const bool use_spirv = is_spirv > 0 && is_arb_spirv_supported;
+    const bool use_spirv = is_spirv > 0 && caps.arb_spirv;
+    if (!constants.empty() && !use_spirv) {
+        return 0;
+    }
+
+    // key covers driver, every stage's code and constants, stale entries simply stop being looked up
+    std::filesystem::path cache_path;
+    if (caps.program_binary && !binary_cache_dir.empty()) {
+        auto key = hashBytes(caps.driver.data(), caps.driver.size());
+        for (const auto& path : paths_) {
+            const auto code = readFile(path);
+            key = hashBytes(code.data(), code.size(), key);
+        }
+        key = hashBytes(constants.data(), constants.size() * sizeof(SpecializationConstant), key);
+        cache_path = binary_cache_dir / spdlog::fmt_lib::format("{:016x}.bin", key);
+        if (const auto prog_id = loadBinary(cache_path); prog_id != 0) {
+            return prog_id;
+        }
+    }
 
-	prog_id_ = glCreateProgram();
+	std::vector<GLuint> constant_ids;
+	std::vector<GLuint> constant_values;
+	for (const auto& constant : constants) {
+		constant_ids.push_back(constant.id);
+		constant_values.push_back(constant.value);
+	}
+
+	const auto prog_id = glCreateProgram();
+	if (!cache_path.empty()) {
+		glProgramParameteri(prog_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 
+	const auto enums = type_ == Type::VERTEX_FRAGMENT ? std::vector<std::uint32_t>({
+		GL_VERTEX_SHADER,
+		GL_FRAGMENT_SHADER
+	}) : std::vector<std::uint32_t>({
+		GL_COMPUTE_SHADER
+	});
+	std::array<std::uint32_t, 2> shader_ids{};
+	bool specialized{ true };
 	for (std::size_t i{0}; i < enums.size(); ++i) {
-		auto& sh_id = shader_ids_.at(i);
+		auto& sh_id = shader_ids.at(i);
         sh_id = glCreateShader(enums[i]);
 		if (use_spirv) {
-			const auto sh_binary = parseAsSpirv(paths[i]);
+			const auto sh_binary = parseAsSpirv(paths_[i]);
 			glShaderBinary(1, static_cast<const GLuint *>(&sh_id),
 						GL_SHADER_BINARY_FORMAT_SPIR_V_ARB,
 						static_cast<const void *>(sh_binary.data()),
 						static_cast<GLsizei>(sh_binary.size()));
-			glSpecializeShaderARB(sh_id, "main", 0, nullptr, nullptr);
+			// specialization fails for stages that don't declare all of the constants
+			glSpecializeShaderARB(sh_id, "main",
+				static_cast<GLuint>(constant_ids.size()), constant_ids.data(), constant_values.data());
+			GLint status{GL_FALSE};
+			glGetShaderiv(sh_id, GL_COMPILE_STATUS, &status);
+			if (status != GL_TRUE && !constants.empty()) {
+				// retry without constants, stage doesn't use them
+				glDeleteShader(sh_id);
+				sh_id = glCreateShader(enums[i]);
+				glShaderBinary(1, static_cast<const GLuint *>(&sh_id),
+							GL_SHADER_BINARY_FORMAT_SPIR_V_ARB,
+							static_cast<const void *>(sh_binary.data()),
+							static_cast<GLsizei>(sh_binary.size()));
+				glSpecializeShaderARB(sh_id, "main", 0, nullptr, nullptr);
+				glGetShaderiv(sh_id, GL_COMPILE_STATUS, &status);
+				// fragment/compute stage is the one that has to take the constants
+				specialized = specialized && i + 1 != enums.size();
+			}
 		} else {
-			compileShader(paths[i], sh_id);
+			compileShader(paths_[i], sh_id);
 		}
-		glAttachShader(prog_id_, sh_id);
+		glAttachShader(prog_id, sh_id);
 	}
 
-	glValidateProgram(prog_id_);
-	glLinkProgram(prog_id_);
+	glValidateProgram(prog_id);
+	glLinkProgram(prog_id);
+
+	// linked program keeps its code, shader objects aren't needed anymore
+	for (std::size_t i{0}; i < enums.size(); ++i) {
+		glDetachShader(prog_id, shader_ids.at(i));
+		glDeleteShader(shader_ids.at(i));
+	}
+
+	if (!specialized) {
+		spdlog::warn("Failed to specialize {}, using default program", paths_.back().string());
+		glDeleteProgram(prog_id);
+		return 0;
+	}
+	if (!cache_path.empty()) {
+		storeBinary(prog_id, cache_path);
+	}
+	return prog_id;
+}
+
+std::uint32_t Shader::loadBinary(const std::filesystem::path &cache_path) const {
+	const auto bytes = readFile(cache_path);
+	GLenum format{0};
+	if (bytes.size() <= sizeof(format)) {
+		return 0;
+	}
+	std::memcpy(&format, bytes.data(), sizeof(format));
+
+	const auto prog_id = glCreateProgram();
+	glProgramBinary(
+		prog_id, format,
+		static_cast<const void *>(bytes.data() + sizeof(format)),
+		static_cast<GLsizei>(bytes.size() - sizeof(format))
+	);
+	GLint linked{GL_FALSE};
+	glGetProgramiv(prog_id, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE) {
+		// driver update or corrupted file, program gets rebuilt and entry overwritten
+		spdlog::debug("Rejected cached program {}", cache_path.string());
+		glDeleteProgram(prog_id);
+		return 0;
+	}
+	spdlog::debug("Loaded cached program {}", cache_path.string());
+	return prog_id;
+}
+
+void Shader::storeBinary(std::uint32_t prog_id, const std::filesystem::path &cache_path) const {
+	GLint linked{GL_FALSE};
+	GLint length{0};
+	glGetProgramiv(prog_id, GL_LINK_STATUS, &linked);
+	glGetProgramiv(prog_id, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (linked != GL_TRUE || length <= 0) {
+		return;
+	}
+	GLenum format{0};
+	std::vector<char> bytes(sizeof(format) + static_cast<std::size_t>(length));
+	glGetProgramBinary(prog_id, length, nullptr, &format, static_cast<void *>(bytes.data() + sizeof(format)));
+	std::memcpy(bytes.data(), &format, sizeof(format));
+
+	std::error_code error;
+	std::filesystem::create_directories(cache_path.parent_path(), error);
+	std::ofstream stream(cache_path, std::ios::binary | std::ios::trunc);
+	stream.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+	if (!stream.good()) {
+		spdlog::warn("Failed to write program cache {}", cache_path.string());
+	}
 }
 
 std::vector<char> Shader::parseAsSpirv(const std::filesystem::path &path) {
@@ -105,16 +259,35 @@ void Shader::compileShader(const std::filesystem::path &path, std::uint32_t shad
 	glCompileShader(shader_id);
 }
 void Shader::bind() const {
+	create();
 	glUseProgram(prog_id_);
 }
 
+void Shader::bind(const Specialization &constants) const {
+	const auto key = hashBytes(constants.data(), constants.size() * sizeof(SpecializationConstant));
+	auto variant = std::find_if(variants_.begin(), variants_.end(), [key](const Variant &v) {
+		return v.key == key;
+	});
+	if (variant == variants_.end()) {
+		variants_.push_back({ .key = key, .prog_id = build(constants) });
+		variant = std::prev(variants_.end());
+	}
+	if (variant->prog_id == 0) {
+		bind();
+		return;
+	}
+	glUseProgram(variant->prog_id);
+}
+
 void Shader::deinit() {
-	for (std::size_t i{0}; i < static_cast<std::size_t>(type_); ++i) {
-		auto &sh_id = shader_ids_.at(i);
-		glDetachShader(prog_id_, sh_id);
-		glDeleteShader(sh_id);
-		sh_id = 0;
+	for (const auto &variant : variants_) {
+		if (variant.prog_id != 0) {
+			glDeleteProgram(variant.prog_id);
+		}
+	}
+	variants_.clear();
+	if (prog_id_ != 0) {
+		glDeleteProgram(prog_id_);
 	}
-	glDeleteProgram(prog_id_);
 	prog_id_ = 0;
-}
\ No newline at end of file
+}
@@ -25,12 +25,29 @@ static void getPxFromOffsets(const std::array<i32, 8>& offsets, const std::vecto
     values[S]  = (i + offsets[6]) > 0 && (i + offsets[6]) < bmp.size() ? bmp[static_cast<std::size_t>(i + offsets[6])] > 0 : 0;
 }
 
-void bm::performKMMSkeletonization(void* pixels, i32 width, i32 height, i32 channels_num) {
-     
-	auto *ptr = static_cast<u8*>(pixels);
+template<PixelFormat F>
+static void loadBitmap(const Image& image, std::vector<u8>& bitmap) {
+    for (i32 y{0}, j{0}; y < image.height; ++y) {
+        const auto* row = image.row(y);
+        for (i32 x{0}; x < image.width; ++x, ++j) {
+            bitmap[j] = PixelTraits<F>::load(row, x).r == 0 ? 1U : 0U;
+        }
+    }
+}
 
-    const auto stride = width * channels_num;
-    const auto pixels_size = stride * height;
+template<PixelFormat F>
+static void storeBitmap(Image& image, const std::vector<u8>& bitmap) {
+    for (i32 y{0}, j{0}; y < image.height; ++y) {
+        auto* row = image.row(y);
+        for (i32 x{0}; x < image.width; ++x, ++j) {
+            PixelTraits<F>::storeGray(row, x, bitmap[j] == 1 ? 0U : 255U);
+        }
+    }
+}
+
+void bm::performKMMSkeletonization(Image& image) {
+    const auto width = image.width;
+    const auto height = image.height;
 
     const std::array<i32, 8> offsets{{
         -width - 1, -width, -width + 1,
@@ -39,9 +56,9 @@ void bm::performKMMSkeletonization(void* pixels, i32 width, i32 height, i32 chan
     }};
 
     std::vector<u8> tmp_bitmap(static_cast<std::size_t>(width * height));
-    for (i32 i{0}, j{0}; i < pixels_size; i += channels_num, ++j) {
-        tmp_bitmap[j] = ptr[i] == 0 ? 1U : 0U;
-    }
+    visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+        loadBitmap<F>(image, tmp_bitmap);
+    });
 
     for (bool done{ false }; !done;) {
         done = true;
@@ -144,12 +161,25 @@ void bm::performKMMSkeletonization(void* pixels, i32 width, i32 height, i32 chan
         }
     }
 
-    for (i32 i{0}, j{0}; i < pixels_size; i += channels_num, ++j) {
-        ptr[i + 0] = ptr[i + 1] = ptr[i + 2] = tmp_bitmap[j] == 1 ? 0U : 255U;
+    visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+        storeBitmap<F>(image, tmp_bitmap);
+    });
+}
+
+template<PixelFormat F>
+static void setWhite(u8* px) {
+    if constexpr (F == PixelFormat::RGBA8) {
+        px[0] = px[1] = px[2] = 255U;
+    } else {
+        px[0] = 255U;
     }
 }
 
-void bm::performK3MSkeletonization(void* pixels, i32 width, i32 height, i32 channels_num) {
+template<PixelFormat F>
+requires (F != PixelFormat::BINARY1)
+static void performK3MSkeletonizationImpl(u8* ptr, i32 width, i32 height) {
+    constexpr i32 channels_num = PixelTraits<F>::channels_num;
+
     constexpr std::array<u16, 16> P0 {{    
         0b0001001100001011, 
         0b0000000010001011,
@@ -261,8 +291,6 @@ void bm::performK3MSkeletonization(void* pixels, i32 width, i32 height, i32 chan
 
     std::array<const std::array<u16, 16>*, 5> main_phases{{&P1, &P2, &P3, &P4, &P5}};
 
-	auto *ptr = static_cast<u8*>(pixels);
-
     const auto stride = width * channels_num;
     const auto pixels_size = stride * height;
 
@@ -321,7 +349,7 @@ void bm::performK3MSkeletonization(void* pixels, i32 width, i32 height, i32 chan
                     values[SW] * 32 + values[S] * 16 + values[SE] * 8;
 
                 if ((PX->at(sum / 16) & (0x8000U >> (sum % 16))) > 0U) {
-                    ptr[i + 0] = ptr[i + 1] = ptr[i + 2] = 255U;
+                    setWhite<F>(ptr + i);
                     done = false;
                 }
             }
@@ -350,13 +378,35 @@ void bm::performK3MSkeletonization(void* pixels, i32 width, i32 height, i32 chan
             values[SW] * 32 + values[S] * 16 + values[SE] * 8;
 
         if ((P0[sum / 16] & (0x8000U >> (sum % 16))) > 0U) {
-            ptr[i + 0] = ptr[i + 1] = ptr[i + 2] = 255U;
+            setWhite<F>(ptr + i);
         }
     }
 }
 
-void bm::performCrossingNumber(void* pixels, i32 width, i32 height, i32 channels_num, const fs::path& output_file_path) {
-	auto *ptr = static_cast<u8*>(pixels);
+void bm::performK3MSkeletonization(Image& image) {
+    switch (image.format) {
+    case PixelFormat::GRAY8:
+        performK3MSkeletonizationImpl<PixelFormat::GRAY8>(image.pixels.data(), image.width, image.height);
+        break;
+    case PixelFormat::RGBA8:
+        performK3MSkeletonizationImpl<PixelFormat::RGBA8>(image.pixels.data(), image.width, image.height);
+        break;
+    case PixelFormat::BINARY1:
+        // K3M works in place on byte per pixel data
+        image.convert(PixelFormat::GRAY8);
+        performK3MSkeletonizationImpl<PixelFormat::GRAY8>(image.pixels.data(), image.width, image.height);
+        image.convert(PixelFormat::BINARY1);
+        break;
+    }
+}
+
+void bm::performCrossingNumber(Image& image, const fs::path& output_file_path) {
+    image.convert(PixelFormat::RGBA8);
+
+	auto *ptr = image.pixels.data();
+    const auto width = image.width;
+    const auto height = image.height;
+    const auto channels_num = image.channels_num;
 
     const auto stride = width * channels_num;
     const auto pixels_size = stride * height;
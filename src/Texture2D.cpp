@@ -1,5 +1,7 @@
 #include "Texture2D.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cmath>
 
 #include <glad/glad.h>
@@ -7,11 +9,8 @@
 using namespace bm;
 
 static void configure(u32 tex_id, Texture2D::Config config) {
-    const auto num_levels = config.mipmap ? static_cast<i32>(std::ceil(std::log2(std::min(
-        static_cast<f32>(config.width), 
-        static_cast<f32>(config.height)
-    )))) : 1;
-    
+    const auto num_levels = config.mipmap ? Texture2D::levelsNum(config.width, config.height) : 1;
+
     glTextureStorage2D(tex_id, num_levels, config.internal_fmt, config.width, config.height);
     if (config.wrap_s != 0) {
         glTextureParameteri(tex_id, GL_TEXTURE_WRAP_S, config.wrap_s);
@@ -25,9 +24,6 @@ static void configure(u32 tex_id, Texture2D::Config config) {
     if (config.mag_filter != 0) {
         glTextureParameteri(tex_id, GL_TEXTURE_MAG_FILTER, config.mag_filter);
     }
-    if (config.mipmap) {
-        glGenerateTextureMipmap(tex_id);
-    }
 }
 
 Texture2D::Texture2D(Config config) : config(config) {
@@ -41,14 +37,35 @@ void Texture2D::resize(i32 width, i32 height) {
     config.height = height;
     configure(tex_id_, config);
 }
-void Texture2D::update(const void* data) const {
+i32 Texture2D::levelsNum(i32 width, i32 height) {
+    return static_cast<i32>(std::floor(std::log2(static_cast<f32>(std::max({ width, height, 1 }))))) + 1;
+}
+void Texture2D::update(const void* data, i32 level) const {
+    const auto [width, height] = levelSize(level);
     glTextureSubImage2D(
         tex_id_,
-        0, 0, 0, config.width, config.height,
+        level, 0, 0, width, height,
         config.fmt, config.type,
         data 
     );
 }
+std::pair<i32, i32> Texture2D::levelSize(i32 level) const {
+    return { std::max(config.width >> level, 1), std::max(config.height >> level, 1) };
+}
+void Texture2D::generateMipmap() const {
+    if (config.mipmap) {
+        glGenerateTextureMipmap(tex_id_);
+    }
+}
+void Texture2D::baseLevel(i32 level) const {
+    glTextureParameteri(tex_id_, GL_TEXTURE_BASE_LEVEL, level);
+}
+void Texture2D::swizzleGray(bool enabled) const {
+    const std::array<i32, 4> swizzle = enabled ?
+        std::array<i32, 4>{{ GL_RED, GL_RED, GL_RED, GL_ONE }} :
+        std::array<i32, 4>{{ GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA }};
+    glTextureParameteriv(tex_id_, GL_TEXTURE_SWIZZLE_RGBA, swizzle.data());
+}
 void Texture2D::deinit() {
     glDeleteTextures(1, &tex_id_);
 }
@@ -0,0 +1,281 @@
+#include "Thinning.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+#include <spdlog/spdlog.h>
+
+#include "Minutiae.hpp"
+#include "Parallel.hpp"
+#include "Skeletonization.hpp"
+
+using namespace bm;
+
+namespace {
+
+// Ridge bits (1 = ridge) in words of 64 pixels with background row above and below
+// and background past width, so rows of image are row(0) to row(height - 1).
+struct BitPlane {
+    i32 width{ 0 };
+    i32 height{ 0 };
+    std::size_t words{ 0 };
+    std::vector<u64> bits;
+
+    explicit BitPlane(const Image& image)
+        : width(image.width)
+        , height(image.height)
+        , words(static_cast<std::size_t>(image.width + 63) / 64)
+        , bits(words * static_cast<std::size_t>(image.height + 2), 0U) {
+        const auto tail_mask = tailMask();
+        visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+            for (i32 y{ 0 }; y < height; ++y) {
+                const auto* src = image.row(y);
+                auto* dst = row(y);
+                if constexpr (F == PixelFormat::BINARY1) {
+                    std::memcpy(dst, src, words * sizeof(u64));
+                    for (std::size_t i{ 0 }; i < words; ++i) {
+                        dst[i] = ~dst[i];
+                    }
+                    dst[words - 1] &= tail_mask;
+                } else {
+                    for (i32 x{ 0 }; x < width; ++x) {
+                        if (PixelTraits<F>::gray(src, x) < 128U) {
+                            dst[x >> 6] |= u64{ 1 } << (x & 63);
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    [[nodiscard]] u64 tailMask() const {
+        return width % 64 == 0 ? ~u64{ 0 } : (u64{ 1 } << (width % 64)) - 1;
+    }
+    u64* row(i32 y) { return bits.data() + static_cast<std::size_t>(y + 1) * words; }
+    [[nodiscard]] const u64* row(i32 y) const { return bits.data() + static_cast<std::size_t>(y + 1) * words; }
+
+    void store(Image& image) const {
+        const auto tail_mask = tailMask();
+        visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+            for (i32 y{ 0 }; y < height; ++y) {
+                const auto* src = row(y);
+                auto* dst = image.row(y);
+                if constexpr (F == PixelFormat::BINARY1) {
+                    for (std::size_t i{ 0 }; i < words; ++i) {
+                        const auto white = ~src[i] & (i + 1 == words ? tail_mask : ~u64{ 0 });
+                        std::memcpy(dst + i * sizeof(u64), &white, sizeof(u64));
+                    }
+                } else {
+                    for (i32 x{ 0 }; x < width; ++x) {
+                        PixelTraits<F>::storeGray(dst, x, ((src[x >> 6] >> (x & 63)) & 1U) != 0 ? 0U : 255U);
+                    }
+                }
+            }
+        });
+    }
+};
+
+// neighbours of 64 pixels of word, clockwise from north as p2 to p9 of Zhang and Suen
+struct Neighbours {
+    u64 p2, p3, p4, p5, p6, p7, p8, p9;
+};
+
+// counts set bits of words added, per bit position, up to two
+struct UpToTwo {
+    u64 ones{ 0 };
+    u64 twos{ 0 };
+
+    void add(u64 bits) {
+        twos |= ones & bits;
+        ones |= bits;
+    }
+    [[nodiscard]] u64 exactlyOne() const { return ones & ~twos; }
+};
+
+}
+
+// bit x is pixel x - 1 of row
+static u64 west(const u64* row, std::size_t i) {
+    return (row[i] << 1) | (i > 0 ? row[i - 1] >> 63 : 0U);
+}
+
+// bit x is pixel x + 1 of row
+static u64 east(const u64* row, std::size_t i, std::size_t words) {
+    return (row[i] >> 1) | (i + 1 < words ? row[i + 1] << 63 : 0U);
+}
+
+// Subiterations alternate until a whole iteration removes nothing. deletable(n, first)
+// is evaluated for all pixels of previous subiteration at once, 64 per word, and
+// bands of rows write into second plane, so rows run in parallel without ordering.
+template<typename Deletable>
+static void thin(BitPlane& plane, Deletable&& deletable) {
+    auto next = plane;
+    const auto words = plane.words;
+    const auto bands_num = bandsNum(plane.height, 16);
+    std::vector<u8> band_changed(static_cast<std::size_t>(bands_num));
+    for (bool changed{ true }; changed;) {
+        changed = false;
+        for (const auto first : { true, false }) {
+            std::fill(band_changed.begin(), band_changed.end(), 0U);
+            parallelForBands(bands_num, plane.height, [&](i32 band, i32 begin, i32 end) {
+                u64 removed{ 0 };
+                for (auto y{ begin }; y < end; ++y) {
+                    const auto* up = plane.row(y - 1);
+                    const auto* center = plane.row(y);
+                    const auto* down = plane.row(y + 1);
+                    auto* out = next.row(y);
+                    for (std::size_t i{ 0 }; i < words; ++i) {
+                        const Neighbours n{
+                            up[i], east(up, i, words), east(center, i, words), east(down, i, words),
+                            down[i], west(down, i), west(center, i), west(up, i)
+                        };
+                        const auto remove = center[i] & deletable(n, first);
+                        out[i] = center[i] & ~remove;
+                        removed |= remove;
+                    }
+                }
+                band_changed[static_cast<std::size_t>(band)] = removed != 0U ? 1U : 0U;
+            });
+            std::swap(plane.bits, next.bits);
+            changed = changed || std::find(band_changed.begin(), band_changed.end(), 1U) != band_changed.end();
+        }
+    }
+}
+
+static u64 zhangSuenDeletable(const Neighbours& n, bool first) {
+    const std::array<u64, 8> around{ n.p2, n.p3, n.p4, n.p5, n.p6, n.p7, n.p8, n.p9 };
+    UpToTwo ridge;
+    UpToTwo background;
+    UpToTwo transitions;
+    for (std::size_t i{ 0 }; i < around.size(); ++i) {
+        ridge.add(around[i]);
+        background.add(~around[i]);
+        transitions.add(~around[i] & around[(i + 1) % around.size()]);
+    }
+    // 2 <= ridge neighbours <= 6, i.e. at least two of both
+    const auto count = ridge.twos & background.twos;
+    const auto side = first
+        ? ~(n.p2 & n.p4 & n.p6) & ~(n.p4 & n.p6 & n.p8)
+        : ~(n.p2 & n.p4 & n.p8) & ~(n.p2 & n.p6 & n.p8);
+    return count & transitions.exactlyOne() & side;
+}
+
+static u64 guoHallDeletable(const Neighbours& n, bool first) {
+    // C(p) == 1, pixel joins exactly one 8-connected ridge
+    UpToTwo joined;
+    joined.add(~n.p2 & (n.p3 | n.p4));
+    joined.add(~n.p4 & (n.p5 | n.p6));
+    joined.add(~n.p6 & (n.p7 | n.p8));
+    joined.add(~n.p8 & (n.p9 | n.p2));
+
+    // 2 <= min(N1(p), N2(p)) <= 3 over two ways of pairing neighbours
+    const std::array<u64, 4> pairs1{ n.p9 | n.p2, n.p3 | n.p4, n.p5 | n.p6, n.p7 | n.p8 };
+    const std::array<u64, 4> pairs2{ n.p2 | n.p3, n.p4 | n.p5, n.p6 | n.p7, n.p8 | n.p9 };
+    UpToTwo n1;
+    UpToTwo n2;
+    for (std::size_t i{ 0 }; i < pairs1.size(); ++i) {
+        n1.add(pairs1[i]);
+        n2.add(pairs2[i]);
+    }
+    const auto all1 = pairs1[0] & pairs1[1] & pairs1[2] & pairs1[3];
+    const auto all2 = pairs2[0] & pairs2[1] & pairs2[2] & pairs2[3];
+    const auto count = n1.twos & n2.twos & ~(all1 & all2);
+
+    const auto side = first
+        ? (n.p6 | n.p7 | ~n.p9) & n.p8
+        : (n.p2 | n.p3 | ~n.p5) & n.p4;
+    return joined.exactlyOne() & count & ~side;
+}
+
+void bm::performZhangSuenThinning(Image& image) {
+    if (image.width == 0 || image.height == 0) {
+        return;
+    }
+    BitPlane plane(image);
+    thin(plane, zhangSuenDeletable);
+    plane.store(image);
+}
+
+void bm::performGuoHallThinning(Image& image) {
+    if (image.width == 0 || image.height == 0) {
+        return;
+    }
+    BitPlane plane(image);
+    thin(plane, guoHallDeletable);
+    plane.store(image);
+}
+
+const std::array<Thinner, THINNERS_COUNT>& bm::thinners() {
+    static const std::array<Thinner, THINNERS_COUNT> registry{{
+        { ThinningAlgorithm::KMM, "KMM", false,
+            "sequential, slowest, one pixel wide but with more spurs", performKMMSkeletonization },
+        { ThinningAlgorithm::K3M, "K3M", false,
+            "sequential, fewest spurs, ridges follow staircases", performK3MSkeletonization },
+        { ThinningAlgorithm::ZHANG_SUEN, "Zhang-Suen", true,
+            "parallel, leaves staircase corners on diagonals", performZhangSuenThinning },
+        { ThinningAlgorithm::GUO_HALL, "Guo-Hall", true,
+            "parallel, fastest, one pixel wide 8-connected ridges", performGuoHallThinning },
+    }};
+    return registry;
+}
+
+const Thinner& bm::thinner(ThinningAlgorithm algorithm) {
+    const auto& registry = thinners();
+    const auto it = std::find_if(registry.begin(), registry.end(),
+        [&](const Thinner& candidate) { return candidate.algorithm == algorithm; });
+    return it != registry.end() ? *it : registry.front();
+}
+
+ThinningStats bm::measureThinning(const Image& binarized, const Thinner& thinner) {
+    ThinningStats stats;
+    auto skeleton = binarized;
+    const auto start = std::chrono::steady_clock::now();
+    thinner.perform(skeleton);
+    stats.milliseconds = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    const RidgeMap map(skeleton);
+    for (i32 y{ 0 }; y < map.height; ++y) {
+        for (i32 x{ 0 }; x < map.width; ++x) {
+            if (!map.ridge(x, y)) {
+                continue;
+            }
+            ++stats.ridge_pixels;
+            std::array<bool, RidgeMap::CIRCLE.size()> around{};
+            i32 neighbours{ 0 };
+            for (std::size_t i{ 0 }; i < around.size(); ++i) {
+                around[i] = map.ridge(x + RidgeMap::CIRCLE[i][0], y + RidgeMap::CIRCLE[i][1]);
+                neighbours += around[i] ? 1 : 0;
+            }
+            // 8-connected ridges among neighbours, C(p) of Guo and Hall
+            i32 joined{ 0 };
+            for (std::size_t i{ 0 }; i < around.size(); i += 2) {
+                joined += !around[i] && (around[i + 1] || around[(i + 2) % around.size()]) ? 1 : 0;
+            }
+            if (neighbours == 1) {
+                ++stats.endings;
+            } else if (neighbours > 1 && joined == 1) {
+                ++stats.redundant_pixels;
+            } else if (map.crossingNumber(x, y) >= 3) {
+                ++stats.bifurcations;
+            }
+        }
+    }
+    return stats;
+}
+
+bool bm::writeThinningBenchmark(const fs::path& path, const std::vector<ThinningBenchmarkRow>& rows) {
+    std::ofstream stream(path);
+    if (!stream.is_open()) {
+        spdlog::error("Failed to open {} for writing", path.string());
+        return false;
+    }
+    stream << "image,algorithm,milliseconds,ridge_pixels,redundant_pixels,endings,bifurcations\n";
+    for (const auto& row : rows) {
+        stream << row.path.filename().string() << ',' << thinner(row.algorithm).name << ','
+            << row.stats.milliseconds << ',' << row.stats.ridge_pixels << ',' << row.stats.redundant_pixels << ','
+            << row.stats.endings << ',' << row.stats.bifurcations << '\n';
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+using namespace bm;
+
+ThreadPool::ThreadPool(std::size_t workers_num) {
+    workers_num = std::max(workers_num, std::size_t{ 1 });
+    workers.reserve(workers_num);
+    for (std::size_t i{ 0 }; i < workers_num; ++i) {
+        workers.emplace_back([this] {
+            for (;;) {
+                std::function<void()> task;
+                {
+                    std::unique_lock lock(mutex);
+                    cv.wait(lock, [this] { return stop || !tasks.empty(); });
+                    if (stop && tasks.empty()) {
+                        return;
+                    }
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        });
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    cv.notify_one();
+}
+
+void ThreadPool::discardPending() {
+    std::lock_guard lock(mutex);
+    tasks.clear();
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex);
+        stop = true;
+    }
+    cv.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
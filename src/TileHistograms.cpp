@@ -0,0 +1,245 @@
+#include "TileHistograms.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <span>
+
+#include "Algorithm.hpp"
+#include "Parallel.hpp"
+
+using namespace bm;
+
+// tiles whose 5th-95th percentile spread is below this hold only background (or only ink)
+static constexpr i32 MIN_TILE_CONTRAST{ 32 };
+
+template<PixelFormat F>
+static u8 channelValue(const u8* row, i32 x, Histogram::Channel channel) {
+    if constexpr (F == PixelFormat::RGBA8) {
+        switch (channel) {
+        case Histogram::Channel::R: return row[4 * x + 0];
+        case Histogram::Channel::G: return row[4 * x + 1];
+        case Histogram::Channel::B: return row[4 * x + 2];
+        case Histogram::Channel::ALL: break;
+        }
+    }
+    return PixelTraits<F>::gray(row, x);
+}
+
+void TileHistograms::set(const Image& image, i32 tile_size, Histogram::Channel channel) {
+    tile_size = std::max(tile_size, 1);
+    tiles_x = std::max((image.width + tile_size / 2) / tile_size, 1);
+    tiles_y = std::max((image.height + tile_size / 2) / tile_size, 1);
+    tile_width = (image.width + tiles_x - 1) / tiles_x;
+    tile_height = (image.height + tiles_y - 1) / tiles_y;
+    sums.assign(static_cast<std::size_t>(tiles_x * tiles_y), {});
+
+    // bands are whole tile rows so every histogram is written by one thread only
+    parallelForBands(bandsNum(tiles_y, 1), tiles_y, [&](i32, i32 tile_row_begin, i32 tile_row_end) {
+        visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+            const auto row_end = std::min(tile_row_end * tile_height, image.height);
+            for (i32 y{ tile_row_begin * tile_height }; y < row_end; ++y) {
+                const auto* row = image.row(y);
+                auto* tile_sums = &sums[static_cast<std::size_t>((y / tile_height) * tiles_x)];
+                for (i32 x{ 0 }; x < image.width; ++x) {
+                    ++tile_sums[x / tile_width][channelValue<F>(row, x, channel)];
+                }
+            }
+        });
+    });
+}
+
+// For every coordinate along axis, index of tile centre at or before it and weight of the next one.
+// Coordinates before first/after last centre only see their nearest tile.
+struct AxisInterpolation {
+    std::vector<i32> lower;
+    std::vector<f32> weight;
+};
+
+static AxisInterpolation interpolateAxis(i32 size, i32 tile_size, i32 tiles) {
+    AxisInterpolation axis;
+    axis.lower.resize(static_cast<std::size_t>(size));
+    axis.weight.resize(static_cast<std::size_t>(size));
+    for (i32 c{ 0 }; c < size; ++c) {
+        const auto position = (static_cast<f32>(c) + .5F) / static_cast<f32>(tile_size) - .5F;
+        const auto lower = static_cast<i32>(std::floor(position));
+        auto& out_lower = axis.lower[static_cast<std::size_t>(c)];
+        auto& out_weight = axis.weight[static_cast<std::size_t>(c)];
+        if (lower < 0) {
+            out_lower = 0;
+            out_weight = 0.F;
+        } else if (lower >= tiles - 1) {
+            out_lower = tiles - 1;
+            out_weight = 0.F;
+        } else {
+            out_lower = lower;
+            out_weight = position - static_cast<f32>(lower);
+        }
+    }
+    return axis;
+}
+
+static i32 histogramPercentile(const std::array<u32, 256>& histogram, u64 count, f32 fraction) {
+    const auto rank = std::max<u64>(static_cast<u64>(std::ceil(static_cast<f64>(count) * fraction)), 1);
+    u64 sum{ 0 };
+    for (std::size_t i{ 0 }; i < histogram.size(); ++i) {
+        sum += histogram[i];
+        if (sum >= rank) {
+            return static_cast<i32>(i);
+        }
+    }
+    return 255;
+}
+
+void bm::performAdaptiveOtsu(Image& image, i32 tile_size) {
+    TileHistograms tiles;
+    tiles.set(image, tile_size);
+
+    std::array<u32, 256> global_sums{};
+    for (const auto& sums : tiles.sums) {
+        for (std::size_t i{ 0 }; i < global_sums.size(); ++i) {
+            global_sums[i] += sums[i];
+        }
+    }
+    const auto global_threshold = static_cast<f32>(OtsuBinarizationAlgorithm::computeThreshold(global_sums));
+
+    std::vector<f32> thresholds(tiles.sums.size());
+    for (std::size_t i{ 0 }; i < tiles.sums.size(); ++i) {
+        const auto& sums = tiles.sums[i];
+        u64 count{ 0 };
+        for (const auto value : sums) {
+            count += value;
+        }
+        const auto spread = histogramPercentile(sums, count, .95F) - histogramPercentile(sums, count, .05F);
+        thresholds[i] = spread < MIN_TILE_CONTRAST ?
+            global_threshold :
+            static_cast<f32>(OtsuBinarizationAlgorithm::computeThreshold(sums));
+    }
+
+    const auto x_axis = interpolateAxis(image.width, tiles.tile_width, tiles.tiles_x);
+    const auto y_axis = interpolateAxis(image.height, tiles.tile_height, tiles.tiles_y);
+
+    parallelForBands(bandsNum(image.height, 64), image.height, [&](i32, i32 row_begin, i32 row_end) {
+        // thresholds are first interpolated along y once per row, then along x per pixel
+        std::vector<f32> row_thresholds(static_cast<std::size_t>(tiles.tiles_x));
+        visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+            for (i32 y{ row_begin }; y < row_end; ++y) {
+                const auto tile_y0 = y_axis.lower[static_cast<std::size_t>(y)];
+                const auto tile_y1 = std::min(tile_y0 + 1, tiles.tiles_y - 1);
+                const auto weight_y = y_axis.weight[static_cast<std::size_t>(y)];
+                for (i32 tile_x{ 0 }; tile_x < tiles.tiles_x; ++tile_x) {
+                    const auto t0 = thresholds[static_cast<std::size_t>(tile_y0 * tiles.tiles_x + tile_x)];
+                    const auto t1 = thresholds[static_cast<std::size_t>(tile_y1 * tiles.tiles_x + tile_x)];
+                    row_thresholds[static_cast<std::size_t>(tile_x)] = t0 + (t1 - t0) * weight_y;
+                }
+
+                auto* row = image.row(y);
+                for (i32 x{ 0 }; x < image.width; ++x) {
+                    const auto tile_x0 = x_axis.lower[static_cast<std::size_t>(x)];
+                    const auto tile_x1 = std::min(tile_x0 + 1, tiles.tiles_x - 1);
+                    const auto t0 = row_thresholds[static_cast<std::size_t>(tile_x0)];
+                    const auto t1 = row_thresholds[static_cast<std::size_t>(tile_x1)];
+                    const auto threshold = t0 + (t1 - t0) * x_axis.weight[static_cast<std::size_t>(x)];
+                    const auto value = static_cast<f32>(PixelTraits<F>::gray(row, x));
+                    PixelTraits<F>::storeGray(row, x, value > threshold ? 255U : 0U);
+                }
+            }
+        });
+    });
+}
+
+// clipped cumulative histogram of tile scaled to 0-255
+static void computeClippedMapping(const std::array<u32, 256>& sums, f32 clip_limit, u8* mapping) {
+    u64 count{ 0 };
+    for (const auto value : sums) {
+        count += value;
+    }
+    if (count == 0) {
+        for (std::size_t i{ 0 }; i < 256; ++i) {
+            mapping[i] = static_cast<u8>(i);
+        }
+        return;
+    }
+
+    const auto limit = std::max<u64>(static_cast<u64>(clip_limit * static_cast<f32>(count) / 256.F), 1);
+    std::array<u64, 256> clipped{};
+    u64 excess{ 0 };
+    for (std::size_t i{ 0 }; i < 256; ++i) {
+        clipped[i] = std::min<u64>(sums[i], limit);
+        excess += sums[i] - clipped[i];
+    }
+    // excess goes evenly to every bin, remainder to evenly spaced ones
+    const auto per_bin = excess / 256;
+    const auto remainder = excess % 256;
+    for (std::size_t i{ 0 }; i < 256; ++i) {
+        clipped[i] += per_bin;
+    }
+    if (remainder != 0) {
+        const auto step = 256 / remainder;
+        for (u64 i{ 0 }; i < remainder; ++i) {
+            ++clipped[static_cast<std::size_t>(i * step)];
+        }
+    }
+
+    u64 cdf{ 0 };
+    for (std::size_t i{ 0 }; i < 256; ++i) {
+        cdf += clipped[i];
+        mapping[i] = static_cast<u8>((cdf * 255 + count / 2) / count);
+    }
+}
+
+void bm::performCLAHE(Image& image, i32 tile_size, f32 clip_limit) {
+    const std::array<Histogram::Channel, 3> rgb_channels{{ Histogram::Channel::R, Histogram::Channel::G, Histogram::Channel::B }};
+    const auto channels = image.format == PixelFormat::RGBA8 ?
+        std::span<const Histogram::Channel>(rgb_channels) :
+        std::span<const Histogram::Channel>(rgb_channels.data(), 1);
+
+    // mappings[channel][tile][value], i.e. tiles_y x tiles_x x 256 lut per channel
+    TileHistograms tiles;
+    std::vector<std::vector<u8>> mappings(channels.size());
+    for (std::size_t c{ 0 }; c < channels.size(); ++c) {
+        tiles.set(image, tile_size, channels.size() == 1 ? Histogram::Channel::ALL : channels[c]);
+        mappings[c].resize(tiles.sums.size() * 256);
+        for (std::size_t i{ 0 }; i < tiles.sums.size(); ++i) {
+            computeClippedMapping(tiles.sums[i], clip_limit, &mappings[c][i * 256]);
+        }
+    }
+
+    const auto x_axis = interpolateAxis(image.width, tiles.tile_width, tiles.tiles_x);
+    const auto y_axis = interpolateAxis(image.height, tiles.tile_height, tiles.tiles_y);
+
+    parallelForBands(bandsNum(image.height, 64), image.height, [&](i32, i32 row_begin, i32 row_end) {
+        visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+            for (i32 y{ row_begin }; y < row_end; ++y) {
+                const auto tile_y0 = y_axis.lower[static_cast<std::size_t>(y)];
+                const auto tile_y1 = std::min(tile_y0 + 1, tiles.tiles_y - 1);
+                const auto weight_y = y_axis.weight[static_cast<std::size_t>(y)];
+                auto* row = image.row(y);
+                for (i32 x{ 0 }; x < image.width; ++x) {
+                    const auto tile_x0 = x_axis.lower[static_cast<std::size_t>(x)];
+                    const auto tile_x1 = std::min(tile_x0 + 1, tiles.tiles_x - 1);
+                    const auto weight_x = x_axis.weight[static_cast<std::size_t>(x)];
+                    const auto lut00 = static_cast<std::size_t>(tile_y0 * tiles.tiles_x + tile_x0) * 256;
+                    const auto lut01 = static_cast<std::size_t>(tile_y0 * tiles.tiles_x + tile_x1) * 256;
+                    const auto lut10 = static_cast<std::size_t>(tile_y1 * tiles.tiles_x + tile_x0) * 256;
+                    const auto lut11 = static_cast<std::size_t>(tile_y1 * tiles.tiles_x + tile_x1) * 256;
+
+                    const auto equalize = [&](const std::vector<u8>& mapping, u8 value) {
+                        const auto top = static_cast<f32>(mapping[lut00 + value]) +
+                            (static_cast<f32>(mapping[lut01 + value]) - static_cast<f32>(mapping[lut00 + value])) * weight_x;
+                        const auto bottom = static_cast<f32>(mapping[lut10 + value]) +
+                            (static_cast<f32>(mapping[lut11 + value]) - static_cast<f32>(mapping[lut10 + value])) * weight_x;
+                        return static_cast<u8>(top + (bottom - top) * weight_y + .5F);
+                    };
+
+                    if constexpr (F == PixelFormat::RGBA8) {
+                        for (std::size_t c{ 0 }; c < 3; ++c) {
+                            row[4 * x + static_cast<i32>(c)] = equalize(mappings[c], row[4 * x + static_cast<i32>(c)]);
+                        }
+                    } else {
+                        PixelTraits<F>::storeGray(row, x, equalize(mappings[0], PixelTraits<F>::gray(row, x)));
+                    }
+                }
+            }
+        });
+    });
+}
@@ -0,0 +1,172 @@
+#include "TiledImage.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+#include <spdlog/spdlog.h>
+
+using namespace bm;
+
+bool TiledImage::open(const fs::path& path) {
+    close();
+    if (!source.open(path)) {
+        return false;
+    }
+    if (source.view.encoding != ImageView::Encoding::GRAY8) {
+        spdlog::error("Only 8 bit gray images can be processed in tiles ({})", path.string());
+        source.close();
+        return false;
+    }
+    width = source.view.width;
+    height = source.view.height;
+    return true;
+}
+
+bool TiledImage::create(const fs::path& path, i32 width, i32 height) {
+    close();
+    std::ostringstream header;
+    header << "P5\n" << width << ' ' << height << "\n255\n";
+    const auto header_str = header.str();
+    {
+        std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+        stream.write(header_str.data(), static_cast<std::streamsize>(header_str.size()));
+        if (!stream.good()) {
+            spdlog::error("Failed to create {}", path.string());
+            return false;
+        }
+    }
+    // payload is left sparse, tiles fill it in any order
+    std::error_code error;
+    fs::resize_file(path, header_str.size() + static_cast<std::size_t>(width) * static_cast<std::size_t>(height), error);
+    if (error) {
+        spdlog::error("Failed to allocate {}: {}", path.string(), error.message());
+        return false;
+    }
+    output.open(path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!output.good()) {
+        spdlog::error("Failed to open {} for writing", path.string());
+        return false;
+    }
+    this->width = width;
+    this->height = height;
+    output_payload_offset = static_cast<std::streamoff>(header_str.size());
+    return true;
+}
+
+void TiledImage::close() {
+    source.close();
+    if (output.is_open()) {
+        output.close();
+    }
+    width = 0;
+    height = 0;
+    output_payload_offset = 0;
+}
+
+void TiledImage::readRegion(TileRect rect, i32 halo, Image& out) const {
+    const auto out_width = rect.width + 2 * halo;
+    const auto out_height = rect.height + 2 * halo;
+    if (out.width != out_width || out.height != out_height || out.format != PixelFormat::GRAY8) {
+        out = Image(out_width, out_height, PixelFormat::GRAY8);
+    }
+
+    // samples of pgm with maxval below 255 are scaled in tile, mapping stays untouched
+    const auto rescale = source.view.max_value != 255;
+    std::array<u8, 256> levels{};
+    if (rescale) {
+        for (std::size_t sample{ 0 }; sample < levels.size(); ++sample) {
+            levels[sample] = source.view.level(static_cast<u8>(sample));
+        }
+    }
+
+    const auto x0 = rect.x - halo;
+    // part of the row lying inside the image is copied at once, the rest repeats edge pixels
+    const auto inner_begin = std::max(x0, 0);
+    const auto inner_end = std::min(x0 + out_width, width);
+    for (i32 y{ 0 }; y < out_height; ++y) {
+        const auto src_y = std::clamp(rect.y - halo + y, 0, height - 1);
+        const auto* src_row = source.view.row(src_y);
+        auto* dst_row = out.row(y);
+        for (i32 x{ x0 }; x < inner_begin; ++x) {
+            dst_row[x - x0] = src_row[0];
+        }
+        std::memcpy(dst_row + (inner_begin - x0), src_row + inner_begin, static_cast<std::size_t>(inner_end - inner_begin));
+        for (i32 x{ inner_end }; x < x0 + out_width; ++x) {
+            dst_row[x - x0] = src_row[width - 1];
+        }
+        if (rescale) {
+            std::transform(dst_row, dst_row + out_width, dst_row, [&](u8 sample) { return levels[sample]; });
+        }
+    }
+}
+
+bool TiledImage::writeRegion(TileRect rect, i32 halo, const Image& tile) {
+    for (i32 y{ 0 }; y < rect.height; ++y) {
+        const auto offset = output_payload_offset +
+            static_cast<std::streamoff>(rect.y + y) * width + rect.x;
+        output.seekp(offset);
+        output.write(
+            reinterpret_cast<const char*>(tile.row(y + halo) + halo), // NOLINT
+            static_cast<std::streamsize>(rect.width)
+        );
+    }
+    return output.good();
+}
+
+i32 bm::tileSide(const TileOptions& options) {
+    const auto tile_bytes = options.memory_budget / 2;
+    // both limits bound tile with its halo, halo is taken off before clamping
+    const auto side_with_halo = std::min(
+        static_cast<i32>(std::sqrt(static_cast<f64>(tile_bytes))),
+        options.max_side
+    );
+    const auto side = side_with_halo - 2 * options.halo;
+    if (options.halo < 0 || side < 1) {
+        spdlog::error("Halo of {} px leaves no tile interior within {} px side", options.halo, side_with_halo);
+        return 0;
+    }
+    return side;
+}
+
+bool bm::processTiled(
+    const TiledImage& src, TiledImage& dst,
+    const TileOptions& options,
+    const std::function<void(Image& tile, TileRect rect)>& fn
+) {
+    if (src.width != dst.width || src.height != dst.height) {
+        spdlog::error("Tiled source and destination differ in size");
+        return false;
+    }
+    const auto side = tileSide(options);
+    if (side == 0) {
+        return false;
+    }
+    const auto tiles_x = (src.width + side - 1) / side;
+    const auto tiles_y = (src.height + side - 1) / side;
+    spdlog::info("Processing {}x{} image in {}x{} tiles of {} px (halo {})",
+        src.width, src.height, tiles_x, tiles_y, side, options.halo);
+
+    // tile buffer is reused while tile size stays the same, i.e. everywhere except last column/row
+    Image tile(0, 0, PixelFormat::GRAY8);
+    for (i32 tile_y{ 0 }; tile_y < tiles_y; ++tile_y) {
+        for (i32 tile_x{ 0 }; tile_x < tiles_x; ++tile_x) {
+            const TileRect rect{
+                .x = tile_x * side,
+                .y = tile_y * side,
+                .width = std::min(side, src.width - tile_x * side),
+                .height = std::min(side, src.height - tile_y * side)
+            };
+            src.readRegion(rect, options.halo, tile);
+            fn(tile, rect);
+            if (!dst.writeRegion(rect, options.halo, tile)) {
+                spdlog::error("Failed to write tile at ({}, {})", rect.x, rect.y);
+                return false;
+            }
+        }
+    }
+    dst.output.flush();
+    return dst.output.good();
+}
@@ -1,20 +1,40 @@
 #include <array>
 #include <bitset>
+#include <chrono>
+#include <functional>
 #include <optional>
 #include <ranges>
 #include <span>
 #include <future>
+#include <numeric>
 #include <stack>
+#include <utility>
 
 #include <Skeletonization.hpp>
+#include <TiledImage.hpp>
+#include <TileHistograms.hpp>
+#include <DescriptorRing.hpp>
 #include <Algorithm.hpp>
 #include <DirManager.hpp>
+#include <DistanceTransform.hpp>
+#include <ForegroundMask.hpp>
+#include <FrequencyField.hpp>
+#include <Gabor.hpp>
+#include <FilterRegistry.hpp>
 #include <Framebuffer.hpp>
 #include <Histogram.hpp>
 #include <Image.hpp>
+#include <ImageCache.hpp>
+#include <ImagePyramid.hpp>
+#include <Minutiae.hpp>
+#include <Morphology.hpp>
+#include <OrientationField.hpp>
+#include <RidgeGraph.hpp>
+#include <SaveQueue.hpp>
 #include <Quad.hpp>
 #include <Shader.hpp>
 #include <Texture2D.hpp>
+#include <Thinning.hpp>
 #include <Window.hpp>
 #include <config.hpp>
 
@@ -33,9 +53,25 @@
 using namespace bm;
 
 constexpr i64 MAX_ALG_DESCRIPTOR_SIZE{4096};
+// per frame part of descriptor ring, room for a few passes worth of descriptors
+constexpr std::size_t ALG_DESCRIPTOR_RING_REGION_SIZE{16 * static_cast<std::size_t>(MAX_ALG_DESCRIPTOR_SIZE)};
 
 constexpr std::string_view DEFAULT_ASSET_IMAGE_PATH{"assets/textures/Bikesgray.jpg"};
 
+constexpr std::size_t DEFAULT_IMAGE_CACHE_BUDGET_MB{256};
+constexpr std::size_t IMAGE_CACHE_WORKERS_NUM{2};
+
+constexpr std::size_t SAVE_QUEUE_WORKERS_NUM{2};
+constexpr std::size_t SAVE_QUEUE_MAX_IN_FLIGHT{4};
+
+constexpr std::size_t DEFAULT_TILE_MEMORY_BUDGET_MB{64};
+// bytes of image pyramid uploaded per frame while freshly loaded image sharpens
+constexpr std::size_t PYRAMID_UPLOAD_BUDGET_MB{32};
+// thinning has no fixed radius, strokes narrower than this come out the same as untiled
+constexpr i32 TILED_THINNING_HALO{16};
+// pixels around foreground bounds CPU algorithms get as context when restricted to foreground
+constexpr i32 FOREGROUND_HALO{16};
+
 namespace ImGui {
 
 #define IMGUI_DISABLED(x)\
@@ -47,30 +83,24 @@ namespace ImGui {
 
 struct SelectablePathList {
 	int selected{0};
-	bool refresh_state{false};
 
+	// only visible rows are submitted, lists may hold whole capture folders
 	bool draw(const std::vector<fs::path> &paths, const char *list_name) {
 		bool result = false;
-		if (ImGui::IsWindowFocused()) {
-			if (!refresh_state) {
-				refresh_state = true;
-				result = true;
-			}
-		} else {
-			refresh_state = false;
-		}
-
 		if (ImGui::BeginListBox(list_name)) {
-			i32 i{0};
-			for (const auto &path : paths) {
-				const auto is_selected = i == selected;
-				if (ImGui::Selectable(path.filename().c_str(), is_selected)) {
-					selected = i;
-				}
-				++i;
-
-				if (is_selected) {
-					ImGui::SetItemDefaultFocus();
+			ImGuiListClipper clipper;
+			clipper.Begin(static_cast<int>(paths.size()));
+			while (clipper.Step()) {
+				for (i32 i{clipper.DisplayStart}; i < clipper.DisplayEnd; ++i) {
+					const auto is_selected = i == selected;
+					if (ImGui::Selectable(paths[static_cast<std::size_t>(i)].filename().string().c_str(), is_selected)) {
+						selected = i;
+						result = true;
+					}
+
+					if (is_selected) {
+						ImGui::SetItemDefaultFocus();
+					}
 				}
 			}
 
@@ -106,6 +136,14 @@ static void mouseScrollCallback(GLFWwindow *win_handle, double xoffset, double y
 static void keyCallback(GLFWwindow* win_handle, int key, int scancode, int action, int mods);
 
 int main() {
+	const auto startup_time = std::chrono::steady_clock::now();
+	// called once after first frame is presented, shader programs are created lazily
+	// (or loaded from binary cache) so this is mostly window + first used programs
+	std::function<void()> first_frame_hook = [startup_time]() {
+		const auto elapsed = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - startup_time);
+		spdlog::info("Time to first frame: {:.1f} ms", elapsed.count());
+	};
+
 	// intialize glfw3 + glad
 	Window window(
 		cmake::project_name, 640, 480,
@@ -144,7 +182,6 @@ int main() {
 	u32 quad_vbo_id{0U};
 	u32 quad_vao_id{0U};
 	u32 quad_ubo_id{0U};
-	u32 alg_descriptor_ubo_id{0U};
 
 	Shader basic_shader(Shader::Type::VERTEX_FRAGMENT,
 	{
@@ -208,24 +245,21 @@ int main() {
 
 	// create UBOs
 	glCreateBuffers(1, &quad_ubo_id);
-	glCreateBuffers(1, &alg_descriptor_ubo_id);
 	glNamedBufferStorage(
 		quad_ubo_id, sizeof(transform_data),
 		static_cast<const void *>(&transform_data),
 		GL_DYNAMIC_STORAGE_BIT
 	);
-	glNamedBufferStorage(
-		alg_descriptor_ubo_id, MAX_ALG_DESCRIPTOR_SIZE, nullptr,
-		GL_DYNAMIC_STORAGE_BIT
-	);
 	glBindBufferBase(
 		GL_UNIFORM_BUFFER, SHCONFIG_TRANSFORM_UBO_BINDING,
 		quad_ubo_id
 	);
-	glBindBufferBase(
-		GL_UNIFORM_BUFFER, SHCONFIG_ALG_DESCRIPTOR_UBO_BINDING,
-		alg_descriptor_ubo_id
-	);
+	// algorithm descriptors, every upload binds its own range of SHCONFIG_ALG_DESCRIPTOR_UBO_BINDING
+	DescriptorRing alg_descriptor_ring(SHCONFIG_ALG_DESCRIPTOR_UBO_BINDING, ALG_DESCRIPTOR_RING_REGION_SIZE);
+	// gray images are uploaded/read back as tightly packed single channel rows
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
 	// create Texture and load image
 	Image image(DEFAULT_ASSET_IMAGE_PATH);
 	Texture2D img_texture({
@@ -238,9 +272,22 @@ int main() {
 		.wrap_t = GL_REPEAT,
 		.min_filter = GL_NEAREST,
 		.mag_filter = GL_NEAREST,
-		.mipmap = false
+		.mipmap = true
 	});
-	img_texture.update(static_cast<const void *>(image.pixels.data()));
+
+	// texture stays RGBA8, image is converted only at the upload boundary. Its mip levels
+	// are built on CPU, progressive upload leaves them (with level 0) to the main loop,
+	// coarsest first, otherwise whole chain is uploaded before returning
+	ImagePyramid image_pyramid;
+	const auto upload_image_fn = [&](bool progressive = false) {
+		img_texture.config.fmt = image.format == PixelFormat::RGBA8 ? GL_RGBA : GL_RED;
+		img_texture.swizzleGray(image.format != PixelFormat::RGBA8);
+		image_pyramid.build(image);
+		if (!progressive) {
+			image_pyramid.flush(img_texture, image);
+		}
+	};
+	upload_image_fn(true);
 	img_texture.bind(SHCONFIG_2D_TEX_BINDING);
 
 	// Create texture FBO
@@ -250,6 +297,28 @@ int main() {
 		.color_attachment = GL_COLOR_ATTACHMENT0,
 		.internal_fmt = GL_RGBA8
 	});
+	// out-of-core processing, tiles are passed through their own texture/FBO pair sized to the tile
+	i32 max_texture_size{0};
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+	Texture2D tile_texture({
+		.width = 1,
+		.height = 1,
+		.internal_fmt = GL_R8,
+		.fmt = GL_RED,
+		.type = GL_UNSIGNED_BYTE,
+		.wrap_s = GL_CLAMP_TO_EDGE,
+		.wrap_t = GL_CLAMP_TO_EDGE,
+		.min_filter = GL_NEAREST,
+		.mag_filter = GL_NEAREST,
+		.mipmap = false
+	});
+	FBO tile_fbo({
+		.width = 1,
+		.height = 1,
+		.color_attachment = GL_COLOR_ATTACHMENT0,
+		.internal_fmt = GL_RGBA8
+	});
+
 	// bind
 	basic_shader.bind();
 	glBindVertexArray(quad_vao_id);
@@ -257,10 +326,7 @@ int main() {
 	// Histogram
 	Histogram histogram;
 	histogram.clear();
-	histogram.set(
-		image.pixels.data(), image.pixels.size(),
-		static_cast<std::size_t>(image.channels_num)
-	);
+	histogram.set(image);
 
 	// App algorithms
 	ThresholdBinarizationAlgorithm threshold_binarization_alg(threshold_binarization_shader);
@@ -273,52 +339,204 @@ int main() {
 	PixelizationAlgorithm pixelization_alg(pixelization_shader);
 	GlobalFillAlgorithm global_fill_algorithm(global_fill_shader);
 
+	// fingerprint analysis, stages further down the pipeline reuse fields estimated here
+	struct FingerprintDescriptor {
+		i32 block_size{16};
+		i32 smoothing_radius{1};
+		f32 ridge_period{9.F};
+		f32 min_deviation{10.F};
+		f32 min_coherence{.2F};
+		// CPU algorithms skip background blocks, GPU passes are scissored to foreground bounds
+		bool foreground_only{false};
+		// ridge_distance is taken from estimated ridge periods when extracting
+		MinutiaeFilter minutiae_filter{};
+	};
+	FingerprintDescriptor fingerprint_descriptor{};
+	OrientationField orientation_field;
+	FrequencyField frequency_field;
+	ForegroundMask foreground_mask;
+	RidgeGraph ridge_graph;
+	auto thinning_algorithm = static_cast<i32>(ThinningAlgorithm::GUO_HALL);
+	// ridge periods of frequency_field, shown next to the image as heatmap
+	std::vector<f32> ridge_periods;
+	// 500 dpi prints have ridge periods of roughly 6-12 px
+	const GaborBank gabor_bank = GaborBank::make(GaborBank::DEFAULT_ORIENTATIONS_NUM, {6.F, 8.F, 10.F, 12.F});
+	const auto estimate_ridge_fields_fn = [&] {
+		orientation_field.compute(image, fingerprint_descriptor.block_size, fingerprint_descriptor.smoothing_radius);
+		frequency_field.compute(image, orientation_field, fingerprint_descriptor.ridge_period);
+		ridge_periods.clear();
+		for (const auto frequency : frequency_field.frequency) {
+			ridge_periods.push_back(1.F / frequency);
+		}
+	};
+	// fields estimated from previous image must not steer processing of a new one
+	const auto reset_image_fields_fn = [&] {
+		orientation_field = OrientationField{};
+		frequency_field = FrequencyField{};
+		foreground_mask = ForegroundMask{};
+		ridge_periods.clear();
+		ridge_graph = RidgeGraph{};
+	};
+	const auto foreground_only_fn = [&] {
+		return fingerprint_descriptor.foreground_only && foreground_mask.matches(image);
+	};
+	const auto perform_cpu_fn = [&](const std::function<void(Image &)> &fn) {
+		if (foreground_only_fn()) {
+			performMasked(image, foreground_mask, FOREGROUND_HALO, fn);
+		} else {
+			fn(image);
+		}
+	};
+
 	const auto alg_perform_fn = [&] {
+		image_pyramid.flush(img_texture, image);
 		fbo.bind();
 		glViewport(0, 0, image.width, image.height);
-		TransformData tmp_transform_data{.quad_scale = 1.F, .flip_tex_y_axis_xor = 1};
+		TransformData tmp_transform_data{};
+		tmp_transform_data.quad_scale = 1.F;
+		tmp_transform_data.flip_tex_y_axis_xor = 1;
 		glNamedBufferSubData(
 			quad_ubo_id, 0, sizeof(tmp_transform_data),
 			static_cast<const void *>(&tmp_transform_data)
 		);
+		// background outside of foreground bounds is neither shaded nor read back
+		const auto region = foreground_only_fn() ?
+			foreground_mask.bounds : ForegroundMask::Box{0, 0, image.width, image.height};
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(region.x, region.y, region.width, region.height);
 		glDrawArrays(GL_TRIANGLES, 0, QUAD_VERTICES.size());
-
-		glReadPixels(
-			0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE,
-			static_cast<void *>(image.pixels.data())
-		);
+		glDisable(GL_SCISSOR_TEST);
+
+		if (image.format != PixelFormat::RGBA8) {
+			// colour shaders (gradient convolution, global fill) write G/B too, so whole
+			// RGBA is read back and stored like CPU conversion does, i.e. as mean of RGB
+			Image readback(region.width, region.height, PixelFormat::RGBA8);
+			glReadPixels(
+				region.x, region.y, region.width, region.height, GL_RGBA, GL_UNSIGNED_BYTE,
+				static_cast<void *>(readback.pixels.data())
+			);
+			visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+				for (i32 y{0}; y < region.height; ++y) {
+					const auto *src = std::as_const(readback).row(y);
+					auto *dst = image.row(region.y + y);
+					for (i32 x{0}; x < region.width; ++x) {
+						PixelTraits<F>::store(dst, region.x + x, PixelTraits<PixelFormat::RGBA8>::load(src, x));
+					}
+				}
+			});
+		} else {
+			// rows are read straight into image, region is only part of them
+			glPixelStorei(GL_PACK_ROW_LENGTH, image.width);
+			glReadPixels(
+				region.x, region.y, region.width, region.height, GL_RGBA, GL_UNSIGNED_BYTE,
+				static_cast<void *>(image.row(region.y) + static_cast<std::size_t>(region.x * image.channels_num))
+			);
+			glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+		}
 		glCopyTextureSubImage2D(
-			img_texture.tex_id_, 0, 0, 0, 0, 0, 
-			image.width, image.height
+			img_texture.tex_id_, 0, region.x, region.y, region.x, region.y,
+			region.width, region.height
 		);
+		image_pyramid.regenerate(img_texture);
 
 		fbo.unbind();
 	};
 
+	// same as alg_perform_fn but for GRAY8 tile of TiledImage, currently bound shader is used
+	PixelBuffer tile_readback;
+	const auto tile_perform_fn = [&](Image &tile) {
+		if (tile_texture.config.width != tile.width || tile_texture.config.height != tile.height) {
+			tile_texture.resize(tile.width, tile.height);
+			tile_texture.swizzleGray(true);
+			tile_fbo.resize(tile.width, tile.height);
+		}
+		tile_texture.update(tile.pixels.data());
+		tile_texture.bind(SHCONFIG_2D_TEX_BINDING);
+
+		tile_fbo.bind();
+		glViewport(0, 0, tile.width, tile.height);
+		TransformData tmp_transform_data{};
+		tmp_transform_data.quad_scale = 1.F;
+		tmp_transform_data.flip_tex_y_axis_xor = 1;
+		glNamedBufferSubData(
+			quad_ubo_id, 0, sizeof(tmp_transform_data),
+			static_cast<const void *>(&tmp_transform_data)
+		);
+		glDrawArrays(GL_TRIANGLES, 0, QUAD_VERTICES.size());
+		// RGBA is read back for colour shaders, see alg_perform_fn
+		tile_readback.resize(static_cast<std::size_t>(tile.width) * static_cast<std::size_t>(tile.height) * 4);
+		glReadPixels(
+			0, 0, tile.width, tile.height, GL_RGBA, GL_UNSIGNED_BYTE,
+			static_cast<void *>(tile_readback.data())
+		);
+		// tile rows are contiguous, whole tile is one row of GRAY8 pixels
+		const auto *src = std::as_const(tile_readback).data();
+		auto *dst = tile.pixels.data();
+		for (i32 i{0}; i < tile.width * tile.height; ++i) {
+			PixelTraits<PixelFormat::GRAY8>::store(dst, i, PixelTraits<PixelFormat::RGBA8>::load(src, i));
+		}
+		tile_fbo.unbind();
+
+		img_texture.bind(SHCONFIG_2D_TEX_BINDING);
+	};
+
 	const std::function<void()> submit_binarization_data_fn = [&] {
-		threshold_binarization_alg.continuousSubmit(alg_descriptor_ubo_id);
+		threshold_binarization_alg.continuousSubmit(alg_descriptor_ring);
 	};
 	const std::function<void()> submit_stretching_data_fn = [&] {
-		stretching_alg.continuousSubmit(alg_descriptor_ubo_id);
+		stretching_alg.continuousSubmit(alg_descriptor_ring);
 	};
 	const std::function<void()> submit_equalization_data_fn = [&] {
-		equalization_alg.continuousSubmit(alg_descriptor_ubo_id);
+		equalization_alg.continuousSubmit(alg_descriptor_ring);
 	};
 	const std::function<void()> submit_local_binarization_data_fn = [&] {
-		local_binarization_alg.continuousSubmit(alg_descriptor_ubo_id);
+		local_binarization_alg.continuousSubmit(alg_descriptor_ring);
 	};
 	const std::function<void()> *submit_current_alg_data_fn = nullptr;
 
 	// dir managers
-	DirManager assets_dir_manager("assets/textures", {".png", ".jpg", "jpeg"});
-	DirManager filters_dir_manager("assets/filters", {".ftr"});
+	DirManager assets_dir_manager("assets/textures", {".png", ".jpg", ".jpeg", ".pgm", ".pbm", ".raw"});
+	// filters are parsed once and reloaded in background, list is re-read when registry changes
+	FilterRegistry filter_registry("assets/filters", ConvolutionDescriptor::MAX_KERNEL_SIZE);
+	u64 filters_generation{0};
+	std::vector<std::shared_ptr<const Filter>> filters;
+	std::vector<fs::path> filter_paths;
+
+	// decoded images cache, neighbours of selected asset are prefetched in background
+	ImageCache image_cache(DEFAULT_IMAGE_CACHE_BUDGET_MB << 20U, IMAGE_CACHE_WORKERS_NUM);
+	i32 image_cache_budget_mb{static_cast<i32>(DEFAULT_IMAGE_CACHE_BUDGET_MB)};
+	i32 prefetched_asset_index{-1};
+
+	// images are encoded and written in background, callbacks run in poll() below
+	SaveQueue save_queue(SAVE_QUEUE_WORKERS_NUM, SAVE_QUEUE_MAX_IN_FLIGHT);
+	SaveOptions save_options{};
+	const SaveQueue::Callback on_saved_fn = [](const fs::path &path, bool success) {
+		if (success) {
+			spdlog::info("Saved {}", path.string());
+		}
+	};
 
 	// imgui selectable lists
 	ImGui::SelectablePathList selectable_assets_list;
 	ImGui::SelectablePathList selectable_filter_list;
+	// selection follows its file when assets index changes or is re-sorted
+	const auto selected_asset_path_fn = [&] {
+		const auto index = static_cast<std::size_t>(selectable_assets_list.selected);
+		return index < assets_dir_manager.files.size() ? assets_dir_manager.files[index] : fs::path();
+	};
+	const auto follow_selected_asset_fn = [&](const fs::path &selected_path) {
+		const auto &files = assets_dir_manager.files;
+		const auto it = std::find(files.begin(), files.end(), selected_path);
+		selectable_assets_list.selected = it != files.end() ? static_cast<int>(it - files.begin()) : 0;
+		prefetched_asset_index = -1;
+	};
+	const auto selected_filter_fn = [&]() -> std::shared_ptr<const Filter> {
+		const auto index = static_cast<std::size_t>(selectable_filter_list.selected);
+		return index < filters.size() ? filters[index] : nullptr;
+	};
 
 	// window visibility logic artifacts
-	constexpr std::size_t WINDOWS_COUNT{13};
+	constexpr std::size_t WINDOWS_COUNT{15};
 	enum WIN_TYPE : std::size_t {
 		THRESHOLD_BINARIZATION,
 		LOCAL_BINARIZATION,
@@ -327,12 +545,14 @@ int main() {
 		EQUALIZATION,
 		CONVOLUTION,
 		MEDIAN_FILTER,
+		MORPHOLOGY,
 		PIXELIZATION,
 		IMAGE_DATA_DETAILS,
 		CONFIG,
 		ASSETS,
 		DRAWING,
-		FILL
+		FILL,
+		TILED_PROCESSING
 	};
 	std::bitset<WINDOWS_COUNT> win_visibility_mask(lim<std::size_t>::max());
 
@@ -342,9 +562,34 @@ int main() {
 	    f32 color[4] = { 0.F, 0.F, 0.F, 1.F };
 		bool draw_mode{ false };
 		bool drawing{ false };
+		// strokes only go to texture's level 0, rest of mip chain is regenerated after draw mode
+		bool strokes_drawn{ false };
 	};
 	DrawingDescriptor drawing_descriptor{};
 
+	struct TiledProcessingDescriptor {
+		enum : i32 { LOCAL_BINARIZATION, CONVOLUTION, MEDIAN_FILTER, MORPHOLOGY, K3M_SKELETONIZATION };
+
+		i32 algorithm{LOCAL_BINARIZATION};
+		i32 memory_budget_mb{static_cast<i32>(DEFAULT_TILE_MEMORY_BUDGET_MB)};
+	};
+	TiledProcessingDescriptor tiled_processing_descriptor{};
+
+	struct MorphologyDescriptor {
+		i32 operation{static_cast<i32>(MorphologyOperation::CLOSE)};
+		StructuringElement element{};
+		// distance transform measures distance to these pixels
+		i32 distance_to{static_cast<i32>(DistanceTo::BACKGROUND)};
+
+		// opening and closing pass image through element twice
+		[[nodiscard]] i32 halo() const {
+			const auto passes = operation == static_cast<i32>(MorphologyOperation::OPEN) ||
+				operation == static_cast<i32>(MorphologyOperation::CLOSE) ? 2 : 1;
+			return passes * std::max(element.radius_x, element.radius_y);
+		}
+	};
+	MorphologyDescriptor morphology_descriptor{};
+
 	struct FillDescriptor {
 		i32 max_px_count{ 1 };
 		bool all_px{ true };
@@ -360,68 +605,71 @@ int main() {
 	FillDescriptor fill_descriptor{};
 
 	const auto fill_fn = [&](i32 start_x, i32 start_y) {
-		struct Position { i32 x; i32 y; };
-
-		const auto root_px_color_index = start_x + start_y * image.width;
-		u8* root_px_color = &image.pixels[static_cast<std::size_t>(image.channels_num * root_px_color_index)];
-
-		const auto r_min = static_cast<u8>(std::clamp(static_cast<i32>(root_px_color[0]) - fill_descriptor.r_px_distance[0], 0, 255));
-		const auto r_max = static_cast<u8>(std::clamp(static_cast<i32>(root_px_color[0]) + fill_descriptor.r_px_distance[1], 0, 255));
-		const auto g_min = static_cast<u8>(std::clamp(static_cast<i32>(root_px_color[1]) - fill_descriptor.g_px_distance[0], 0, 255));
-		const auto g_max = static_cast<u8>(std::clamp(static_cast<i32>(root_px_color[1]) + fill_descriptor.g_px_distance[1], 0, 255));
-		const auto b_min = static_cast<u8>(std::clamp(static_cast<i32>(root_px_color[2]) - fill_descriptor.b_px_distance[0], 0, 255));
-		const auto b_max = static_cast<u8>(std::clamp(static_cast<i32>(root_px_color[2]) + fill_descriptor.b_px_distance[1], 0, 255));
-
-		const u8 color[] = { 
-			static_cast<u8>(fill_descriptor.color[0] * 255.F),
-			static_cast<u8>(fill_descriptor.color[1] * 255.F),
-			static_cast<u8>(fill_descriptor.color[2] * 255.F),
-		};
-
-		std::memcpy(static_cast<void*>(root_px_color), static_cast<const void*>(color), sizeof(color));
-
-		std::stack<Position> call_stack;
-		call_stack.push(Position{start_x, start_y});
-
-		const auto bitset_size = ((image.width * image.height)/64) + static_cast<i32>(((image.width * image.height)%64) != 0);
-		std::vector<u64> visited(static_cast<std::size_t>(bitset_size), 0UL);
-
-		i32 px_counter{ 0 };
-		std::array<Position, 4> base_offsets{{{-1, 0}, {1, 0}, {0, -1}, {0, 1}}};
-		while (!call_stack.empty()) {
-			if (!fill_descriptor.all_px) {
-				if (px_counter > fill_descriptor.max_px_count) {
-					return;
-				} 
-				++px_counter;
-			}
-
-			const Position position = call_stack.top();
-			call_stack.pop();
-			for (const auto offset : base_offsets) {
-				const auto next_position = Position{position.x + offset.x, position.y + offset.y};
-				if (next_position.x < 0 || next_position.x >= image.width || 
-					next_position.y < 0 || next_position.y >= image.height) {
-					continue;
+		visitFormat(image.format, [&]<PixelFormat F>(FormatTag<F>) {
+			struct Position { i32 x; i32 y; };
+			using Traits = PixelTraits<F>;
+
+			const auto root_px_color = Traits::load(image.row(start_y), start_x);
+
+			const auto r_min = static_cast<u8>(std::clamp(static_cast<i32>(root_px_color.r) - fill_descriptor.r_px_distance[0], 0, 255));
+			const auto r_max = static_cast<u8>(std::clamp(static_cast<i32>(root_px_color.r) + fill_descriptor.r_px_distance[1], 0, 255));
+			const auto g_min = static_cast<u8>(std::clamp(static_cast<i32>(root_px_color.g) - fill_descriptor.g_px_distance[0], 0, 255));
+			const auto g_max = static_cast<u8>(std::clamp(static_cast<i32>(root_px_color.g) + fill_descriptor.g_px_distance[1], 0, 255));
+			const auto b_min = static_cast<u8>(std::clamp(static_cast<i32>(root_px_color.b) - fill_descriptor.b_px_distance[0], 0, 255));
+			const auto b_max = static_cast<u8>(std::clamp(static_cast<i32>(root_px_color.b) + fill_descriptor.b_px_distance[1], 0, 255));
+
+			const Pixel<u8> color{
+				static_cast<u8>(fill_descriptor.color[0] * 255.F),
+				static_cast<u8>(fill_descriptor.color[1] * 255.F),
+				static_cast<u8>(fill_descriptor.color[2] * 255.F),
+			};
+
+			Traits::store(image.row(start_y), start_x, color);
+
+			std::stack<Position> call_stack;
+			call_stack.push(Position{start_x, start_y});
+
+			const auto bitset_size = ((image.width * image.height)/64) + static_cast<i32>(((image.width * image.height)%64) != 0);
+			std::vector<u64> visited(static_cast<std::size_t>(bitset_size), 0UL);
+
+			i32 px_counter{ 0 };
+			std::array<Position, 4> base_offsets{{{-1, 0}, {1, 0}, {0, -1}, {0, 1}}};
+			while (!call_stack.empty()) {
+				if (!fill_descriptor.all_px) {
+					if (px_counter > fill_descriptor.max_px_count) {
+						return;
+					} 
+					++px_counter;
 				}
 
-				const auto px_index = next_position.x + next_position.y * image.width;
-				if ((visited[px_index / 64] & (1UL << (px_index % 64))) > 0) {
-					continue;
-				}
-
-				u8* px_color = &image.pixels[static_cast<std::size_t>(px_index * image.channels_num)];
-
-				const auto is_in_r_bounds = (px_color[0] >= r_min && px_color[0] <= r_max);
-				const auto is_in_g_bounds = (px_color[1] >= g_min && px_color[1] <= g_max);
-				const auto is_in_b_bounds = (px_color[2] >= b_min && px_color[2] <= b_max);
-				if (is_in_r_bounds && is_in_g_bounds && is_in_b_bounds) {
-					std::memcpy(static_cast<void*>(px_color), static_cast<const void*>(color), sizeof(color));
-					call_stack.push(next_position);
-					visited[px_index / 64] |= (1UL << (px_index % 64));
+				const Position position = call_stack.top();
+				call_stack.pop();
+				for (const auto offset : base_offsets) {
+					const auto next_position = Position{position.x + offset.x, position.y + offset.y};
+					if (next_position.x < 0 || next_position.x >= image.width || 
+						next_position.y < 0 || next_position.y >= image.height) {
+						continue;
+					}
+
+					const auto px_index = next_position.x + next_position.y * image.width;
+					if ((visited[px_index / 64] & (1UL << (px_index % 64))) > 0) {
+						continue;
+					}
+
+					u8* row = image.row(next_position.y);
+					const auto px_color = Traits::load(row, next_position.x);
+
+					const auto is_in_r_bounds = (px_color.r >= r_min && px_color.r <= r_max);
+					const auto is_in_g_bounds = (px_color.g >= g_min && px_color.g <= g_max);
+					const auto is_in_b_bounds = (px_color.b >= b_min && px_color.b <= b_max);
+					if (is_in_r_bounds && is_in_g_bounds && is_in_b_bounds) {
+						Traits::store(row, next_position.x, color);
+						call_stack.push(next_position);
+						visited[px_index / 64] |= (1UL << (px_index % 64));
+					}
 				}
 			}
-		}
+		});
 	};
 
 	// Window data	
@@ -440,6 +688,19 @@ int main() {
 	// main loop
 	while (!window.shouldClose()) {
 		window.pollEvents();
+		alg_descriptor_ring.beginFrame();
+		image_pyramid.upload(img_texture, image, PYRAMID_UPLOAD_BUDGET_MB << 20U);
+		if (filters_generation != filter_registry.generation) {
+			filters = filter_registry.snapshot(filters_generation);
+			filter_paths.clear();
+			for (const auto &filter : filters) {
+				filter_paths.push_back(filter->path);
+			}
+		}
+		// polled every frame, tiled processing and thinning benchmark read files while Assets window is hidden
+		if (const auto selected_path = selected_asset_path_fn(); assets_dir_manager.poll()) {
+			follow_selected_asset_fn(selected_path);
+		}
 
 		const auto [width, height] = window.size();
 		glViewport(0, 0, width, height);
@@ -461,7 +722,11 @@ int main() {
 		}
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		// zoomed out image is sampled from the level closest to one texel per pixel
+		const auto texels_per_px = static_cast<f32>(image.width) / (transform_data.quad_scale * static_cast<f32>(width));
+		img_texture.baseLevel(drawing_descriptor.draw_mode ? 0 : image_pyramid.selectLevel(texels_per_px));
 		glDrawArrays(GL_TRIANGLES, 0, QUAD_VERTICES.size());
+		img_texture.baseLevel(0);
 
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
@@ -478,21 +743,160 @@ int main() {
 		{
 			ImGui::Begin("Skeletonization");
 
-			if (ImGui::Button("Perform KMM")) {
-				performKMMSkeletonization(static_cast<void*>(image.pixels.data()), image.width, image.height, image.channels_num);
-				img_texture.update(static_cast<void*>(image.pixels.data()));
-				glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+			for (const auto &thinner : thinners()) {
+				ImGui::RadioButton(thinner.name, &thinning_algorithm, static_cast<i32>(thinner.algorithm));
+				ImGui::SameLine();
+				ImGui::TextDisabled("%s", thinner.description);
 			}
-			if (ImGui::Button("Perform K3M")) {
-				performK3MSkeletonization(static_cast<void*>(image.pixels.data()), image.width, image.height, image.channels_num);
-				img_texture.update(static_cast<void*>(image.pixels.data()));
+			if (ImGui::Button("Perform thinning")) {
+				const auto &selected_thinner = thinner(static_cast<ThinningAlgorithm>(thinning_algorithm));
+				const auto start = std::chrono::steady_clock::now();
+				perform_cpu_fn(selected_thinner.perform);
+				spdlog::info("{} thinning took {:.1f} ms", selected_thinner.name,
+					std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count());
+				upload_image_fn();
 				glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
 			}
+			ImGui::SameLine();
+			if (ImGui::Button("Benchmark on fingerprint assets")) {
+				std::vector<ThinningBenchmarkRow> rows;
+				for (const auto &path : assets_dir_manager.files) {
+					// FVC prints are named <finger>_<impression>
+					const auto stem = path.stem().string();
+					const auto fingerprint = std::ranges::count(stem, '_') == 1 &&
+						std::ranges::all_of(stem, [](char c) { return c == '_' || (c >= '0' && c <= '9'); });
+					if (!fingerprint) {
+						continue;
+					}
+					Image binarized(path);
+					if (binarized.pixels.empty()) {
+						continue;
+					}
+					performAdaptiveOtsu(binarized, otsu_binarization_alg.tile_size);
+					for (const auto &candidate : thinners()) {
+						const auto stats = measureThinning(binarized, candidate);
+						spdlog::info("{} {}: {:.1f} ms, {} ridge px, {} redundant px, {} endings, {} bifurcations",
+							path.filename().string(), candidate.name, stats.milliseconds, stats.ridge_pixels,
+							stats.redundant_pixels, stats.endings, stats.bifurcations);
+						rows.push_back({path, candidate.algorithm, stats});
+					}
+				}
+				if (rows.empty()) {
+					spdlog::warn("No fingerprint assets to benchmark thinning on");
+				} else if (writeThinningBenchmark("thinning_benchmark.csv", rows)) {
+					spdlog::info("Thinning benchmark written to thinning_benchmark.csv");
+				}
+			}
 			if (ImGui::Button("Perform crossing number")) {
-				performCrossingNumber(static_cast<void*>(image.pixels.data()), image.width, image.height, image.channels_num, "tmp.txt");
-				img_texture.update(static_cast<void*>(image.pixels.data()));
+				perform_cpu_fn([](Image &img) { performCrossingNumber(img, "tmp.txt"); });
+				upload_image_fn();
+				glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+			}
+			ImGui::End();
+		}
+
+		{
+			ImGui::Begin("Fingerprint");
+
+			ImGui::SliderInt("Block size", &fingerprint_descriptor.block_size, 4, 64);
+			ImGui::SliderInt("Orientation smoothing [blocks]", &fingerprint_descriptor.smoothing_radius, 0, 4);
+			if (ImGui::Button("Estimate orientation field")) {
+				const auto start = std::chrono::steady_clock::now();
+				orientation_field.compute(image, fingerprint_descriptor.block_size, fingerprint_descriptor.smoothing_radius);
+				spdlog::info("Orientation field of {}x{} blocks estimated in {:.1f} ms",
+					orientation_field.blocks_x, orientation_field.blocks_y,
+					std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count());
+			}
+			if (!orientation_field.empty()) {
+				ImGui::SameLine();
+				if (ImGui::Button("Draw orientation field")) {
+					drawOrientationField(image, orientation_field);
+					upload_image_fn();
+					glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+				}
+			}
+			ImGui::Separator();
+			ImGui::SliderFloat("Min block deviation", &fingerprint_descriptor.min_deviation, 0.F, 64.F);
+			ImGui::SliderFloat("Min block coherence", &fingerprint_descriptor.min_coherence, 0.F, 1.F);
+			if (ImGui::Button("Segment foreground")) {
+				orientation_field.compute(image, fingerprint_descriptor.block_size, fingerprint_descriptor.smoothing_radius);
+				foreground_mask.compute(image, orientation_field, fingerprint_descriptor.min_deviation, fingerprint_descriptor.min_coherence);
+				spdlog::info("Foreground covers {:.1f}% of blocks, bounds {}x{} at ({}, {})",
+					100.F * foreground_mask.coverage(), foreground_mask.bounds.width, foreground_mask.bounds.height,
+					foreground_mask.bounds.x, foreground_mask.bounds.y);
+			}
+			if (foreground_mask.matches(image)) {
+				ImGui::SameLine();
+				ImGui::Checkbox("Process foreground only", &fingerprint_descriptor.foreground_only);
+				if (ImGui::IsItemHovered()) {
+					ImGui::SetTooltip("CPU algorithms and fragment shader passes only, pixelization compute pass always covers whole image");
+				}
+			}
+			ImGui::Separator();
+			ImGui::SliderFloat("Default ridge period [px]", &fingerprint_descriptor.ridge_period, FrequencyField::MIN_PERIOD, FrequencyField::MAX_PERIOD);
+			if (ImGui::Button("Estimate ridge frequency")) {
+				const auto start = std::chrono::steady_clock::now();
+				estimate_ridge_fields_fn();
+				const auto measured_num = std::count(frequency_field.measured.begin(), frequency_field.measured.end(), 1U);
+				spdlog::info("Ridge frequency estimated in {:.1f} ms, {} of {} blocks measured",
+					std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count(),
+					measured_num, frequency_field.measured.size());
+			}
+			if (!ridge_periods.empty() && ImPlot::BeginPlot("Ridge period [px]", nullptr, nullptr, ImVec2{-1.F, 300.F})) {
+				ImPlot::PlotHeatmap(
+					"period", ridge_periods.data(), frequency_field.blocks_y, frequency_field.blocks_x,
+					static_cast<f64>(FrequencyField::MIN_PERIOD), 16., nullptr
+				);
+				ImPlot::EndPlot();
+			}
+			if (ImGui::Button("Perform Gabor enhancement")) {
+				// fields are re-estimated so they always belong to current image
+				const auto start = std::chrono::steady_clock::now();
+				estimate_ridge_fields_fn();
+				performGaborEnhancement(image, orientation_field, frequency_field, gabor_bank,
+					foreground_only_fn() ? &foreground_mask : nullptr);
+				spdlog::info("Gabor enhancement of {}x{} image took {:.1f} ms", image.width, image.height,
+					std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count());
+				upload_image_fn();
 				glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
 			}
+			ImGui::Separator();
+			ImGui::SliderInt("Border distance [px]", &fingerprint_descriptor.minutiae_filter.border_distance, 0, 64);
+			ImGui::SliderInt("Max spur length [px]", &fingerprint_descriptor.minutiae_filter.max_spur_length, 0, 32);
+			if (ImGui::Button("Extract minutiae")) {
+				// image is expected to be skeleton, ridge periods were estimated before thinning
+				auto &filter = fingerprint_descriptor.minutiae_filter;
+				filter.ridge_distance = ridge_periods.empty() ? fingerprint_descriptor.ridge_period :
+					std::accumulate(ridge_periods.begin(), ridge_periods.end(), 0.F) / static_cast<f32>(ridge_periods.size());
+				const auto start = std::chrono::steady_clock::now();
+				MinutiaeStats stats;
+				const auto minutiae = removeFalseMinutiae(detectMinutiae(image), image, filter,
+					foreground_mask.matches(image) ? &foreground_mask : nullptr, stats);
+				spdlog::info("{} of {} minutiae kept in {:.1f} ms, removed {} at border, {} spurs, {} close pairs",
+					minutiae.size(), stats.detected,
+					std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count(),
+					stats.border, stats.spurs, stats.pairs);
+				writeMinutiae("tmp.txt", minutiae, stats);
+				drawMinutiae(image, minutiae);
+				upload_image_fn();
+				glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+			}
+			if (ImGui::Button("Trace ridge graph")) {
+				const auto start = std::chrono::steady_clock::now();
+				ridge_graph.build(image);
+				spdlog::info("Ridge graph of {} nodes and {} edges traced in {:.1f} ms, {} B instead of {} B of pixels",
+					ridge_graph.nodes.size(), ridge_graph.edges.size(),
+					std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count(),
+					ridge_graph.bytes(), image.pixels.size());
+			}
+			if (!ridge_graph.empty()) {
+				ImGui::SameLine();
+				if (ImGui::Button("Draw ridge graph")) {
+					drawRidgeGraph(image, ridge_graph);
+					upload_image_fn();
+					glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+				}
+			}
 			ImGui::End();
 		}
 
@@ -520,7 +924,7 @@ int main() {
 				}
 			}
 			if (ImGui::Button("Perform single##0")) {
-				threshold_binarization_alg.submit(alg_descriptor_ubo_id);
+				threshold_binarization_alg.submit(alg_descriptor_ring);
 				threshold_binarization_alg.shader.bind();
 				alg_perform_fn();
 				basic_shader.bind();
@@ -535,7 +939,7 @@ int main() {
 				} else {
 					win_visibility_mask.set();
 
-					threshold_binarization_alg.submit(alg_descriptor_ubo_id);
+					threshold_binarization_alg.submit(alg_descriptor_ring);
 					threshold_binarization_alg.shader.bind();
 					alg_perform_fn();
 					basic_shader.bind();
@@ -548,14 +952,22 @@ int main() {
 		if (win_visibility_mask[WIN_TYPE::OTSU_BINARIZATION]) {
 			ImGui::Begin("Otsu binarization");
 			IMGUI_DISABLED(ImGui::SliderFloat("threshold", &otsu_binarization_alg.descriptor.threshold, 0.F, 1.F));
+			ImGui::Checkbox("Adaptive (per tile)", &otsu_binarization_alg.adaptive);
+			ImGui::SliderInt("Tile size [px]", &otsu_binarization_alg.tile_size, 8, 512);
 			if (ImGui::Button("Perform")) {
-				histogram.clear();
-				histogram.set(image.pixels.data(), image.pixels.size(), static_cast<std::size_t>(image.channels_num));
-				otsu_binarization_alg.prepare(histogram);
-				otsu_binarization_alg.submit(alg_descriptor_ubo_id);
-				otsu_binarization_alg.shader.bind();
-				alg_perform_fn();
-				basic_shader.bind();
+				if (otsu_binarization_alg.adaptive) {
+					perform_cpu_fn([&](Image &img) { performAdaptiveOtsu(img, otsu_binarization_alg.tile_size); });
+					upload_image_fn();
+					glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+				} else {
+					histogram.clear();
+					histogram.set(image);
+					otsu_binarization_alg.prepare(histogram);
+					otsu_binarization_alg.submit(alg_descriptor_ring);
+					otsu_binarization_alg.shader.bind();
+					alg_perform_fn();
+					basic_shader.bind();
+				}
 			}
 			ImGui::End();
 		}
@@ -563,9 +975,19 @@ int main() {
 		if (win_visibility_mask[WIN_TYPE::STRETCHING]) {
 			ImGui::Begin("Stretching");
 			ImGui::SliderFloat3("global max", stretching_alg.descriptor.global_max, 0.F, 1.F);
+			auto clip_changed = ImGui::SliderFloat("low clip", &stretching_alg.low_clip, 0.F, .5F);
+			clip_changed = ImGui::SliderFloat("high clip", &stretching_alg.high_clip, .5F, 1.F) || clip_changed;
+			// continuous pass uploads descriptor every frame, clipped bounds have to follow sliders
+			if (clip_changed && submit_current_alg_data_fn == &submit_stretching_data_fn) {
+				histogram.clear();
+				histogram.set(image);
+				stretching_alg.prepare(histogram);
+			}
 			if (ImGui::Button("Perform single##1")) {
-				stretching_alg.prepare(image);
-				stretching_alg.submit(alg_descriptor_ubo_id);
+				histogram.clear();
+				histogram.set(image);
+				stretching_alg.prepare(histogram);
+				stretching_alg.submit(alg_descriptor_ring);
 
 				stretching_alg.shader.bind();
 				alg_perform_fn();
@@ -576,13 +998,15 @@ int main() {
 					win_visibility_mask.reset();
 					win_visibility_mask.set(WIN_TYPE::STRETCHING);
 
-					stretching_alg.prepare(image);
+					histogram.clear();
+					histogram.set(image);
+					stretching_alg.prepare(histogram);
 					submit_current_alg_data_fn = &submit_stretching_data_fn;
 					stretching_shader.bind();
 				} else {
 					win_visibility_mask.set();
 
-					stretching_alg.submit(alg_descriptor_ubo_id);
+					stretching_alg.submit(alg_descriptor_ring);
 					stretching_alg.shader.bind();
 					alg_perform_fn();
 					basic_shader.bind();
@@ -595,17 +1019,26 @@ int main() {
 		if (win_visibility_mask[WIN_TYPE::EQUALIZATION]) {
 			ImGui::Begin("Equalization");
 			ImGui::SliderInt("range", &equalization_alg.descriptor.range, 1, 256);
+			ImGui::Checkbox("Adaptive (CLAHE)", &equalization_alg.adaptive);
+			ImGui::SliderInt("Tile size [px]##2", &equalization_alg.tile_size, 8, 512);
+			ImGui::SliderFloat("Clip limit", &equalization_alg.clip_limit, 1.F, 16.F);
 			if (ImGui::Button("Perform single##2")) {
-				histogram.clear();
-				histogram.set(image.pixels.data(), image.pixels.size(), static_cast<std::size_t>(image.channels_num));
-				equalization_alg.prepare(histogram);
-				equalization_alg.submit(alg_descriptor_ubo_id);
+				if (equalization_alg.adaptive) {
+					perform_cpu_fn([&](Image &img) { performCLAHE(img, equalization_alg.tile_size, equalization_alg.clip_limit); });
+					upload_image_fn();
+					glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+				} else {
+					histogram.clear();
+					histogram.set(image);
+					equalization_alg.prepare(histogram);
+					equalization_alg.submit(alg_descriptor_ring);
 
-				equalization_alg.shader.bind();
+					equalization_alg.shader.bind();
 
-				alg_perform_fn();
+					alg_perform_fn();
 
-				basic_shader.bind();
+					basic_shader.bind();
+				}
 			}
 			if (static bool state = false; ImGui::Checkbox("Perform continuously##2", &state)) {
 				if (state) {
@@ -613,9 +1046,9 @@ int main() {
 					win_visibility_mask.set(WIN_TYPE::EQUALIZATION);
 
 					histogram.clear();
-					histogram.set(image.pixels.data(), image.pixels.size(), static_cast<std::size_t>(image.channels_num));
+					histogram.set(image);
 					equalization_alg.prepare(histogram);
-					equalization_alg.submit(alg_descriptor_ubo_id);
+					equalization_alg.submit(alg_descriptor_ring);
 
 					equalization_alg.shader.bind();
 
@@ -678,8 +1111,8 @@ int main() {
 			}
 			ImGui::Separator();
 			if (ImGui::Button("Perform single##3")) {
-				local_binarization_alg.submit(alg_descriptor_ubo_id);
-				local_binarization_alg.shader.bind();
+				local_binarization_alg.submit(alg_descriptor_ring);
+				local_binarization_alg.bindVariant();
 
 				alg_perform_fn();
 
@@ -690,14 +1123,15 @@ int main() {
 					win_visibility_mask.reset();
 					win_visibility_mask.set(WIN_TYPE::LOCAL_BINARIZATION);
 
-					local_binarization_alg.submit(alg_descriptor_ubo_id);
+					local_binarization_alg.submit(alg_descriptor_ring);
+					// generic program reads kernel size from descriptor, so slider takes effect every frame
 					local_binarization_alg.shader.bind();
 
 					submit_current_alg_data_fn = &submit_local_binarization_data_fn;
 				} else {
 					win_visibility_mask.set();
 
-					local_binarization_alg.shader.bind();
+					local_binarization_alg.bindVariant();
 					alg_perform_fn();
 					basic_shader.bind();
 					submit_current_alg_data_fn = nullptr;
@@ -708,21 +1142,24 @@ int main() {
 
 		if (win_visibility_mask[WIN_TYPE::CONVOLUTION]) {
 			ImGui::Begin("Convolution");
-			IMGUI_DISABLED(ImGui::SliderInt("Kernel size", &convolution_alg.descriptor.kernel_size, 0, 10));
+			ImGui::Text("Kernel size: %d, engine: %s", convolution_alg.descriptor.kernel_size, engineName(convolution_alg.engine));
 			ImGui::Checkbox("Grayscale", &convolution_alg.descriptor.gray_scale);
 			ImGui::Checkbox("Gradient", &convolution_alg.descriptor.gradient);
-			if (selectable_filter_list.draw(filters_dir_manager.files, "Available filters")) {
-				filters_dir_manager.refresh();
-			}
+			selectable_filter_list.draw(filter_paths, "Available filters");
 			if (ImGui::Button("Convolve using selected filter")) {
-				const auto filter_path_index = static_cast<std::size_t>(selectable_filter_list.selected);
-				convolution_alg.prepare(filters_dir_manager.files[filter_path_index]);
-				convolution_alg.submit(alg_descriptor_ubo_id);
-				convolution_alg.shader.bind();
+				convolution_alg.prepare(selected_filter_fn());
+				if (convolution_alg.engine == ConvolutionEngine::DIRECT) {
+					convolution_alg.submit(alg_descriptor_ring);
+					convolution_alg.bindVariant();
 
-				alg_perform_fn();
+					alg_perform_fn();
 
-				basic_shader.bind();
+					basic_shader.bind();
+				} else {
+					perform_cpu_fn([&](Image &img) { convolution_alg.perform(img); });
+					upload_image_fn();
+					glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+				}
 			}
 			ImGui::End();
 		}
@@ -731,8 +1168,8 @@ int main() {
 			ImGui::Begin("Median filter");
 			ImGui::SliderInt("Kernel size", &median_filter_alg.descriptor.kernel_size, 1, 3);
 			if (ImGui::Button("Perform single##4")) {
-				median_filter_alg.submit(alg_descriptor_ubo_id);
-				median_filter_alg.shader.bind();
+				median_filter_alg.submit(alg_descriptor_ring);
+				median_filter_alg.bindVariant();
 
 				alg_perform_fn();
 
@@ -741,12 +1178,63 @@ int main() {
 			ImGui::End();
 		}
 
+		if (win_visibility_mask[WIN_TYPE::MORPHOLOGY]) {
+			ImGui::Begin("Morphology");
+			for (const auto operation : {MorphologyOperation::ERODE, MorphologyOperation::DILATE, MorphologyOperation::OPEN, MorphologyOperation::CLOSE}) {
+				if (operation != MorphologyOperation::ERODE) {
+					ImGui::SameLine();
+				}
+				ImGui::RadioButton(morphologyName(operation), &morphology_descriptor.operation, static_cast<i32>(operation));
+			}
+			ImGui::SliderInt("Radius x", &morphology_descriptor.element.radius_x, 0, 64);
+			ImGui::SliderInt("Radius y", &morphology_descriptor.element.radius_y, 0, 64);
+			if (ImGui::Button("Perform single##5")) {
+				const auto start = std::chrono::steady_clock::now();
+				perform_cpu_fn([&](Image &img) {
+					performMorphology(img, static_cast<MorphologyOperation>(morphology_descriptor.operation), morphology_descriptor.element);
+				});
+				spdlog::info("{} of {}x{} image took {:.1f} ms",
+					morphologyName(static_cast<MorphologyOperation>(morphology_descriptor.operation)), image.width, image.height,
+					std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count());
+				upload_image_fn();
+				glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+			}
+			ImGui::Separator();
+			ImGui::RadioButton("To background", &morphology_descriptor.distance_to, static_cast<i32>(DistanceTo::BACKGROUND));
+			ImGui::SameLine();
+			ImGui::RadioButton("To ridges", &morphology_descriptor.distance_to, static_cast<i32>(DistanceTo::RIDGES));
+			if (ImGui::Button("Draw distance transform")) {
+				const auto start = std::chrono::steady_clock::now();
+				DistanceTransform transform;
+				transform.compute(image, static_cast<DistanceTo>(morphology_descriptor.distance_to));
+				const auto elapsed = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+				// measured to background, distances inside ridges reach half of ridge width
+				f64 sum{0.};
+				i64 count{0};
+				i32 largest{0};
+				for (const auto value : transform.squared) {
+					if (value > 0 && value != DistanceTransform::NONE) {
+						sum += std::sqrt(static_cast<f64>(value));
+						largest = std::max(largest, value);
+						++count;
+					}
+				}
+				spdlog::info("Distance transform took {:.1f} ms, mean distance {:.2f} px, largest {:.2f} px",
+					elapsed, count > 0 ? sum / static_cast<f64>(count) : 0., std::sqrt(static_cast<f64>(largest)));
+				drawDistanceTransform(image, transform);
+				upload_image_fn();
+				glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+			}
+			ImGui::End();
+		}
+
 		if (win_visibility_mask[WIN_TYPE::PIXELIZATION]) {
 			ImGui::Begin("Pixelization");
 			ImGui::SliderInt("Kernel size", &pixelization_alg.descriptor.kernel_size, 2, 100);
 			if (ImGui::Button("Perform single##4")) {
+				image_pyramid.flush(img_texture, image);
 				pixelization_alg.prepare(img_texture.tex_id_, SHCONFIG_COMPUTE_IMAGE_BINDING);
-				pixelization_alg.submit(alg_descriptor_ubo_id);
+				pixelization_alg.submit(alg_descriptor_ring);
 				pixelization_alg.shader.bind();
 
 				const auto kernel_size = pixelization_alg.descriptor.kernel_size;
@@ -761,6 +1249,7 @@ int main() {
 
 				glDispatchCompute(num_groups_x, num_groups_y, 1);
 				glTextureBarrier();
+				image_pyramid.regenerate(img_texture);
 
 				basic_shader.bind();
 			}
@@ -784,33 +1273,144 @@ int main() {
 			}
 			if (ImGui::Button("Update", ImVec2{-1.F, 0.F})) {
 				histogram.clear();
-				histogram.set(
-					image.pixels.data(), image.pixels.size(),
-					static_cast<std::size_t>(image.channels_num)
-				);
+				histogram.set(image);
+			}
+			{
+				static constexpr std::array<const char *, 3> FORMAT_NAMES{{"GRAY8", "RGBA8", "BINARY1"}};
+				ImGui::Text("Format: %s", FORMAT_NAMES[static_cast<std::size_t>(image.format)]);
+				for (std::size_t i{0}; i < FORMAT_NAMES.size(); ++i) {
+					ImGui::SameLine();
+					if (ImGui::Button(FORMAT_NAMES[i])) {
+						image.convert(static_cast<PixelFormat>(i));
+						upload_image_fn();
+						histogram.clear();
+						histogram.set(image);
+					}
+				}
 			}
 			ImGui::End();
 		}
 
 		if (win_visibility_mask[WIN_TYPE::ASSETS]) {
 			ImGui::Begin("Assets");
-			if (selectable_assets_list.draw(assets_dir_manager.files, "Available images")) {
-				assets_dir_manager.refresh();
+			if (auto sort_key = static_cast<int>(assets_dir_manager.sort_key); ImGui::Combo("Sort by", &sort_key, "Name\0Size\0Modified\0Pixels\0")) {
+				const auto selected_path = selected_asset_path_fn();
+				assets_dir_manager.sort(static_cast<DirManager::SortKey>(sort_key));
+				follow_selected_asset_fn(selected_path);
+			}
+			selectable_assets_list.draw(assets_dir_manager.files, "Available images");
+			if (const auto index = static_cast<std::size_t>(selectable_assets_list.selected); index < assets_dir_manager.entries.size()) {
+				const auto &entry = assets_dir_manager.entries[index];
+				ImGui::Text("%dx%d, %.1f KB", entry.width, entry.height, static_cast<f64>(entry.size) / 1024.);
+			}
+			if (selectable_assets_list.selected != prefetched_asset_index) {
+				prefetched_asset_index = selectable_assets_list.selected;
+				image_cache.prefetchNeighbours(
+					assets_dir_manager.files,
+					static_cast<std::size_t>(prefetched_asset_index)
+				);
+			}
+			if (ImGui::SliderInt("Cache budget [MB]", &image_cache_budget_mb, 0, 4096)) {
+				image_cache.setBudget(static_cast<std::size_t>(image_cache_budget_mb) << 20U);
 			}
 			if (ImGui::Button("Load selected image")) {
 				const auto asset_index = static_cast<std::size_t>(selectable_assets_list.selected);
-				if (image.update(assets_dir_manager.files.at(asset_index))) {
+				if (const auto cached = image_cache.acquire(assets_dir_manager.files.at(asset_index)); cached != nullptr) {
+					// cached pixels are shared until first algorithm writes into image
+					image = Image::sharing(cached);
+					reset_image_fields_fn();
 					img_texture.unbind(SHCONFIG_2D_TEX_BINDING);
 					img_texture.resize(image.width, image.height);
-					img_texture.update(static_cast<const void *>(image.pixels.data()));
+					upload_image_fn(true);
 					img_texture.bind(SHCONFIG_2D_TEX_BINDING);
 
 					fbo.resize(image.width, image.height);
 				}
 			}
+			ImGui::SliderInt("PNG compression level", &save_options.png_compression_level, 0, 9);
 			if (ImGui::Button("Save to selected image")) {
 				const auto asset_index = static_cast<std::size_t>(selectable_assets_list.selected);
-				image.save(assets_dir_manager.files.at(asset_index));
+				if (!save_queue.trySubmit(image, assets_dir_manager.files.at(asset_index), save_options, on_saved_fn)) {
+					spdlog::warn("Save queue is full, try again later");
+				}
+			}
+			if (ImGui::Button("Dump selected as raw pgm/pbm")) {
+				const auto asset_index = static_cast<std::size_t>(selectable_assets_list.selected);
+				auto dump_path = assets_dir_manager.files.at(asset_index);
+				dump_path.replace_extension(image.format == PixelFormat::BINARY1 ? ".pbm" : ".pgm");
+				if (!save_queue.trySubmit(image, std::move(dump_path), save_options, on_saved_fn)) {
+					spdlog::warn("Save queue is full, try again later");
+				}
+			}
+			ImGui::Text("Pending saves: %zu", save_queue.pending());
+			ImGui::End();
+		}
+
+		if (win_visibility_mask[WIN_TYPE::TILED_PROCESSING]) {
+			ImGui::Begin("Tiled processing");
+			ImGui::TextWrapped("Streams selected 8 bit pgm/raw asset through current settings of chosen algorithm without loading it whole");
+			ImGui::RadioButton("Local binarization", &tiled_processing_descriptor.algorithm, TiledProcessingDescriptor::LOCAL_BINARIZATION);
+			ImGui::RadioButton("Convolution (selected filter)", &tiled_processing_descriptor.algorithm, TiledProcessingDescriptor::CONVOLUTION);
+			ImGui::RadioButton("Median filter", &tiled_processing_descriptor.algorithm, TiledProcessingDescriptor::MEDIAN_FILTER);
+			ImGui::RadioButton("Morphology", &tiled_processing_descriptor.algorithm, TiledProcessingDescriptor::MORPHOLOGY);
+			ImGui::RadioButton("K3M", &tiled_processing_descriptor.algorithm, TiledProcessingDescriptor::K3M_SKELETONIZATION);
+			ImGui::SliderInt("Memory budget [MB]", &tiled_processing_descriptor.memory_budget_mb, 1, 1024);
+			if (ImGui::Button("Process selected asset")) {
+				const auto asset_index = static_cast<std::size_t>(selectable_assets_list.selected);
+				const auto &src_path = assets_dir_manager.files.at(asset_index);
+				auto dst_path = src_path;
+				dst_path.replace_filename(src_path.stem().string() + "_tiled.pgm");
+
+				TiledImage src;
+				TiledImage dst;
+				if (src.open(src_path) && dst.create(dst_path, src.width, src.height)) {
+					TileOptions options{
+						.memory_budget = static_cast<std::size_t>(tiled_processing_descriptor.memory_budget_mb) << 20U,
+						.max_side = max_texture_size
+					};
+					std::function<void(Image &, TileRect)> tile_fn;
+					switch (tiled_processing_descriptor.algorithm) {
+					case TiledProcessingDescriptor::LOCAL_BINARIZATION:
+						options.halo = local_binarization_alg.descriptor.kernel_size;
+						local_binarization_alg.submit(alg_descriptor_ring);
+						local_binarization_alg.bindVariant();
+						break;
+					case TiledProcessingDescriptor::CONVOLUTION: {
+						convolution_alg.prepare(selected_filter_fn());
+						options.halo = convolution_alg.descriptor.kernel_size;
+						if (convolution_alg.engine == ConvolutionEngine::DIRECT) {
+							convolution_alg.submit(alg_descriptor_ring);
+							convolution_alg.bindVariant();
+						} else {
+							tile_fn = [&](Image &tile, TileRect) { convolution_alg.perform(tile); };
+						}
+						break;
+					}
+					case TiledProcessingDescriptor::MEDIAN_FILTER:
+						options.halo = median_filter_alg.descriptor.kernel_size;
+						median_filter_alg.submit(alg_descriptor_ring);
+						median_filter_alg.bindVariant();
+						break;
+					case TiledProcessingDescriptor::MORPHOLOGY:
+						options.halo = morphology_descriptor.halo();
+						tile_fn = [&](Image &tile, TileRect) {
+							performMorphology(tile, static_cast<MorphologyOperation>(morphology_descriptor.operation), morphology_descriptor.element);
+						};
+						break;
+					default:
+						options.halo = TILED_THINNING_HALO;
+						tile_fn = [](Image &tile, TileRect) { performK3MSkeletonization(tile); };
+						break;
+					}
+					if (!tile_fn) {
+						tile_fn = [&](Image &tile, TileRect) { tile_perform_fn(tile); };
+					}
+
+					if (processTiled(src, dst, options, tile_fn)) {
+						spdlog::info("Tiled result written to {}", dst_path.string());
+					}
+					basic_shader.bind();
+				}
 			}
 			ImGui::End();
 		}
@@ -840,6 +1440,8 @@ int main() {
 		}
 
 		if (drawing_descriptor.draw_mode) {
+			// strokes go to level 0 and are read back by fill, so it has to be there
+			image_pyramid.flush(img_texture, image);
 			win_visibility_mask.reset();
 			TransformData tmp{};
 			const auto px_size_window = 1.F/static_cast<f32>(window_data.window_width);
@@ -903,6 +1505,7 @@ int main() {
 				glDrawArrays(GL_TRIANGLES, 0, QUAD_VERTICES.size());
 
 				glTextureBarrier();
+				drawing_descriptor.strokes_drawn = true;
 
 				glFramebufferTexture2D(
 					GL_FRAMEBUFFER,
@@ -924,19 +1527,18 @@ int main() {
 				if (fill_descriptor.global_mode) {
 					global_fill_algorithm.shader.bind();
 					
-					const auto root_px_color_index = static_cast<i32>(start_x) + static_cast<i32>(start_y) * image.width;
-					const u8* root_px_color = &image.pixels[static_cast<std::size_t>(image.channels_num * root_px_color_index)];
+					const auto root_px_color = image.at(static_cast<i32>(start_x), static_cast<i32>(start_y));
 					global_fill_algorithm.descriptor = GlobalFillDescriptor{
-						static_cast<f32>(std::clamp(static_cast<i32>(root_px_color[0]) - fill_descriptor.r_px_distance[0], 0, 255)) / 255.F,
-						static_cast<f32>(std::clamp(static_cast<i32>(root_px_color[0]) + fill_descriptor.r_px_distance[1], 0, 255)) / 255.F,
-						static_cast<f32>(std::clamp(static_cast<i32>(root_px_color[1]) - fill_descriptor.g_px_distance[0], 0, 255)) / 255.F,
-						static_cast<f32>(std::clamp(static_cast<i32>(root_px_color[1]) + fill_descriptor.g_px_distance[1], 0, 255)) / 255.F,
-						static_cast<f32>(std::clamp(static_cast<i32>(root_px_color[2]) - fill_descriptor.b_px_distance[0], 0, 255)) / 255.F,
-						static_cast<f32>(std::clamp(static_cast<i32>(root_px_color[2]) + fill_descriptor.b_px_distance[1], 0, 255)) / 255.F,
+						static_cast<f32>(std::clamp(static_cast<i32>(root_px_color.r) - fill_descriptor.r_px_distance[0], 0, 255)) / 255.F,
+						static_cast<f32>(std::clamp(static_cast<i32>(root_px_color.r) + fill_descriptor.r_px_distance[1], 0, 255)) / 255.F,
+						static_cast<f32>(std::clamp(static_cast<i32>(root_px_color.g) - fill_descriptor.g_px_distance[0], 0, 255)) / 255.F,
+						static_cast<f32>(std::clamp(static_cast<i32>(root_px_color.g) + fill_descriptor.g_px_distance[1], 0, 255)) / 255.F,
+						static_cast<f32>(std::clamp(static_cast<i32>(root_px_color.b) - fill_descriptor.b_px_distance[0], 0, 255)) / 255.F,
+						static_cast<f32>(std::clamp(static_cast<i32>(root_px_color.b) + fill_descriptor.b_px_distance[1], 0, 255)) / 255.F,
 						{ fill_descriptor.color[0], fill_descriptor.color[1], fill_descriptor.color[2] }
 					};
 
-					global_fill_algorithm.submit(alg_descriptor_ubo_id);
+					global_fill_algorithm.submit(alg_descriptor_ring);
 
 					alg_perform_fn();
 
@@ -960,6 +1562,10 @@ int main() {
 			}
 		} else {
 			win_visibility_mask.set();
+			if (drawing_descriptor.strokes_drawn) {
+				drawing_descriptor.strokes_drawn = false;
+				image_pyramid.regenerate(img_texture);
+			}
 		}
 
 		if (fill_descriptor.fill_in_progress && fill_descriptor.task.valid() && 
@@ -968,26 +1574,37 @@ int main() {
 			fill_descriptor.fill_in_progress = false;
 			fill_descriptor.task.get();
 
-			img_texture.update(static_cast<void*>(image.pixels.data()));
+			upload_image_fn();
 			glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
 		}
 
+		save_queue.poll();
+
 		ImGui::Render();
 
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
+		alg_descriptor_ring.endFrame();
 		window.swapBuffers();
+		if (first_frame_hook) {
+			first_frame_hook();
+			first_frame_hook = nullptr;
+		}
 	}
+	save_queue.wait();
+
 	// opengl stuff
-	std::array<u32, 3> buffers{{quad_vbo_id, quad_ubo_id, alg_descriptor_ubo_id}};
+	std::array<u32, 2> buffers{{quad_vbo_id, quad_ubo_id}};
 	glDeleteBuffers(buffers.size(), buffers.data());
+	alg_descriptor_ring.deinit();
 
 	glDeleteVertexArrays(1, &quad_vao_id);
 
-	std::array<u32, 2> textures{{img_texture.tex_id_, fbo.tex_id_}};
+	std::array<u32, 4> textures{{img_texture.tex_id_, fbo.tex_id_, tile_texture.tex_id_, tile_fbo.tex_id_}};
 	glDeleteTextures(textures.size(), textures.data());
 
-	glDeleteFramebuffers(1, &fbo.fbo_id_);
+	std::array<u32, 2> framebuffers{{fbo.fbo_id_, tile_fbo.fbo_id_}};
+	glDeleteFramebuffers(framebuffers.size(), framebuffers.data());
 
 	basic_shader.deinit();
 	threshold_binarization_shader.deinit();